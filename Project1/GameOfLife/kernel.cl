@@ -1,80 +1,317 @@
+// the cell layout is chosen by the host through build options
+// (see CellTraits<T>::clBuildOptions), default are numeric 0/1 cells
+#ifndef CELL_T
+#define CELL_T uchar
+#endif
+
+#if defined(CELL_ASCII)
+#define ALIVE(c) ((c) == 'x')
+#define NEXT(c, survives) ((CELL_T)('.' + (survives) * ('x' - '.')))
+#elif defined(CELL_AGE)
+#define ALIVE(c) ((c) != 0)
+#define NEXT(c, survives) ((CELL_T)((survives) * ((c) + ((c) < 0xFFFF))))
+#else
+#define ALIVE(c) (c)
+#define NEXT(c, survives) ((CELL_T)(survives))
+#endif
+
+// state of a cell under a multi-state rule and the cell of a state, ASCII cells
+// use the characters of the .gol files (see stateFromChar in celltraits.h)
+#if defined(CELL_ASCII)
+int STATE(char c) {
+	if(c == '.') return 0;
+	if(c == 'x') return 1;
+	if(c >= '2' && c <= '9') return c - '0';
+	if(c >= 'A' && c <= 'Z') return c - 'A' + 10;
+	return c < 'x' ? c - 'a' + 36 : c - 'a' + 35;
+}
+char CELL(int s) {
+	if(s < 2) return s ? 'x' : '.';
+	if(s < 10) return (char)('0' + s);
+	if(s < 36) return (char)('A' + s - 10);
+	return (char)(s < 59 ? 'a' + s - 36 : 'a' + s - 35);
+}
+#else
+#define STATE(c) ((int)(c))
+#define CELL(s) ((CELL_T)(s))
+#endif
+
+// next state of cell (x,y) of the board starting at in
+CELL_T nextCell(int x, int y, int xDim, int yDim, __global const CELL_T* in) {
+	int left = (x-1+xDim)%xDim;
+	int right = (x+1)%xDim;
+	int top = ((y-1+yDim)%yDim) * xDim;
+	int mid = y * xDim;
+	int bot = ((y+1)%yDim) * xDim;
+
+	// plain sum of the eight neighbours, no compare and branch per cell
+	int neighbors = ALIVE(in[left + top]) + ALIVE(in[x + top]) + ALIVE(in[right + top])
+				  + ALIVE(in[left + mid])                      + ALIVE(in[right + mid])
+				  + ALIVE(in[left + bot]) + ALIVE(in[x + bot]) + ALIVE(in[right + bot]);
+
+	CELL_T cell = in[x + mid];
+	int survives = (neighbors == 3) | (ALIVE(cell) & (neighbors == 2));
+
+	return NEXT(cell, survives);
+}
+
+// splitmix64 finalizer, must match mix64 in cycledetector.h
+ulong mix64(ulong z) {
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9UL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBUL;
+	return z ^ (z >> 31);
+}
+
+// besides the next generation every work-group writes its share of the
+// generation statistics (see GenerationStats) to stats[statsOffset + group]:
+// x = sum of cell * (hashKeyX(x) ^ hashKeyY(y)), y = population, z = births, w = deaths
+// the global size is padded to a multiple of the (power of two) work-group size
+// every work-item calculates cellsPerItem cells next to each other in its row
 __kernel
-void calcGeneration(int xDim, int yDim, __global char* in, __global char* out) {
+void calcGeneration(int xDim, int yDim, __global CELL_T* in, __global CELL_T* out,
+					__global ulong4* stats, __local ulong4* scratch, int statsOffset, int cellsPerItem) {
 
-	int x = get_global_id(0);
+	int x0 = get_global_id(0) * cellsPerItem;
 	int y = get_global_id(1);
-	
-	int left = x - 1;
-	int right = x + 1;
-	int top = y - 1;
-	int bot = y + 1;
-
-	int neighbors = 0;
-	
-	if(x == 0) {
-		left = (x-1+xDim)%xDim;
-	}
+	int lid = get_local_id(0) + get_local_id(1) * get_local_size(0);
 
-	if(x == xDim-1) {
-		right = (x+1)%xDim;
-	}
+	ulong4 counters = (ulong4)(0, 0, 0, 0);
+	if(y < yDim) {
+		ulong keyY = mix64(2 * (ulong)y + 1);
+		int x1 = min(x0 + cellsPerItem, xDim);
 
-	if(y == 0) {
-		top = (y-1+yDim)%yDim;
-	}
+		for(int x = x0; x < x1; ++x) {
+			int was = ALIVE(in[x + y * xDim]);
+			CELL_T cell = nextCell(x, y, xDim, yDim, in);
+			int is = ALIVE(cell);
+			out[x + y * xDim] = cell;
 
-	if(y == yDim-1) {
-		bot = (y+1)%yDim;
+			counters.x += (ulong)cell * (mix64(2 * (ulong)x) ^ keyY);
+			counters.y += is;
+			counters.z += is & (was ^ 1);
+			counters.w += was & (is ^ 1);
+		}
 	}
 
-	// leftupper
-	if(in[left + top * xDim] == 'x') {
-		neighbors++;
+	// work-group reduction of the counters
+	scratch[lid] = counters;
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for(int s = (get_local_size(0) * get_local_size(1)) / 2; s > 0; s >>= 1) {
+		if(lid < s) {
+			scratch[lid] += scratch[lid + s];
+		}
+		barrier(CLK_LOCAL_MEM_FENCE);
 	}
 
-	// upper
-	if(in[x + top * xDim] == 'x') {
-		neighbors++;
+	if(lid == 0) {
+		stats[statsOffset + get_group_id(0) + get_group_id(1) * get_num_groups(0)] = scratch[0];
 	}
+}
 
-	// right upper
-	if(in[right + top * xDim] == 'x') {
-		neighbors++;
+// multi-state Generations rules (see multistate.h), same arguments and counters as
+// calcGeneration plus the rule: number of states and the neighbour counts that
+// make a dead cell alive (bit n of birth) or keep a living cell alive (survival)
+// only state 1 is alive, every other non-zero state moves on to the next one
+__kernel
+void statesGeneration(int xDim, int yDim, __global CELL_T* in, __global CELL_T* out,
+					  __global ulong4* stats, __local ulong4* scratch, int statsOffset, int cellsPerItem,
+					  int states, int birth, int survival) {
+
+	int x0 = get_global_id(0) * cellsPerItem;
+	int y = get_global_id(1);
+	int lid = get_local_id(0) + get_local_id(1) * get_local_size(0);
+
+	ulong4 counters = (ulong4)(0, 0, 0, 0);
+	if(y < yDim) {
+		ulong keyY = mix64(2 * (ulong)y + 1);
+		int x1 = min(x0 + cellsPerItem, xDim);
+		int top = ((y-1+yDim)%yDim) * xDim;
+		int mid = y * xDim;
+		int bot = ((y+1)%yDim) * xDim;
+
+		for(int x = x0; x < x1; ++x) {
+			int left = (x-1+xDim)%xDim;
+			int right = (x+1)%xDim;
+
+			int neighbors = (STATE(in[left + top]) == 1) + (STATE(in[x + top]) == 1) + (STATE(in[right + top]) == 1)
+						  + (STATE(in[left + mid]) == 1)                             + (STATE(in[right + mid]) == 1)
+						  + (STATE(in[left + bot]) == 1) + (STATE(in[x + bot]) == 1) + (STATE(in[right + bot]) == 1);
+
+			int s = STATE(in[x + mid]);
+			int next;
+			if(s == 0)
+				next = (birth >> neighbors) & 1;
+			else if(s == 1 && ((survival >> neighbors) & 1))
+				next = 1;
+			else
+				next = (s + 1) % states;
+
+			CELL_T cell = CELL(next);
+			out[x + mid] = cell;
+
+			int was = s == 1;
+			int is = next == 1;
+			counters.x += (ulong)cell * (mix64(2 * (ulong)x) ^ keyY);
+			counters.y += is;
+			counters.z += is & (was ^ 1);
+			counters.w += was & (is ^ 1);
+		}
 	}
 
-	// right
-	if(in[right + y * xDim] == 'x') {
-		neighbors++;
+	scratch[lid] = counters;
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for(int s = (get_local_size(0) * get_local_size(1)) / 2; s > 0; s >>= 1) {
+		if(lid < s) {
+			scratch[lid] += scratch[lid + s];
+		}
+		barrier(CLK_LOCAL_MEM_FENCE);
 	}
 
-	// right bottom
-	if(in[right + bot * xDim] == 'x') {
-		neighbors++;
+	if(lid == 0) {
+		stats[statsOffset + get_group_id(0) + get_group_id(1) * get_num_groups(0)] = scratch[0];
 	}
+}
+
+// several boards of the same size packed back to back into one buffer
+// dimension 2 of the NDRange selects the board
+__kernel
+void calcGenerationBatch(int xDim, int yDim, __global CELL_T* in, __global CELL_T* out) {
 
-	// bottom
-	if(in[x + bot * xDim] == 'x') {
-		neighbors++;
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	int board = get_global_id(2) * xDim * yDim;
+
+	out[board + x + y * xDim] = nextCell(x, y, xDim, yDim, in + board);
+}
+
+// Larger than Life rules, see LtlEngine in largerthanlife.h for the idea
+// the board is wrapped into a grid padded by h = radius+1 cells on every side,
+// pa/pb hold prefix sums of its living cells along the columns (Moore) or along
+// the falling (pa) and rising (pb) diagonals (von Neumann)
+
+// living state of cell (px,py) of the padded grid
+int ltlAlive(int px, int py, int h, int xDim, int yDim, __global const CELL_T* in) {
+	int x = ((px - h) % xDim + xDim) % xDim;
+	int y = ((py - h) % yDim + yDim) % yDim;
+	return ALIVE(in[x + y * xDim]) ? 1 : 0;
+}
+
+// one work-item per padded column (Moore) or per diagonal (von Neumann, the
+// first half falling, the second half rising), neighbouring work-items touch
+// neighbouring cells of the same row
+__kernel
+void ltlPrefix(int xDim, int yDim, int radius, int vonNeumann,
+			   __global const CELL_T* in, __global int* pa, __global int* pb) {
+
+	int h = radius + 1;
+	int pw = xDim + 2 * h;
+	int ph = yDim + 2 * h;
+	int i = get_global_id(0);
+	int sum = 0;
+
+	if(!vonNeumann) {
+		if(i >= pw)
+			return;
+
+		for(int py = 0; py < ph; ++py) {
+			sum += ltlAlive(i, py, h, xDim, yDim, in);
+			pa[i + py * pw] = sum;
+		}
+		return;
 	}
 
-	// left bottom
-	if(in[left + bot * xDim] == 'x') {
-		neighbors++;
+	// diagonals start in the top row or in the first (falling) / last (rising) column
+	int diagonals = pw + ph - 1;
+	if(i >= 2 * diagonals)
+		return;
+
+	int falling = i < diagonals;
+	int d = falling ? i : i - diagonals;
+	int step = falling ? 1 : -1;
+	__global int* p = falling ? pa : pb;
+	int px, py;
+
+	if(d < pw) {
+		px = falling ? d : pw - 1 - d;
+		py = 0;
+	}
+	else {
+		px = falling ? 0 : pw - 1;
+		py = d - pw + 1;
 	}
 
-	// left
-	if(in[left + y * xDim] == 'x') {
-		neighbors++;
+	for(; py < ph && px >= 0 && px < pw; ++py, px += step) {
+		sum += ltlAlive(px, py, h, xDim, yDim, in);
+		p[px + py * pw] = sum;
 	}
+}
 
-	if(in[x + y * xDim] == 'x') {
-		if(neighbors > 3 || neighbors < 2) {
-			out[x + y * xDim]= '.';
-		}
+// cells (x0,y0) .. (x0+k,y0+k) and (x0,y0) .. (x0-k,y0+k) of the padded grid
+#define LTL_FALLING(x0, y0, k) (pa[((y0)+(k)) * pw + (x0)+(k)] - pa[((y0)-1) * pw + (x0)-1])
+#define LTL_RISING(x0, y0, k) (pb[((y0)+(k)) * pw + (x0)-(k)] - pb[((y0)-1) * pw + (x0)+1])
+
+// one work-item per board row, the neighbourhood sum slides along the row so
+// every cell costs the same for any radius
+// ranges = (birth min, birth max, survival min, survival max)
+// the counters of row y go to stats[statsOffset + y]
+__kernel
+void ltlRule(int xDim, int yDim, int radius, int vonNeumann, int includeCenter, int4 ranges,
+			 __global const CELL_T* in, __global CELL_T* out,
+			 __global const int* pa, __global const int* pb,
+			 __global ulong4* stats, int statsOffset) {
+
+	int y = get_global_id(0);
+	if(y >= yDim)
+		return;
+
+	int r = radius;
+	int h = r + 1;
+	int pw = xDim + 2 * h;
+	int Y = y + h;
+	int center = includeCenter ? 0 : 1;
+	ulong keyY = mix64(2 * (ulong)y + 1);
+	ulong4 counters = (ulong4)(0, 0, 0, 0);
+	int sum = 0;
+
+	// the first square/diamond of the row is summed up directly
+	if(!vonNeumann) {
+		for(int px = h - r; px <= h + r; ++px)
+			sum += pa[(Y + r) * pw + px] - pa[(Y - r - 1) * pw + px];
 	}
 	else {
-		if(neighbors == 3) {
-			out[x + y * xDim] = 'x';
+		for(int dy = -r; dy <= r; ++dy) {
+			int w = r - abs(dy);
+			for(int dx = -w; dx <= w; ++dx)
+				sum += ltlAlive(h + dx, Y + dy, h, xDim, yDim, in);
 		}
 	}
-}
\ No newline at end of file
+
+	for(int x = 0; x < xDim; ++x) {
+		CELL_T cell = in[x + y * xDim];
+		int was = ALIVE(cell) ? 1 : 0;
+		int count = sum - center * was;
+		int is = was ? (count >= ranges.z && count <= ranges.w)
+					 : (count >= ranges.x && count <= ranges.y);
+		CELL_T next = NEXT(cell, is);
+		out[x + y * xDim] = next;
+
+		counters.x += (ulong)next * (mix64(2 * (ulong)x) ^ keyY);
+		counters.y += is;
+		counters.z += is & (was ^ 1);
+		counters.w += was & (is ^ 1);
+
+		int X = x + h;
+		if(!vonNeumann) {
+			sum += (pa[(Y + r) * pw + X + r + 1] - pa[(Y - r - 1) * pw + X + r + 1])
+				 - (pa[(Y + r) * pw + X - r] - pa[(Y - r - 1) * pw + X - r]);
+		}
+		else {
+			sum += LTL_FALLING(X + 1, Y - r, r) + LTL_RISING(X + r, Y + 1, r - 1)
+				 - LTL_RISING(X, Y - r, r) - LTL_FALLING(X - r + 1, Y + 1, r - 1);
+		}
+	}
+
+	stats[statsOffset + y] = counters;
+}
@@ -0,0 +1,44 @@
+#ifndef __BOARDGENERATOR_H
+#define __BOARDGENERATOR_H
+
+#include <stdint.h>
+
+#include "cycledetector.h"
+
+// creates random boards of any size straight into a .gol or binary (.golb) file
+//
+// cell i = y*xDim+x is alive if the i-th output of a counter based splitmix64
+// stream (mix64(seed + (i+1)*golden gamma)) is below density. every cell only
+// depends on the seed and its index, so rows are generated by OpenMP threads
+// independently and the file is the same for every thread count.
+// only one band of rows is held in memory, so the board may be far bigger than RAM
+class BoardGenerator {
+public:
+	BoardGenerator(const int xDim, const int yDim, const double density, const uint64_t seed);
+
+	// format by extension, see patternFormat
+	bool write(const char* fileName);
+
+	// 0 uses the OpenMP default
+	inline void setThreadCount(const int nthreads) { mThreadCount = nthreads; }
+
+	inline bool alive(const int x, const int y) const { return cellValue((uint64_t)y*mXDim+x) < mThreshold; }
+
+private:
+	// output of the random stream for cell index i, only the upper 53 bits are used
+	inline uint64_t cellValue(const uint64_t i) const { return mix64(mSeed + (i+1)*0x9E3779B97F4A7C15ULL) >> 11; }
+
+	// row y as .gol characters, no line break
+	void generateRowChars(const int y, char* out) const;
+	// row y as bits, lsb first
+	void generateRowBits(const int y, unsigned char* out) const;
+
+	int mXDim;
+	int mYDim;
+	uint64_t mSeed;
+	// density scaled to 53 bits
+	uint64_t mThreshold;
+	int mThreadCount;
+};
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef __DURABLEFILE_H
+#define __DURABLEFILE_H
+
+#include <string>
+#include <vector>
+
+// whole files that survive a crash or a power loss at any point of a write
+//
+// replace writes <name>.tmp, flushes it to the disk and only then renames it to
+// <name>, the file that was there before is kept as <name>.prev until the new one is
+// in place. whatever happens, one of <name> and <name>.prev is complete, readers try
+// them in that order (see Checkpoint::loadLatest) and never trust the .tmp file.
+class DurableFile {
+public:
+	// false if the data could not be written and flushed, the old file is untouched then
+	static bool replace(const char* fileName, const std::vector<unsigned char>& data);
+	// the same without <name>.prev, for files where readers only need some complete version
+	// and never an older one (profiles, metrics). a crash leaves the old or the new file
+	static bool overwrite(const char* fileName, const std::vector<unsigned char>& data);
+	// the whole file into data, false if it can not be read
+	static bool read(const char* fileName, std::vector<unsigned char>& data);
+
+	// names of the new file while it is written and of the one it replaces
+	static inline std::string tmpName(const char* fileName) { return std::string(fileName)+".tmp"; }
+	static inline std::string prevName(const char* fileName) { return std::string(fileName)+".prev"; }
+};
+
+#endif
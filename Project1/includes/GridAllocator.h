@@ -0,0 +1,80 @@
+#ifndef __GRIDALLOCATOR_H
+#define __GRIDALLOCATOR_H
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+
+// allocator for the board buffers
+//
+// every block starts on a cache line (blocks of a page or more on a page, which is
+// what OpenCL CPU runtimes want for zero-copy CL_MEM_USE_HOST_PTR buffers) and is
+// padded to a multiple of the cache line, so vector loads never run past the end.
+// with huge pages enabled big blocks are backed by 2 MB pages (MAP_HUGETLB or
+// transparent huge pages on linux, MEM_LARGE_PAGES on windows) if the system allows it.
+//
+// released blocks are kept in a pool and handed out again for the next board of
+// the same size, so repeated runs and batch mode do not fault in fresh pages
+// for every board. the pool is shared by all threads.
+class GridAllocator {
+public:
+	static const size_t CACHE_LINE = 64;
+	static const size_t PAGE_SIZE = 4096;
+	static const size_t HUGE_PAGE_SIZE = 2*1024*1024;
+
+	// process wide allocator
+	static GridAllocator& instance();
+
+	~GridAllocator();
+
+	// returns a block of at least bytes bytes, 0 if out of memory
+	void* allocate(const size_t bytes);
+	// gives a block from allocate back to the pool
+	void release(void* ptr);
+	// frees all pooled blocks
+	void trim();
+
+	// typed helpers for the board buffers
+	template <class T>
+	inline T* allocateCells(const size_t count) { return (T*)allocate(sizeof(T)*count); }
+
+	// only affects blocks allocated afterwards
+	inline void setHugePages(const bool enabled) { mHugePages = enabled; }
+	inline bool getHugePages() const { return mHugePages; }
+	// released blocks beyond this are freed instead of pooled
+	inline void setPoolLimit(const size_t bytes) { mPoolLimit = bytes; }
+
+	// bytes of live blocks that are backed by huge pages
+	size_t getHugePageBytes();
+	// allocations that were served from the pool
+	inline size_t getPoolHits() const { return mPoolHits; }
+
+private:
+	GridAllocator();
+	GridAllocator(const GridAllocator&);
+	GridAllocator& operator=(const GridAllocator&);
+
+	struct Block {
+		// size that was mapped/allocated, a multiple of the alignment
+		size_t size;
+		// mapped with huge pages
+		bool huge;
+		// comes from the page allocator instead of the heap
+		bool mapped;
+	};
+
+	Block map(void** ptr, const size_t bytes);
+	void unmap(void* ptr, const Block& block);
+
+	std::mutex mMutex;
+	// blocks handed out
+	std::map<void*, Block> mLive;
+	// released blocks by size
+	std::multimap<size_t, std::pair<void*, Block> > mPool;
+	size_t mPoolBytes;
+	size_t mPoolLimit;
+	size_t mPoolHits;
+	bool mHugePages;
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef __LOCALSOCKET_H
+#define __LOCALSOCKET_H
+
+#include <string>
+#include <vector>
+
+// stream socket on a local (AF_UNIX) address, used by the daemon and its client
+// windows 10 and newer support AF_UNIX through winsock, everything else uses the
+// posix sockets. the protocol on top is line based, see daemon.h
+class LocalSocket {
+public:
+	LocalSocket();
+	~LocalSocket();
+
+	// binds to path (an old socket file is removed first) and starts listening
+	bool listen(const char* path);
+	// waits for the next client, false if the listening socket was closed
+	bool accept(LocalSocket& client);
+	bool connect(const char* path);
+
+	// reads up to the next \n, the line break (and a \r before it) is removed
+	// false once the line gets longer than maxLength (0 is no limit)
+	bool readLine(std::string& line, const size_t maxLength = 0);
+	// reads give up after ms milliseconds without data
+	bool setReadTimeout(const int ms);
+	// wakes up a read or write of another thread, the socket stays open until close
+	void shutdown();
+	bool write(const std::string& data);
+
+	void close();
+	bool isOpen() const;
+
+private:
+	LocalSocket(const LocalSocket&);
+	LocalSocket& operator=(const LocalSocket&);
+
+	// SOCKET on windows, file descriptor everywhere else
+	long long mSocket;
+	// socket file of a listening socket, removed on close
+	std::string mPath;
+
+	std::vector<char> mBuffer;
+	size_t mPos;
+	size_t mEnd;
+};
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef __METRICS_H
+#define __METRICS_H
+
+#include <stdint.h>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "LocalSocket.h"
+
+// live counters of a run in the Prometheus text format
+//
+// the engines update relaxed atomics once per generation (or once per batch for the
+// wavefront, tiled and OpenCL engines), nothing is locked on that path. while metrics
+// are disabled, which is the default, the engines only check isEnabled.
+//
+// the counters are exported by
+//   openFile    a text file, rewritten every interval (write to .tmp and rename, so
+//               scrapers like the node_exporter textfile collector never see half a file)
+//   openSocket  a local socket, every client sends one line and gets the current
+//               text back, "GET ..." lines get a HTTP/1.0 answer (curl --unix-socket)
+//
+// generation latencies go into a histogram with power of two buckets starting at
+// one microsecond, the percentiles are the upper bounds of the matching buckets
+class Metrics {
+public:
+	// buckets of the latency histogram, bucket i counts latencies below 2^i microseconds
+	static const int BUCKETS = 32;
+
+	// process wide metrics
+	static Metrics& instance();
+
+	~Metrics();
+
+	// false if the file could not be written
+	bool openFile(const char* fileName, const int intervalMs);
+	// false if the socket could not be created
+	bool openSocket(const char* path);
+	// writes the file one last time and stops the export
+	void close();
+
+	inline bool isEnabled() const { return mEnabled.load(std::memory_order_relaxed); }
+
+	// count generations took seconds seconds
+	void addGenerations(const uint64_t count, const double seconds);
+	inline void setPopulation(const uint64_t population) { mPopulation.store(population, std::memory_order_relaxed); }
+	inline void addBytesRead(const uint64_t bytes) { mBytesRead.fetch_add(bytes, std::memory_order_relaxed); }
+	inline void addBytesWritten(const uint64_t bytes) { mBytesWritten.fetch_add(bytes, std::memory_order_relaxed); }
+
+	// current values in the Prometheus text format
+	std::string text();
+
+	// size of a file, 0 if it does not exist
+	static uint64_t fileBytes(const char* fileName);
+
+private:
+	Metrics();
+	Metrics(const Metrics&);
+	Metrics& operator=(const Metrics&);
+
+	bool writeFile();
+	void fileLoop();
+	void socketLoop();
+	// upper bound in seconds of the bucket q of the generations fall into
+	double percentile(const uint64_t* buckets, const uint64_t count, const double q) const;
+
+	std::atomic<bool> mEnabled;
+
+	std::atomic<uint64_t> mGenerations;
+	std::atomic<uint64_t> mPopulation;
+	std::atomic<uint64_t> mBytesRead;
+	std::atomic<uint64_t> mBytesWritten;
+	// sum of all generation latencies in nanoseconds
+	std::atomic<uint64_t> mLatencyNanos;
+	std::atomic<uint64_t> mBuckets[BUCKETS];
+
+	// generations per second are measured between two calls of text
+	std::mutex mRateMutex;
+	std::chrono::steady_clock::time_point mStart;
+	std::chrono::steady_clock::time_point mLastTime;
+	uint64_t mLastGenerations;
+	double mRate;
+
+	std::string mFileName;
+	int mIntervalMs;
+	std::thread mFileThread;
+	std::mutex mStopMutex;
+	std::condition_variable mStopSignal;
+	bool mStop;
+
+	std::string mSocketPath;
+	LocalSocket mListener;
+	std::thread mSocketThread;
+	std::atomic<bool> mSocketStop;
+	// client the socket thread talks to, close shuts it down instead of waiting for it
+	std::mutex mClientMutex;
+	LocalSocket* mClient;
+};
+
+#endif
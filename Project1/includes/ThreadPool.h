@@ -0,0 +1,41 @@
+#ifndef __THREADPOOL_H
+#define __THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// fixed size pool of worker threads that is shared by all boards of a run
+// tasks are executed in the order they were enqueued
+class ThreadPool {
+public:
+	explicit ThreadPool(const int nthreads);
+	~ThreadPool();
+
+	void enqueue(const std::function<void()>& task);
+	// blocks until every enqueued task has finished
+	void wait();
+
+	inline int getThreadCount() const { return (int)mWorkers.size(); }
+
+private:
+	void workerLoop();
+
+	std::vector<std::thread> mWorkers;
+	std::deque<std::function<void()> > mTasks;
+
+	std::mutex mMutex;
+	// signaled when a task was enqueued or the pool shuts down
+	std::condition_variable mTaskAvailable;
+	// signaled when the last pending task finished
+	std::condition_variable mAllDone;
+
+	// enqueued and not yet finished tasks
+	int mPending;
+	bool mShutdown;
+};
+
+#endif
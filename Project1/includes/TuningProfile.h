@@ -0,0 +1,62 @@
+#ifndef __TUNINGPROFILE_H
+#define __TUNINGPROFILE_H
+
+#include <string>
+#include <vector>
+
+// parameters the autotuner found for one machine and board size, 0 means not tuned
+struct TuningConfig {
+	TuningConfig() : threads(0), chunk(0), tileRows(0), tileCols(0),
+					 localX(0), localY(0), cellsPerItem(0), secondsPerGeneration(0.0) {}
+
+	// CPU engines: OpenMP threads, rows per OpenMP chunk and tile size of the tiled engine
+	int threads;
+	int chunk;
+	int tileRows;
+	int tileCols;
+
+	// OpenCL: work-group size and cells calculated by every work-item
+	int localX;
+	int localY;
+	int cellsPerItem;
+
+	// time per generation of the best configuration
+	double secondsPerGeneration;
+};
+
+// best configurations per CPU/OpenCL device and board size, stored as a text file
+// with one line per entry:
+//
+//   <identity> \t <x>x<y> \t threads=4 chunk=16 tile=64x1024 local=16x16 cells=2 spg=0.0012
+//
+// the identity is cpuIdentity() for the CPU engines and deviceIdentity(name) for an
+// OpenCL device, lines starting with # are ignored
+class TuningProfile {
+public:
+	// model name and number of hardware threads of this machine
+	static std::string cpuIdentity();
+	static std::string deviceIdentity(const std::string& deviceName);
+
+	// false if the file does not exist or is not a profile
+	bool load(const char* fileName);
+	bool save(const char* fileName) const;
+
+	// entry of identity with the board size closest to xDim*yDim cells
+	bool find(const std::string& identity, const int xDim, const int yDim, TuningConfig& config) const;
+	// adds the entry or replaces the one with the same identity and board size
+	void set(const std::string& identity, const int xDim, const int yDim, const TuningConfig& config);
+
+	inline size_t getEntryCount() const { return mEntries.size(); }
+
+private:
+	struct Entry {
+		std::string identity;
+		int xDim;
+		int yDim;
+		TuningConfig config;
+	};
+
+	std::vector<Entry> mEntries;
+};
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef __WORKSTEALING_H
+#define __WORKSTEALING_H
+
+#include <vector>
+#include <atomic>
+#include <functional>
+
+// Chase-Lev deque of task ids with a fixed capacity (power of two)
+// the owning worker pushes and pops at the bottom, all other workers steal from the top
+class WorkStealingDeque {
+public:
+	static const int EMPTY = -1;
+
+	explicit WorkStealingDeque(const int capacity);
+
+	// owner only, returns false if the deque is full
+	bool push(const int task);
+	// owner only, returns EMPTY if there is nothing left
+	int pop();
+	// any thread, returns EMPTY if there was nothing to steal or another thief was faster
+	int steal();
+
+private:
+	std::vector<std::atomic<int> > mBuffer;
+	long long mMask;
+
+	// top and bottom live on different cache lines, thieves hammer top
+	char mPad0[64];
+	std::atomic<long long> mTop;
+	char mPad1[64];
+	std::atomic<long long> mBottom;
+	char mPad2[64];
+};
+
+// per worker counters of the last run, used to judge how well the load was balanced
+struct WorkerStats {
+	// tasks this worker executed
+	long long tasks;
+	// tasks taken from other workers
+	long long steals;
+	// steal attempts that came back empty
+	long long failedSteals;
+	// time spent without work in seconds
+	double idleTime;
+
+	WorkerStats() : tasks(0), steals(0), failedSteals(0), idleTime(0.0) {}
+};
+
+// runs a graph of tasks on a fixed number of workers with one deque each
+// tasks are ids in [0, taskCount), a running task makes its successors ready by
+// calling spawn() from within execute, run() returns once taskCount tasks executed
+class WorkStealingScheduler {
+public:
+	// executes task on worker
+	typedef std::function<void(const int worker, const int task)> Execute;
+
+	// capacity is the maximum number of ready tasks a single worker can hold
+	WorkStealingScheduler(const int nthreads, const int capacity);
+	~WorkStealingScheduler();
+
+	void run(const std::vector<int>& readyTasks, const long long taskCount, const Execute& execute);
+	// makes task ready, must be called by the worker that executes the current task
+	void spawn(const int worker, const int task);
+
+	inline int getThreadCount() const { return (int)mDeques.size(); }
+	inline const std::vector<WorkerStats>& getStats() const { return mStats; }
+
+private:
+	void workerLoop(const int worker);
+
+	std::vector<WorkStealingDeque*> mDeques;
+	std::vector<WorkerStats> mStats;
+
+	const Execute* mExecute;
+	std::atomic<long long> mRemaining;
+};
+
+#endif
@@ -0,0 +1,229 @@
+#ifndef __AUTOTUNER_H
+#define __AUTOTUNER_H
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <iostream>
+
+#include "gameoflife.h"
+#include "TuningProfile.h"
+#include "Timer.h"
+
+// searches the engine parameters that are fastest for a board on this machine
+//
+// every trial restores the board, calculates one warm-up generation and then
+// times mTrialGenerations generations with cycle detection switched off
+//
+//   CPU     OpenMP threads (powers of two up to the hardware threads) and chunk
+//           size, then the tile size of the tiled engine with the best thread count
+//   OpenCL  work-group shapes the device allows and cells per work-item
+//
+// the results go into a TuningProfile, which normal runs apply with
+// Gameoflife::applyProfile
+template <class T>
+class Autotuner {
+public:
+	explicit Autotuner(Gameoflife<T>& gof);
+
+	inline void setTrialGenerations(const int generations) { mTrialGenerations = generations < 1 ? 1 : generations; }
+	// prints every trial to std::cout
+	inline void setVerbose(const bool verbose) { mVerbose = verbose; }
+
+	// threads are limited to maxThreads
+	TuningConfig tuneCPU(const int maxThreads);
+	// needs a board that went through openCL_initMem and openCL_initKernel
+	TuningConfig tuneOpenCL();
+
+	// runs both searches (OpenCL only if withOpenCL is set) and stores the results in profile
+	void tune(TuningProfile& profile, const int maxThreads, const bool withOpenCL);
+
+private:
+	// seconds per generation of mode with the current settings of mGof
+	double timeEngine(const Mode mode);
+	// puts the board the tuner started with back into mGof
+	void restore();
+
+	Gameoflife<T>& mGof;
+	std::vector<T> mBoard;
+	int mTrialGenerations;
+	bool mVerbose;
+};
+
+template <class T>
+Autotuner<T>::Autotuner(Gameoflife<T>& gof) : mGof(gof), mTrialGenerations(8), mVerbose(false) {
+	mBoard.assign(gof.mData, gof.mData+(size_t)gof.mXDim*gof.mYDim);
+}
+
+template <class T>
+void Autotuner<T>::restore() {
+	std::copy(mBoard.begin(), mBoard.end(), mGof.mData);
+	mGof.boardChanged();
+	if(mGof.mDataTmp)
+		std::copy(mBoard.begin(), mBoard.end(), mGof.mDataTmp);
+
+	// OpenCL always starts from mMemIn
+	if(mGof.mMemIn) {
+		cl_int status = clEnqueueWriteBuffer(mGof.mCmdQueue, mGof.mMemIn, CL_TRUE, 0, sizeof(T)*mBoard.size(), &mBoard[0], 0, NULL, NULL);
+		if(status != CL_SUCCESS) {
+			printf("clEnqueueWriteBuffer failed\n");
+			__debugbreak();
+			exit(-1);
+		}
+	}
+}
+
+template <class T>
+double Autotuner<T>::timeEngine(const Mode mode) {
+	restore();
+
+	Timer t;
+	if(mode == OPENCL) {
+		mGof.openCL_run(1);
+		t.start();
+		mGof.openCL_run(mTrialGenerations);
+		t.stop();
+	}
+	else {
+		mGof.evolve(mode, 1);
+		t.start();
+		mGof.evolve(mode, mTrialGenerations);
+		t.stop();
+	}
+
+	return t.getElapsedTimeInSec()/mTrialGenerations;
+}
+
+template <class T>
+TuningConfig Autotuner<T>::tuneCPU(const int maxThreads) {
+	const bool detection = mGof.mCycleDetection;
+	mGof.setCycleDetection(false);
+
+	TuningConfig best;
+	double bestTime = -1.0;
+
+	std::vector<int> threads;
+	for(int n=1;n<=maxThreads;n*=2) {
+		threads.push_back(n);
+	}
+	if(threads.back() != maxThreads)
+		threads.push_back(maxThreads);
+
+	// 0 is one even share per thread
+	const int chunks[] = {0, 1, 4, 16, 64};
+
+	for(size_t i=0;i<threads.size();++i) {
+		for(int c=0;c<5;++c) {
+			if(chunks[c] >= mGof.mYDim)
+				continue;
+
+			mGof.setThreadCount(threads[i]);
+			mGof.setChunkSize(chunks[c]);
+			const double time = timeEngine(OPENMP);
+
+			if(mVerbose)
+				std::cout << "omp threads " << threads[i] << " chunk " << chunks[c] << " seconds per generation " << time << std::endl;
+
+			if(bestTime < 0.0 || time < bestTime) {
+				bestTime = time;
+				best.threads = threads[i];
+				best.chunk = chunks[c];
+			}
+		}
+	}
+	best.secondsPerGeneration = bestTime;
+
+	// tiles have to be big enough to keep the scheduler overhead small, the
+	// full width keeps rows contiguous
+	const int rowCandidates[] = {16, 64, 256};
+	const int colCandidates[] = {256, 1024, mGof.mXDim};
+	std::vector<std::pair<int, int> > tiles;
+	for(int r=0;r<3;++r) {
+		for(int c=0;c<3;++c) {
+			// tiles larger than the board are the board
+			const std::pair<int, int> tile(std::min(rowCandidates[r], mGof.mYDim), std::min(colCandidates[c], mGof.mXDim));
+			if(std::find(tiles.begin(), tiles.end(), tile) == tiles.end())
+				tiles.push_back(tile);
+		}
+	}
+
+	double bestTileTime = -1.0;
+	mGof.setThreadCount(best.threads);
+	mGof.setChunkSize(best.chunk);
+	for(size_t i=0;i<tiles.size();++i) {
+		mGof.setTileSize(tiles[i].first, tiles[i].second);
+		const double time = timeEngine(TILED);
+
+		if(mVerbose)
+			std::cout << "tiles " << tiles[i].first << "x" << tiles[i].second << " seconds per generation " << time << std::endl;
+
+		if(bestTileTime < 0.0 || time < bestTileTime) {
+			bestTileTime = time;
+			best.tileRows = tiles[i].first;
+			best.tileCols = tiles[i].second;
+		}
+	}
+
+	mGof.setTileSize(best.tileRows, best.tileCols);
+	mGof.setCycleDetection(detection);
+	restore();
+
+	return best;
+}
+
+template <class T>
+TuningConfig Autotuner<T>::tuneOpenCL() {
+	const bool detection = mGof.mCycleDetection;
+	mGof.setCycleDetection(false);
+
+	size_t maxWorkGroup = 256;
+	clGetDeviceInfo(mGof.mDevices[mGof.mSelectedDeviceIndex], CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(size_t), &maxWorkGroup, NULL);
+
+	// the reduction of the counters needs a power of two work-group
+	const int shapes[][2] = {{8,8}, {16,4}, {16,8}, {16,16}, {32,4}, {32,8}, {64,1}, {64,4}, {128,1}, {256,1}};
+	const int cells[] = {1, 2, 4, 8};
+
+	TuningConfig best;
+	double bestTime = -1.0;
+
+	for(int s=0;s<10;++s) {
+		if((size_t)shapes[s][0]*shapes[s][1] > maxWorkGroup)
+			continue;
+
+		for(int c=0;c<4;++c) {
+			mGof.openCL_setWorkGroup(shapes[s][0], shapes[s][1], cells[c]);
+			const double time = timeEngine(OPENCL);
+
+			if(mVerbose)
+				std::cout << "ocl work-group " << shapes[s][0] << "x" << shapes[s][1] << " cells " << cells[c] << " seconds per generation " << time << std::endl;
+
+			if(bestTime < 0.0 || time < bestTime) {
+				bestTime = time;
+				best.localX = shapes[s][0];
+				best.localY = shapes[s][1];
+				best.cellsPerItem = cells[c];
+			}
+		}
+	}
+	best.secondsPerGeneration = bestTime;
+
+	if(bestTime >= 0.0)
+		mGof.openCL_setWorkGroup(best.localX, best.localY, best.cellsPerItem);
+	mGof.setCycleDetection(detection);
+	restore();
+
+	return best;
+}
+
+template <class T>
+void Autotuner<T>::tune(TuningProfile& profile, const int maxThreads, const bool withOpenCL) {
+	const int xDim = mGof.mXDim;
+	const int yDim = mGof.mYDim;
+
+	profile.set(TuningProfile::cpuIdentity(), xDim, yDim, tuneCPU(maxThreads));
+
+	if(withOpenCL)
+		profile.set(TuningProfile::deviceIdentity(mGof.openCL_deviceName()), xDim, yDim, tuneOpenCL());
+}
+
+#endif
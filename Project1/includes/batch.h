@@ -0,0 +1,313 @@
+#ifndef __BATCH_H
+#define __BATCH_H
+
+#include <vector>
+#include <map>
+#include <utility>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+#include "gameoflife.h"
+#include "ThreadPool.h"
+#include "Timer.h"
+
+// evolves many boards listed in a manifest file
+// every line of the manifest holds an input and an output file name separated
+// by whitespace, empty lines and lines starting with # are ignored
+//
+// SEQ/OPENMP: every board is loaded, evolved sequentially and saved by one
+//             worker of a shared thread pool (boards are independent, so this
+//             scales better than parallelizing a single small board)
+// OPENCL:     boards are loaded by the pool, boards of the same size are packed
+//             into one buffer and evolved by a single 3D NDRange, using one
+//             context and one compiled program for the whole manifest
+template <class T>
+class Batch {
+public:
+	explicit Batch(const char* manifestName);
+	~Batch();
+
+	bool loadManifest(const char* manifestName);
+	// returns the number of boards that were evolved and saved
+	int run(const Mode mode, const int generations, const int nthreads);
+
+	inline int getJobCount() const { return (int)mJobs.size(); }
+	inline double getBoardsPerSecond() const { return mBoardsPerSecond; }
+
+private:
+	// evolves a single job on the calling thread
+	bool runJob(const int job, const int generations);
+	// batch jobs have no rule, boards with refractory states are left out
+	bool isTwoStates(const Gameoflife<T>& gof, const int job) const;
+	int runOpenCL(const int generations, ThreadPool& pool);
+	// evolves boards of the same size with one packed NDRange
+	void runOpenCLGroup(Gameoflife<T>* env, const std::vector<Gameoflife<T>*>& boards, const int generations);
+
+	// pairs of input and output file names
+	std::vector<std::pair<std::string, std::string> > mJobs;
+
+	double mBoardsPerSecond;
+};
+
+template <class T>
+Batch<T>::Batch(const char* manifestName) : mBoardsPerSecond(0.0) {
+	loadManifest(manifestName);
+}
+
+template <class T>
+Batch<T>::~Batch() {
+}
+
+template <class T>
+bool Batch<T>::loadManifest(const char* manifestName) {
+	std::ifstream manifest(manifestName, std::ifstream::in);
+	if(!manifest.is_open()) {
+		MessageBoxA(0,"Could not load batch manifest","ERROR", MB_OK);
+		return false;
+	}
+
+	std::string line;
+	while(std::getline(manifest,line)) {
+		if(line.empty() || line[0] == '#')
+			continue;
+
+		std::stringstream ss(line);
+		std::string in;
+		std::string out;
+		ss >> in >> out;
+
+		if(in.empty())
+			continue;
+
+		if(out.empty()) {
+			std::cout << "batch: no output file for " << in << std::endl;
+			continue;
+		}
+
+		mJobs.push_back(std::make_pair(in, out));
+	}
+
+	return true;
+}
+
+template <class T>
+bool Batch<T>::isTwoStates(const Gameoflife<T>& gof, const int job) const {
+	if(gof.getMaxState() <= 1)
+		return true;
+
+	std::cout << "batch: " << mJobs[job].first << " has more than two states" << std::endl;
+	return false;
+}
+
+template <class T>
+bool Batch<T>::runJob(const int job, const int generations) {
+	Gameoflife<T> gof(mJobs[job].first.c_str());
+	if(!gof.mData || !isTwoStates(gof, job))
+		return false;
+
+	gof.evolve(SEQ, generations);
+
+	return gof.saveFile(mJobs[job].second.c_str());
+}
+
+template <class T>
+int Batch<T>::run(const Mode mode, const int generations, const int nthreads) {
+	Timer t;
+	int done = 0;
+
+	t.start();
+	{
+		ThreadPool pool(mode == SEQ ? 1 : nthreads);
+
+		if(mode == OPENCL) {
+			done = runOpenCL(generations, pool);
+		}
+		else {
+			std::vector<char> results(mJobs.size(), 0);
+
+			for(int i=0;i<(int)mJobs.size();++i) {
+				pool.enqueue([this, i, generations, &results]() {
+					results[i] = runJob(i, generations) ? 1 : 0;
+				});
+			}
+			pool.wait();
+
+			for(size_t i=0;i<results.size();++i) {
+				done += results[i];
+			}
+		}
+	}
+	t.stop();
+
+	mBoardsPerSecond = done / t.getElapsedTimeInSec();
+	return done;
+}
+
+template <class T>
+int Batch<T>::runOpenCL(const int generations, ThreadPool& pool) {
+	// boards are evolved in chunks so the packed buffers stay reasonably small
+	const int chunkSize = 256;
+
+	Gameoflife<T>* env = 0;
+	int done = 0;
+
+	for(int first=0;first<(int)mJobs.size();first+=chunkSize) {
+		const int last = (first+chunkSize < (int)mJobs.size()) ? first+chunkSize : (int)mJobs.size();
+		std::vector<Gameoflife<T>*> boards(last-first, (Gameoflife<T>*)0);
+
+		// parsing the files is independent of OpenCL, let the pool do it
+		for(int i=first;i<last;++i) {
+			pool.enqueue([this, i, first, &boards]() {
+				boards[i-first] = new Gameoflife<T>(mJobs[i].first.c_str());
+			});
+		}
+
+		// platform, device, context, queue and program are set up only once,
+		// while the pool parses the first chunk
+		if(!env) {
+			env = new Gameoflife<T>();
+			env->openCL_initPlatforms();
+			env->openCL_initDevices();
+			env->openCL_initContext();
+			env->openCL_initCommandQueue();
+			env->openCL_initProgram();
+		}
+		pool.wait();
+
+		// group boards by their dimension, each group is one NDRange
+		std::map<std::pair<int,int>, std::vector<Gameoflife<T>*> > groups;
+		for(size_t i=0;i<boards.size();++i) {
+			// a board without cells is neither evolved nor saved
+			if(boards[i]->mData && !isTwoStates(*boards[i], first+(int)i))
+				boards[i]->releaseBoard();
+			if(boards[i]->mData) {
+				groups[std::make_pair(boards[i]->mXDim, boards[i]->mYDim)].push_back(boards[i]);
+			}
+		}
+
+		for(typename std::map<std::pair<int,int>, std::vector<Gameoflife<T>*> >::iterator it=groups.begin();it!=groups.end();++it) {
+			runOpenCLGroup(env, it->second, generations);
+		}
+
+		std::vector<char> results(boards.size(), 0);
+		for(int i=first;i<last;++i) {
+			pool.enqueue([this, i, first, &boards, &results]() {
+				if(boards[i-first]->mData) {
+					results[i-first] = boards[i-first]->saveFile(mJobs[i].second.c_str()) ? 1 : 0;
+				}
+			});
+		}
+		pool.wait();
+
+		for(size_t i=0;i<boards.size();++i) {
+			done += results[i];
+			delete boards[i];
+		}
+	}
+
+	if(env)
+		delete env;
+
+	return done;
+}
+
+template <class T>
+void Batch<T>::runOpenCLGroup(Gameoflife<T>* env, const std::vector<Gameoflife<T>*>& boards, const int generations) {
+	cl_int status;
+
+	int xDim = boards[0]->mXDim;
+	int yDim = boards[0]->mYDim;
+	const size_t boardSize = sizeof(T)*xDim*yDim;
+	const size_t count = boards.size();
+
+	// pack all boards back to back into one host buffer, the pooled buffers
+	// of one chunk are reused by the next chunk of the same size
+	T* packed[2];
+	packed[0] = GridAllocator::instance().allocateCells<T>(xDim*yDim*count);
+	packed[1] = GridAllocator::instance().allocateCells<T>(xDim*yDim*count);
+	if(!packed[0] || !packed[1]) {
+		printf("out of memory for %d packed boards\n", (int)count);
+		exit(-1);
+	}
+
+	for(size_t i=0;i<count;++i) {
+		memcpy(&packed[0][i*xDim*yDim], boards[i]->mData, boardSize);
+	}
+
+	// CPU devices use the packed buffers directly (zero-copy)
+	const bool zeroCopy = env->mSelectedDeviceType == CPU;
+
+	cl_mem mem[2];
+	mem[0] = clCreateBuffer(env->mContext, CL_MEM_READ_WRITE|(zeroCopy ? CL_MEM_USE_HOST_PTR : CL_MEM_COPY_HOST_PTR), boardSize*count, packed[0], &status);
+	if(status != CL_SUCCESS || mem[0] == NULL) {
+		printf("clCreateBuffer failed\n");
+		exit(-1);
+	}
+
+	mem[1] = clCreateBuffer(env->mContext, CL_MEM_READ_WRITE|(zeroCopy ? CL_MEM_USE_HOST_PTR : 0), boardSize*count, zeroCopy ? packed[1] : NULL, &status);
+	if(status != CL_SUCCESS || mem[1] == NULL) {
+		printf("clCreateBuffer failed\n");
+		exit(-1);
+	}
+
+	cl_kernel kernel = clCreateKernel(env->mProgram, "calcGenerationBatch", &status);
+	if(status != CL_SUCCESS) {
+		printf("clCreateKernel failed\n");
+		__debugbreak();
+		exit(-1);
+	}
+
+	status = clSetKernelArg(kernel, 0, sizeof(int), &xDim);
+	status |= clSetKernelArg(kernel, 1, sizeof(int), &yDim);
+	if(status != CL_SUCCESS) {
+		printf("clSetKernelArg failed\n");
+		__debugbreak();
+		exit(-1);
+	}
+
+	size_t globalWorkSize[3] = {(size_t)xDim, (size_t)yDim, count};
+
+	// the two buffers are swapped every generation instead of copied
+	int in = 0;
+	for(int i=0;i<generations;++i) {
+		status = clSetKernelArg(kernel, 2, sizeof(cl_mem), &mem[in]);
+		status |= clSetKernelArg(kernel, 3, sizeof(cl_mem), &mem[1-in]);
+		if(status != CL_SUCCESS) {
+			printf("clSetKernelArg failed\n");
+			__debugbreak();
+			exit(-1);
+		}
+
+		status = clEnqueueNDRangeKernel(env->mCmdQueue, kernel, 3, NULL, globalWorkSize,
+							   NULL, 0, NULL, NULL);
+		if(status != CL_SUCCESS) {
+			printf("clEnqueueNDRangeKernel failed\n");
+			__debugbreak();
+			exit(-1);
+		}
+		in = 1-in;
+	}
+
+	status = clEnqueueReadBuffer(env->mCmdQueue, mem[in], CL_TRUE, 0, boardSize*count, packed[0], 0, NULL, NULL);
+	if(status != CL_SUCCESS) {
+		printf("clEnqueueReadBuffer failed\n");
+		__debugbreak();
+		exit(-1);
+	}
+
+	for(size_t i=0;i<count;++i) {
+		memcpy(boards[i]->mData, &packed[0][i*xDim*yDim], boardSize);
+		boards[i]->boardChanged();
+	}
+
+	clReleaseKernel(kernel);
+	clReleaseMemObject(mem[0]);
+	clReleaseMemObject(mem[1]);
+
+	GridAllocator::instance().release(packed[0]);
+	GridAllocator::instance().release(packed[1]);
+}
+
+#endif
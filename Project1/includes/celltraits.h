@@ -0,0 +1,98 @@
+#ifndef __CELLTRAITS_H
+#define __CELLTRAITS_H
+
+#include <stdint.h>
+
+// describes how a cell type of Gameoflife<T> stores its state
+// the engines only talk to cells through these functions, the ASCII 'x'/'.'
+// representation of the .gol files is only seen at the load/save boundary
+//
+// alive(c)        1 if the cell is alive, 0 otherwise (summed for the neighbour count)
+// next(c, n)      state of the cell in the next generation given n living neighbours
+// update(c, s)    state of the cell in the next generation if s says whether it lives,
+//                 used by rules other than B3/S23 (see largerthanlife.h)
+// fromChar(c)     converts a character of a .gol file into a cell
+// toChar(c)       converts a cell back into a character of a .gol file
+// state(c)        state of the cell under a multi-state rule, 0 dead, 1 alive and
+//                 2.. refractory (see multistate.h)
+// fromState(s)    cell in state s
+// clBuildOptions  defines passed to clBuildProgram so kernel.cl uses the same layout
+template <class T>
+struct CellTraits;
+
+// states a .gol file can hold, '.' is 0, 'x' is 1, then '2'..'9', 'A'..'Z' and 'a'..'z'
+// without the 'x'
+static const int CELL_MAX_STATES = 61;
+
+// state of a .gol character, -1 if it is none
+inline int stateFromChar(const char c) {
+	if(c == '.')
+		return 0;
+	if(c == 'x')
+		return 1;
+	if(c >= '2' && c <= '9')
+		return c-'0';
+	if(c >= 'A' && c <= 'Z')
+		return c-'A'+10;
+	if(c >= 'a' && c < 'x')
+		return c-'a'+36;
+	if(c > 'x' && c <= 'z')
+		return c-'a'+35;
+	return -1;
+}
+
+inline char stateToChar(const int s) {
+	static const char chars[] = ".x23456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwyz";
+	return (s >= 0 && s < CELL_MAX_STATES) ? chars[s] : '.';
+}
+
+// classic ASCII cells, stored exactly as they appear in the .gol files
+template <>
+struct CellTraits<char> {
+	static inline int alive(const char c) { return c == 'x'; }
+	static inline char next(const char c, const int neighbors) {
+		return ((neighbors == 3) | (alive(c) & (neighbors == 2))) ? 'x' : '.';
+	}
+	static inline char update(const char, const int survives) { return survives ? 'x' : '.'; }
+	static inline char fromChar(const char c) { return c; }
+	static inline char toChar(const char c) { return c; }
+	static inline int state(const char c) { return stateFromChar(c); }
+	static inline char fromState(const int s) { return stateToChar(s); }
+	static inline const char* clBuildOptions() { return "-D CELL_T=char -D CELL_ASCII"; }
+};
+
+// numeric 0/1 cells, the neighbour count is a plain sum of eight loads
+// which lets the compiler vectorize the inner loop of the engines
+template <>
+struct CellTraits<uint8_t> {
+	static inline int alive(const uint8_t c) { return c; }
+	static inline uint8_t next(const uint8_t c, const int neighbors) {
+		return (uint8_t)((neighbors == 3) | (c & (neighbors == 2)));
+	}
+	static inline uint8_t update(const uint8_t, const int survives) { return (uint8_t)survives; }
+	static inline uint8_t fromChar(const char c) { return c == 'x'; }
+	static inline char toChar(const uint8_t c) { return c ? 'x' : '.'; }
+	static inline int state(const uint8_t c) { return c; }
+	static inline uint8_t fromState(const int s) { return (uint8_t)s; }
+	static inline const char* clBuildOptions() { return "-D CELL_T=uchar -D CELL_BINARY"; }
+};
+
+// age tracking cells, 0 is dead and n > 0 is the number of generations the
+// cell has been alive for (saturating), a newborn cell has age 1
+template <>
+struct CellTraits<uint16_t> {
+	static inline int alive(const uint16_t c) { return c != 0; }
+	static inline uint16_t next(const uint16_t c, const int neighbors) {
+		const int survives = (neighbors == 3) | (alive(c) & (neighbors == 2));
+		return update(c, survives);
+	}
+	static inline uint16_t update(const uint16_t c, const int survives) { return (uint16_t)(survives * (c + (c < 0xFFFF))); }
+	static inline uint16_t fromChar(const char c) { return c == 'x'; }
+	static inline char toChar(const uint16_t c) { return c ? 'x' : '.'; }
+	// the age has no meaning under a multi-state rule, the cell holds the state
+	static inline int state(const uint16_t c) { return c; }
+	static inline uint16_t fromState(const int s) { return (uint16_t)s; }
+	static inline const char* clBuildOptions() { return "-D CELL_T=ushort -D CELL_AGE"; }
+};
+
+#endif
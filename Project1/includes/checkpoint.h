@@ -0,0 +1,400 @@
+#ifndef __CHECKPOINT_H
+#define __CHECKPOINT_H
+
+#include <stdint.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "celltraits.h"
+#include "transcode.h"
+#include "history.h"
+#include "DurableFile.h"
+
+// checkpoint file (.golc) of a long run, everything --resume needs to go on with it
+//
+//   header    "GOLC", version, width, height, generation of the board, generation
+//             the run stops at, mode, threads, chunk, tile rows and columns,
+//             checkpoint interval in generations and milliseconds, Larger than Life
+//             and multi-state rule (length and text, empty for B3/S23)
+//   cells     bits per cell, bytes, then the board: 1 bit per cell packed like the
+//             .golb rows, or 8 with the state of every cell of multi-state boards
+//   footer    FNV-1a hash of everything before it, "GOLC"
+//
+// all numbers are little endian like in history.h. a file whose hash or size does not
+// match is not used, see loadLatest. ages of CellTraits<uint16_t> cells restart at 1.
+struct Checkpoint {
+	Checkpoint() : xDim(0), yDim(0), generation(0), generations(0), mode(0), threads(1), chunk(0),
+				   tileRows(0), tileCols(0), everyGenerations(0), everySeconds(0.0), bitsPerCell(1) {}
+
+	int xDim;
+	int yDim;
+	// generations calculated since the first run started
+	uint64_t generation;
+	// generation the whole run stops at
+	uint64_t generations;
+	// Mode of gameoflife.h and the engine settings
+	int mode;
+	int threads;
+	int chunk;
+	int tileRows;
+	int tileCols;
+	// checkpoint interval, 0 switches either off
+	int everyGenerations;
+	double everySeconds;
+	std::string rule;
+	std::string states;
+
+	int bitsPerCell;
+	std::vector<unsigned char> cells;
+
+	void serialize(std::vector<unsigned char>& out) const;
+	// false if in is no complete checkpoint
+	bool parse(const std::vector<unsigned char>& in);
+
+	// the newest checkpoint of fileName that is complete (see DurableFile)
+	static bool loadLatest(const char* fileName, Checkpoint& checkpoint);
+
+	static const uint32_t VERSION = 1;
+};
+
+namespace checkpoint {
+
+inline uint64_t fnv1a(const unsigned char* data, const size_t n) {
+	uint64_t hash = 14695981039346656037ULL;
+	for(size_t i=0;i<n;++i) {
+		hash = (hash ^ data[i]) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+inline void putString(std::vector<unsigned char>& out, const std::string& s) {
+	history::put32(out, (uint32_t)s.length());
+	out.insert(out.end(), s.begin(), s.end());
+}
+
+// reads the fields of a checkpoint one after the other, fails once the data ends
+struct Reader {
+	const std::vector<unsigned char>& in;
+	size_t pos;
+	size_t end;
+
+	inline bool has(const size_t n) const { return n <= end-pos; }
+	inline bool get32(uint32_t& v) {
+		if(!has(4))
+			return false;
+		v = history::get32(&in[pos]);
+		pos += 4;
+		return true;
+	}
+	inline bool getInt(int& v) {
+		uint32_t u = 0;
+		if(!get32(u))
+			return false;
+		v = (int)u;
+		return true;
+	}
+	inline bool get64(uint64_t& v) {
+		if(!has(8))
+			return false;
+		v = history::get64(&in[pos]);
+		pos += 8;
+		return true;
+	}
+	inline bool getString(std::string& s) {
+		uint32_t n = 0;
+		if(!get32(n) || !has(n))
+			return false;
+		s.assign((const char*)&in[pos], n);
+		pos += n;
+		return true;
+	}
+};
+
+}
+
+inline void Checkpoint::serialize(std::vector<unsigned char>& out) const {
+	out.clear();
+	out.reserve(cells.size()+256);
+
+	const char* magic = "GOLC";
+	out.insert(out.end(), magic, magic+4);
+	history::put32(out, VERSION);
+	history::put32(out, (uint32_t)xDim);
+	history::put32(out, (uint32_t)yDim);
+	history::put64(out, generation);
+	history::put64(out, generations);
+	history::put32(out, (uint32_t)mode);
+	history::put32(out, (uint32_t)threads);
+	history::put32(out, (uint32_t)chunk);
+	history::put32(out, (uint32_t)tileRows);
+	history::put32(out, (uint32_t)tileCols);
+	history::put32(out, (uint32_t)everyGenerations);
+	history::put64(out, (uint64_t)(everySeconds*1000.0+0.5));
+	checkpoint::putString(out, rule);
+	checkpoint::putString(out, states);
+	history::put32(out, (uint32_t)bitsPerCell);
+	history::put64(out, (uint64_t)cells.size());
+	out.insert(out.end(), cells.begin(), cells.end());
+
+	history::put64(out, checkpoint::fnv1a(&out[0], out.size()));
+	out.insert(out.end(), magic, magic+4);
+}
+
+inline bool Checkpoint::parse(const std::vector<unsigned char>& in) {
+	// a write that was cut off is missing the footer or has the wrong hash
+	if(in.size() < 8+4+4 || memcmp(&in[0], "GOLC", 4) != 0 || memcmp(&in[in.size()-4], "GOLC", 4) != 0)
+		return false;
+	const size_t body = in.size()-12;
+	if(history::get64(&in[body]) != checkpoint::fnv1a(&in[0], body))
+		return false;
+
+	checkpoint::Reader r = {in, 4, body};
+	uint32_t version = 0;
+	uint64_t millis = 0;
+	uint64_t cellBytes = 0;
+	if(!r.get32(version) || version != VERSION)
+		return false;
+	if(!r.getInt(xDim) || !r.getInt(yDim) || !r.get64(generation) || !r.get64(generations) ||
+	   !r.getInt(mode) || !r.getInt(threads) || !r.getInt(chunk) || !r.getInt(tileRows) || !r.getInt(tileCols) ||
+	   !r.getInt(everyGenerations) || !r.get64(millis) || !r.getString(rule) || !r.getString(states) ||
+	   !r.getInt(bitsPerCell) || !r.get64(cellBytes))
+		return false;
+	everySeconds = millis/1000.0;
+
+	if(xDim < 1 || yDim < 1 || (bitsPerCell != 1 && bitsPerCell != 8))
+		return false;
+	const uint64_t expected = (bitsPerCell == 1) ? (uint64_t)((xDim+7)/8)*yDim : (uint64_t)xDim*yDim;
+	if(cellBytes != expected || cellBytes != body-r.pos)
+		return false;
+
+	cells.assign(in.begin()+r.pos, in.begin()+body);
+	return true;
+}
+
+inline bool Checkpoint::loadLatest(const char* fileName, Checkpoint& checkpoint) {
+	// the previous checkpoint is complete whenever the newest one is not
+	std::vector<unsigned char> data;
+	if(DurableFile::read(fileName, data) && checkpoint.parse(data))
+		return true;
+	return DurableFile::read(DurableFile::prevName(fileName).c_str(), data) && checkpoint.parse(data);
+}
+
+// writes the checkpoints of an evolving board without making it wait for the disk
+//
+// offer is called after every generation. once a checkpoint is due (every n generations
+// or t seconds) and the last one is written, the board is copied into a spare buffer
+// and the writer thread packs and writes it (see DurableFile), the simulation goes on
+// right after the copy. a checkpoint that is due while the writer is still busy waits
+// for the next generation, nothing else ever waits. finish writes the last one.
+template <class T>
+class CheckpointWriter {
+public:
+	CheckpointWriter() : mEveryGenerations(0), mEverySeconds(0.0), mNextGeneration(0),
+						 mBusy(false), mStop(false), mOk(true), mBytes(0), mCount(0) {}
+	~CheckpointWriter() { close(); }
+
+	// starts the writer thread, everyGenerations or everySeconds may be 0 but not both
+	bool open(const char* fileName, const int everyGenerations, const double everySeconds);
+	// stops the writer thread after the checkpoint it is writing
+	void close();
+	inline bool isOpen() const { return mThread.joinable(); }
+
+	// board size, engine settings and rule of the following checkpoints, cells are ignored
+	void setRun(const Checkpoint& run);
+	// generations the engines that do not stop after every generation calculate at once
+	inline int getBatch() const { return mEveryGenerations > 0 ? mEveryGenerations : 64; }
+
+	// board is at generation generation of the run
+	inline void offer(const uint64_t generation, const T* board) {
+		if(isDue(generation) && !mBusy.load(std::memory_order_acquire))
+			snapshot(generation, board);
+	}
+	// writes board as the last checkpoint and waits for it, false if any checkpoint failed
+	bool finish(const uint64_t generation, const T* board);
+
+	// bytes and checkpoints written so far
+	inline uint64_t getBytes() const { return mBytes.load(std::memory_order_relaxed); }
+	inline int getCount() const { return mCount.load(std::memory_order_relaxed); }
+
+private:
+	inline bool isDue(const uint64_t generation) const {
+		return (mEveryGenerations > 0 && generation >= mNextGeneration) ||
+			   (mEverySeconds > 0.0 && std::chrono::steady_clock::now() >= mNextTime);
+	}
+	void snapshot(const uint64_t generation, const T* board);
+	void writeLoop();
+	// packs mSpare into the cells of mJob
+	void encode();
+
+	std::string mFileName;
+	int mEveryGenerations;
+	double mEverySeconds;
+	uint64_t mNextGeneration;
+	std::chrono::steady_clock::time_point mNextTime;
+
+	// header of the next checkpoint, only used by the simulation
+	Checkpoint mRun;
+	// checkpoint and board the writer thread works on while mBusy is set
+	Checkpoint mJob;
+	std::vector<T> mSpare;
+	std::vector<unsigned char> mBuffer;
+
+	std::atomic<bool> mBusy;
+	bool mStop;
+	bool mOk;
+	std::atomic<uint64_t> mBytes;
+	std::atomic<int> mCount;
+	std::mutex mMutex;
+	std::condition_variable mSignal;
+	std::thread mThread;
+};
+
+template <class T>
+bool CheckpointWriter<T>::open(const char* fileName, const int everyGenerations, const double everySeconds) {
+	close();
+	if(everyGenerations < 1 && everySeconds <= 0.0)
+		return false;
+
+	mFileName = fileName;
+	mEveryGenerations = everyGenerations > 0 ? everyGenerations : 0;
+	mEverySeconds = everySeconds > 0.0 ? everySeconds : 0.0;
+	mStop = false;
+	mOk = true;
+	mBusy.store(false);
+	mThread = std::thread(&CheckpointWriter<T>::writeLoop, this);
+	return true;
+}
+
+template <class T>
+void CheckpointWriter<T>::close() {
+	if(!mThread.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStop = true;
+	}
+	mSignal.notify_all();
+	mThread.join();
+
+	// offer does not check whether the writer is open
+	mEveryGenerations = 0;
+	mEverySeconds = 0.0;
+}
+
+template <class T>
+void CheckpointWriter<T>::setRun(const Checkpoint& run) {
+	mRun = run;
+	mRun.everyGenerations = mEveryGenerations;
+	mRun.everySeconds = mEverySeconds;
+	mRun.cells.clear();
+
+	// the intervals count from the start of the run
+	mNextGeneration = run.generation+mEveryGenerations;
+	mNextTime = std::chrono::steady_clock::now()+std::chrono::microseconds((int64_t)(mEverySeconds*1e6));
+}
+
+template <class T>
+void CheckpointWriter<T>::snapshot(const uint64_t generation, const T* board) {
+	// the writer is idle, mJob and mSpare are ours until mBusy is set
+	const size_t size = (size_t)mRun.xDim*mRun.yDim;
+	mSpare.resize(size);
+	memcpy(&mSpare[0], board, sizeof(T)*size);
+
+	// the packed cells of the last checkpoint are reused
+	std::vector<unsigned char> cells;
+	cells.swap(mJob.cells);
+	mJob = mRun;
+	mJob.cells.swap(cells);
+	mJob.generation = generation;
+
+	mNextGeneration = generation+mEveryGenerations;
+	mNextTime = std::chrono::steady_clock::now()+std::chrono::microseconds((int64_t)(mEverySeconds*1e6));
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mBusy.store(true, std::memory_order_release);
+	}
+	mSignal.notify_all();
+}
+
+template <class T>
+bool CheckpointWriter<T>::finish(const uint64_t generation, const T* board) {
+	if(!mThread.joinable())
+		return false;
+	// no run of evolve, no board to write
+	if(mRun.xDim < 1) {
+		close();
+		return mOk;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mSignal.wait(lock, [this]() { return !mBusy.load(); });
+	}
+	snapshot(generation, board);
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mSignal.wait(lock, [this]() { return !mBusy.load(); });
+	}
+
+	close();
+	return mOk;
+}
+
+template <class T>
+void CheckpointWriter<T>::encode() {
+	const int xDim = mJob.xDim;
+	const int yDim = mJob.yDim;
+
+	if(mJob.bitsPerCell == 1) {
+		const size_t rowBytes = (size_t)(xDim+7)/8;
+		mJob.cells.assign(rowBytes*yDim, 0);
+		for(int y=0;y<yDim;++y) {
+			cellsToBits(&mSpare[(size_t)y*xDim], xDim, &mJob.cells[rowBytes*y]);
+		}
+	}
+	else {
+		mJob.cells.resize((size_t)xDim*yDim);
+		for(size_t i=0;i<mSpare.size();++i) {
+			mJob.cells[i] = (unsigned char)CellTraits<T>::state(mSpare[i]);
+		}
+	}
+}
+
+template <class T>
+void CheckpointWriter<T>::writeLoop() {
+	std::unique_lock<std::mutex> lock(mMutex);
+	while(true) {
+		mSignal.wait(lock, [this]() { return mBusy.load() || mStop; });
+		if(!mBusy.load())
+			break;
+
+		// the simulation does not touch the job while mBusy is set
+		lock.unlock();
+		encode();
+		mJob.serialize(mBuffer);
+		const bool ok = DurableFile::replace(mFileName.c_str(), mBuffer);
+		if(ok) {
+			mBytes.fetch_add(mBuffer.size(), std::memory_order_relaxed);
+			mCount.fetch_add(1, std::memory_order_relaxed);
+		}
+		else {
+			printf("checkpoint %s could not be written\n", mFileName.c_str());
+		}
+		lock.lock();
+
+		mOk = mOk && ok;
+		mBusy.store(false, std::memory_order_release);
+		mSignal.notify_all();
+	}
+}
+
+#endif
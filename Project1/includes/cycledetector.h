@@ -0,0 +1,66 @@
+#ifndef __CYCLEDETECTOR_H
+#define __CYCLEDETECTOR_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <vector>
+
+// splitmix64 finalizer, used to derive the per column/row keys of the board hash
+// kernel.cl has an identical copy so both engines produce the same hashes
+inline uint64_t mix64(uint64_t z) {
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+// key of column x in the board hash
+inline uint64_t hashKeyX(const int x) { return mix64(2*(uint64_t)x); }
+// key of row y in the board hash
+inline uint64_t hashKeyY(const int y) { return mix64(2*(uint64_t)y+1); }
+
+// remembers the hashes of the last few generations in a ring and reports
+// when a board hash shows up again, which means the board probably became periodic.
+// a hash can collide, so the caller keeps the board of the match and only takes
+// the period once the same board comes back period generations later
+//
+// the board hash is the sum over all cells of cell * (hashKeyX(x) ^ hashKeyY(y)),
+// since it is a plain sum it can be accumulated while the generation is computed
+// (per row, per thread or per work-group) in any order
+class CycleDetector {
+public:
+	explicit CycleDetector(const int historySize = 64) : mGenerations(historySize, -1), mHashes(historySize, 0),
+														 mNext(0), mPeriod(0), mStart(0) {}
+
+	// adds the hash of the board after generation, returns true if the same
+	// board was seen within the last historySize generations
+	bool add(const int generation, const uint64_t hash) {
+		for(size_t i=0;i<mHashes.size();++i) {
+			if(mGenerations[i] >= 0 && mHashes[i] == hash) {
+				mStart = mGenerations[i];
+				mPeriod = generation - mStart;
+				return true;
+			}
+		}
+
+		mGenerations[mNext] = generation;
+		mHashes[mNext] = hash;
+		mNext = (mNext+1) % mHashes.size();
+
+		return false;
+	}
+
+	// 0 as long as no cycle was found, 1 for still lifes and dead boards
+	inline int getPeriod() const { return mPeriod; }
+	// first generation of the detected cycle
+	inline int getStart() const { return mStart; }
+
+private:
+	std::vector<int> mGenerations;
+	std::vector<uint64_t> mHashes;
+	size_t mNext;
+
+	int mPeriod;
+	int mStart;
+};
+
+#endif
@@ -0,0 +1,455 @@
+#ifndef __DAEMON_H
+#define __DAEMON_H
+
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <cstdlib>
+#include <mutex>
+#include <atomic>
+
+#include "gameoflife.h"
+#include "ThreadPool.h"
+#include "LocalSocket.h"
+#include "Timer.h"
+
+// resident simulation server on a local socket
+//
+// the OpenCL platform, device, context, queue and compiled program are set up by
+// the first OpenCL job and shared by all later ones, jobs run on a thread pool that
+// lives as long as the daemon and board buffers come from the GridAllocator pool,
+// so a job only pays for loading, evolving and saving its board.
+//
+// one request per connection, every line ends with \n
+//
+//   ping                      -> pong
+//   shutdown                  -> bye, running jobs are finished first
+//   job                       followed by
+//     load <path>             board from a file, relative paths are relative to the daemon
+//     board                   or the board inline: .gol header line and that many rows
+//     generations <n>
+//     engine seq|omp|wave|tiles|inplace|ocl
+//     threads <n>             [optional]
+//     rule <rule>             [optional] Larger than Life rule, see largerthanlife.h
+//     states <rule>           [optional] multi-state Generations rule, see multistate.h
+//     save <path>             [optional] without it the board is sent back inline
+//     end
+//                             -> ok <generations> <seconds> <cycle period> <cycle start>
+//                                and, without save, board and the .gol text
+//                             -> error <message>
+
+// engine names of the protocol
+inline const char* modeName(const Mode mode) {
+	switch(mode) {
+		case SEQ:       return "seq";
+		case OPENMP:    return "omp";
+		case OPENCL:    return "ocl";
+		case WAVEFRONT: return "wave";
+		case TILED:     return "tiles";
+		case INPLACE:   return "inplace";
+	}
+	return "seq";
+}
+
+inline bool modeFromName(const std::string& name, Mode& mode) {
+	const Mode modes[] = {SEQ, OPENMP, OPENCL, WAVEFRONT, TILED, INPLACE};
+	for(int i=0;i<6;++i) {
+		if(name == modeName(modes[i])) {
+			mode = modes[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+template <class T>
+class Daemon {
+public:
+	// nthreads jobs run at the same time
+	Daemon(const char* socketPath, const int nthreads);
+	~Daemon();
+
+	// serves requests until a client sends shutdown
+	// returns false if the socket could not be opened
+	bool run();
+
+	inline int getJobsDone() const { return mJobsDone; }
+
+private:
+	struct Job {
+		Job() : isInline(false), generations(0), mode(SEQ), threads(1) {}
+
+		std::string loadPath;
+		// .gol text of an inline board
+		std::string board;
+		bool isInline;
+		int generations;
+		Mode mode;
+		int threads;
+		std::string savePath;
+		std::string rule;
+		std::string states;
+	};
+
+	void serve(LocalSocket& connection);
+	bool readJob(LocalSocket& connection, Job& job, std::string& error);
+	// returns the reply line, board receives the .gol text if the job has no save path
+	std::string runJob(const Job& job, std::string& board);
+	// warm OpenCL environment, must be called with mOpenCLMutex held
+	Gameoflife<T>* environment();
+
+	std::string mSocketPath;
+	ThreadPool mPool;
+	LocalSocket mListener;
+
+	// OpenCL jobs share one command queue, so they run one at a time
+	std::mutex mOpenCLMutex;
+	Gameoflife<T>* mEnv;
+
+	std::atomic<bool> mShutdown;
+	std::atomic<int> mJobsDone;
+};
+
+template <class T>
+Daemon<T>::Daemon(const char* socketPath, const int nthreads) : mSocketPath(socketPath), mPool(nthreads), mEnv(0),
+																mShutdown(false), mJobsDone(0) {
+}
+
+template <class T>
+Daemon<T>::~Daemon() {
+	if(mEnv)
+		delete mEnv;
+}
+
+template <class T>
+bool Daemon<T>::run() {
+	if(!mListener.listen(mSocketPath.c_str()))
+		return false;
+
+	std::cout << "daemon listening on " << mSocketPath << std::endl;
+
+	while(!mShutdown) {
+		LocalSocket* connection = new LocalSocket();
+		if(!mListener.accept(*connection) || mShutdown) {
+			delete connection;
+			break;
+		}
+
+		mPool.enqueue([this, connection]() {
+			serve(*connection);
+			delete connection;
+		});
+	}
+
+	mPool.wait();
+	mListener.close();
+
+	return true;
+}
+
+template <class T>
+void Daemon<T>::serve(LocalSocket& connection) {
+	std::string line;
+	if(!connection.readLine(line))
+		return;
+
+	if(line == "ping") {
+		connection.write("pong\n");
+	}
+	else if(line == "shutdown") {
+		mShutdown = true;
+		connection.write("bye\n");
+
+		// wakes up the accept of run()
+		LocalSocket wake;
+		wake.connect(mSocketPath.c_str());
+	}
+	else if(line == "job") {
+		Job job;
+		std::string error;
+		if(!readJob(connection, job, error)) {
+			connection.write("error " + error + "\n");
+			return;
+		}
+
+		std::string board;
+		std::string reply = runJob(job, board);
+		connection.write(reply);
+		if(!board.empty()) {
+			connection.write("board\n");
+			connection.write(board);
+		}
+	}
+	else {
+		connection.write("error unknown request " + line + "\n");
+	}
+}
+
+template <class T>
+bool Daemon<T>::readJob(LocalSocket& connection, Job& job, std::string& error) {
+	std::string line;
+	while(connection.readLine(line)) {
+		const size_t space = line.find(' ');
+		const std::string key = line.substr(0, space);
+		const std::string value = (space == std::string::npos) ? "" : line.substr(space+1);
+
+		if(key == "end") {
+			if(job.loadPath.empty() && !job.isInline) {
+				error = "no board";
+				return false;
+			}
+			if(job.generations < 1) {
+				error = "no generations";
+				return false;
+			}
+			return true;
+		}
+		else if(key == "load") {
+			job.loadPath = value;
+		}
+		else if(key == "board") {
+			// the header tells how many rows follow
+			std::string header;
+			if(!connection.readLine(header))
+				break;
+
+			const size_t comma = header.find(',');
+			const int rows = (comma == std::string::npos) ? 0 : atoi(header.c_str()+comma+1);
+			if(rows < 1) {
+				error = "invalid board header";
+				return false;
+			}
+
+			job.board = header + "\n";
+			for(int i=0;i<rows;++i) {
+				std::string row;
+				if(!connection.readLine(row))
+					break;
+				job.board += row;
+				job.board += '\n';
+			}
+			job.isInline = true;
+		}
+		else if(key == "generations") {
+			job.generations = atoi(value.c_str());
+		}
+		else if(key == "engine") {
+			if(!modeFromName(value, job.mode)) {
+				error = "unknown engine " + value;
+				return false;
+			}
+		}
+		else if(key == "threads") {
+			job.threads = atoi(value.c_str());
+			if(job.threads < 1 || job.threads > 16) {
+				error = "threads must be between 1 and 16";
+				return false;
+			}
+		}
+		else if(key == "save") {
+			job.savePath = value;
+		}
+		else if(key == "rule") {
+			LtlRule rule;
+			if(!rule.parse(value)) {
+				error = "invalid rule " + value;
+				return false;
+			}
+			job.rule = value;
+		}
+		else if(key == "states") {
+			StatesRule states;
+			if(!states.parse(value)) {
+				error = "invalid states rule " + value;
+				return false;
+			}
+			job.states = value;
+		}
+		else {
+			error = "unknown job line " + line;
+			return false;
+		}
+	}
+
+	error = "connection closed";
+	return false;
+}
+
+template <class T>
+std::string Daemon<T>::runJob(const Job& job, std::string& board) {
+	Gameoflife<T> gof;
+
+	bool loaded = false;
+	if(job.isInline) {
+		std::istringstream in(job.board);
+		loaded = gof.loadStream(in);
+	}
+	else {
+		// loadFile would open a message box on the daemon
+		std::ifstream test(job.loadPath.c_str());
+		loaded = test.is_open() && gof.loadFile(job.loadPath.c_str());
+	}
+	if(!loaded)
+		return "error could not load board\n";
+
+	gof.setThreadCount(job.threads);
+	if(!job.rule.empty())
+		gof.setRule(job.rule.c_str());
+	if(!job.states.empty() && !gof.setStates(job.states.c_str()))
+		return "error board has more states than the rule\n";
+	if(gof.getMaxState() > 1 && !gof.getStates().isSet())
+		return "error board has more than two states\n";
+
+	Timer t;
+	int done = job.generations;
+
+	t.start();
+	if(job.mode == OPENCL) {
+		std::lock_guard<std::mutex> lock(mOpenCLMutex);
+
+		gof.openCL_shareEnvironment(*environment());
+		gof.openCL_initMem();
+		gof.openCL_initKernel();
+		gof.openCL_run(job.generations);
+	}
+	else {
+		done = gof.evolve(job.mode, job.generations);
+	}
+	t.stop();
+
+	if(!job.savePath.empty()) {
+		if(!gof.saveFile(job.savePath.c_str()))
+			return "error could not save board\n";
+	}
+	else {
+		std::ostringstream out;
+		gof.saveStream(out);
+		board = out.str();
+	}
+
+	mJobsDone++;
+
+	std::ostringstream reply;
+	reply << "ok " << done << " " << t.getElapsedTimeInSec() << " " << gof.getCyclePeriod() << " " << gof.getCycleStart() << "\n";
+	return reply.str();
+}
+
+template <class T>
+Gameoflife<T>* Daemon<T>::environment() {
+	if(!mEnv) {
+		mEnv = new Gameoflife<T>();
+		mEnv->openCL_initPlatforms();
+		mEnv->openCL_initDevices();
+		mEnv->openCL_initContext();
+		mEnv->openCL_initCommandQueue();
+		mEnv->openCL_initProgram();
+	}
+	return mEnv;
+}
+
+// command line side of the daemon, sends one request per call
+class DaemonClient {
+public:
+	explicit DaemonClient(const char* socketPath) : mSocketPath(socketPath) {}
+
+	// reply of the last request
+	inline const std::string& getReply() const { return mReply; }
+
+	inline bool ping() { return request("ping\n"); }
+	inline bool shutdown() { return request("shutdown\n"); }
+
+	// evolves inFileName on the daemon and saves the result to outFileName
+	// with sendInline the board is sent over the socket and the result is written
+	// by the client, otherwise the daemon reads and writes the files itself
+	bool runJob(const char* inFileName, const char* outFileName, const bool sendInline,
+				const int generations, const Mode mode, const int nthreads);
+
+private:
+	// sends request and reads the reply line into mReply
+	bool request(const std::string& request);
+
+	std::string mSocketPath;
+	LocalSocket mSocket;
+	std::string mReply;
+};
+
+inline bool DaemonClient::request(const std::string& request) {
+	mReply.clear();
+	if(!mSocket.connect(mSocketPath.c_str())) {
+		mReply = "error daemon not running on " + mSocketPath;
+		return false;
+	}
+
+	if(!mSocket.write(request) || !mSocket.readLine(mReply)) {
+		mReply = "error no reply from daemon";
+		return false;
+	}
+
+	return mReply.compare(0, 5, "error") != 0;
+}
+
+inline bool DaemonClient::runJob(const char* inFileName, const char* outFileName, const bool sendInline,
+								 const int generations, const Mode mode, const int nthreads) {
+	std::ostringstream request;
+	request << "job\n";
+
+	if(sendInline) {
+		std::ifstream in(inFileName);
+		std::string header;
+		if(!in.is_open() || !std::getline(in, header)) {
+			mReply = "error could not load input file";
+			return false;
+		}
+		if(!header.empty() && header[header.length()-1] == '\r')
+			header.erase(header.length()-1);
+
+		// exactly as many rows as the header says, so the daemon does not wait for more
+		const size_t comma = header.find(',');
+		const int rows = (comma == std::string::npos) ? 0 : atoi(header.c_str()+comma+1);
+		request << "board\n" << header << "\n";
+		std::string row;
+		for(int i=0;i<rows;++i) {
+			if(!std::getline(in, row))
+				row.clear();
+			request << row << "\n";
+		}
+	}
+	else {
+		request << "load " << inFileName << "\n";
+		request << "save " << outFileName << "\n";
+	}
+
+	request << "generations " << generations << "\n";
+	request << "engine " << modeName(mode) << "\n";
+	request << "threads " << nthreads << "\n";
+	request << "end\n";
+
+	if(!this->request(request.str()))
+		return false;
+
+	if(sendInline) {
+		std::string line;
+		if(!mSocket.readLine(line) || line != "board" || !mSocket.readLine(line)) {
+			mReply = "error no board in reply";
+			return false;
+		}
+
+		std::ofstream out(outFileName, std::ios::out|std::ios::binary);
+		if(!out.is_open()) {
+			mReply = "error could not open output file";
+			return false;
+		}
+
+		// header line, then its number of rows
+		out << line << "\n";
+		const size_t comma = line.find(',');
+		const int rows = (comma == std::string::npos) ? 0 : atoi(line.c_str()+comma+1);
+		for(int i=0;i<rows && mSocket.readLine(line);++i) {
+			out << line << "\n";
+		}
+	}
+
+	return true;
+}
+
+#endif
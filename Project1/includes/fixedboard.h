@@ -0,0 +1,135 @@
+#ifndef __FIXEDBOARD_H
+#define __FIXEDBOARD_H
+
+#include <stdint.h>
+#include <omp.h>
+
+#include "celltraits.h"
+#include "rowkernel.h"
+#include "cycledetector.h"
+#include "statistics.h"
+
+// B3/S23 generations of boards with one of the standard sizes of our jobs, with the
+// dimensions as template parameters instead of runtime ints
+//
+// every size below is its own specialisation of FixedDims, step picks it from the
+// dimensions of the loaded board and returns false for every other size, which
+// then takes the dynamic engine. with the dimensions known at compile time
+//   - rows wrap around with a mask (power of two heights) or a constant modulus
+//   - every row pointer is in + y*W with a constant stride
+//   - the row loop has a constant trip count, the compiler unrolls and vectorizes it
+//     without remainder loops, the two wrapping columns are peeled off at constant indices
+//   - the counters of a row are summed up over exactly W cells as well
+//
+// a new size only needs another case in step
+template <int W, int H>
+struct FixedDims {
+	static const int X = W;
+	static const int Y = H;
+
+	// y is in [-1, H]
+	static inline int wrapY(const int y) {
+		return ((H & (H-1)) == 0) ? (y & (H-1)) : (y+H)%H;
+	}
+};
+
+template <class T>
+class FixedEngine {
+public:
+	// calculates the generation after in into out (out must not alias in) with nthreads
+	// OpenMP threads and rows of chunk rows per task (0 is one share per thread),
+	// stats receives hash and counters if keysX is set
+	// false if there is no specialisation for xDim x yDim, nothing is calculated then
+	bool step(const T* in, T* out, const int xDim, const int yDim, const int nthreads, const int chunk,
+			  const uint64_t* keysX, GenerationStats& stats) const;
+
+	// true if step has a specialisation for the size
+	static bool supports(const int xDim, const int yDim);
+
+private:
+	template <class D>
+	void stepFixed(const T* in, T* out, const int nthreads, const int chunk, const uint64_t* keysX, GenerationStats& stats) const;
+	template <class D, bool tracked>
+	static inline void calcRow(const T* in, T* out, const int y, const uint64_t* keysX, GenerationStats& stats);
+};
+
+template <class T>
+bool FixedEngine<T>::supports(const int xDim, const int yDim) {
+	if(xDim != yDim)
+		return false;
+
+	switch(xDim) {
+		case 256: case 512: case 1024: case 2048: case 4096: return true;
+		default: return false;
+	}
+}
+
+template <class T>
+bool FixedEngine<T>::step(const T* in, T* out, const int xDim, const int yDim, const int nthreads, const int chunk,
+						  const uint64_t* keysX, GenerationStats& stats) const {
+	if(!supports(xDim, yDim))
+		return false;
+
+	switch(xDim) {
+		case 256: stepFixed<FixedDims<256, 256> >(in, out, nthreads, chunk, keysX, stats); break;
+		case 512: stepFixed<FixedDims<512, 512> >(in, out, nthreads, chunk, keysX, stats); break;
+		case 1024: stepFixed<FixedDims<1024, 1024> >(in, out, nthreads, chunk, keysX, stats); break;
+		case 2048: stepFixed<FixedDims<2048, 2048> >(in, out, nthreads, chunk, keysX, stats); break;
+		default: stepFixed<FixedDims<4096, 4096> >(in, out, nthreads, chunk, keysX, stats); break;
+	}
+	return true;
+}
+
+template <class T>
+template <class D, bool tracked>
+inline void FixedEngine<T>::calcRow(const T* in, T* out, const int y, const uint64_t* keysX, GenerationStats& stats) {
+	const int W = D::X;
+	const T* top = in+D::wrapY(y-1)*W;
+	const T* mid = in+y*W;
+	const T* bot = in+D::wrapY(y+1)*W;
+	T* row = out+y*W;
+
+	row[0] = calcCell(top, mid, bot, W-1, 0, 1);
+	for(int x=1;x<W-1;++x) {
+		row[x] = calcCell(top, mid, bot, x-1, x, x+1);
+	}
+	row[W-1] = calcCell(top, mid, bot, W-2, W-1, 0);
+
+	if(!tracked)
+		return;
+
+	// W is a constant here, so the counting loop has a fixed trip count as well
+	countRowCells(mid, row, y, W, keysX, stats);
+}
+
+template <class T>
+template <class D>
+void FixedEngine<T>::stepFixed(const T* in, T* out, const int nthreads, const int chunk, const uint64_t* keysX, GenerationStats& stats) const {
+	const int rowsPerTask = chunk > 0 ? chunk : (D::Y+nthreads-1)/nthreads;
+
+	uint64_t hash = 0;
+	uint64_t population = 0;
+	uint64_t births = 0;
+	uint64_t deaths = 0;
+
+	#pragma omp parallel for num_threads(nthreads) schedule(dynamic, rowsPerTask) reduction(+:hash,population,births,deaths) if(nthreads > 1)
+	for(int y=0;y<D::Y;++y) {
+		GenerationStats row;
+		if(keysX)
+			calcRow<D, true>(in, out, y, keysX, row);
+		else
+			calcRow<D, false>(in, out, y, keysX, row);
+
+		hash += row.hash;
+		population += row.population;
+		births += row.births;
+		deaths += row.deaths;
+	}
+
+	stats.hash = hash;
+	stats.population = population;
+	stats.births = births;
+	stats.deaths = deaths;
+}
+
+#endif
@@ -0,0 +1,507 @@
+#ifndef __FUZZER_H
+#define __FUZZER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+#include "gameoflife.h"
+
+// differential fuzzing of the engines against the sequential one
+//
+// every case is a random board (tiny, odd and ordinary dimensions, the smallest size
+// of fixedboard.h, any density, sometimes a Larger than Life or a multi-state rule)
+// that calcGeneration evolves one generation at a time with the dynamic engine, the
+// hash of every generation is the reference. every engine configuration (threads,
+// chunks, tiles, work-groups) then evolves the same board:
+//
+//   omp, inplace       one generation per evolve, board hash and counters are
+//                      compared after every generation
+//   wave, tiles        run several generations at once, compared after 1, 2, 4, ...
+//   ocl                restarts from the first generation for every check, compared
+//                      after 1, 2, 4, ... (only with setOpenCL)
+//
+// Larger than Life and multi-state cases are only an independent check for ocl: the
+// reference and every CPU engine end up in calcGenerationOpenMP there, which uses
+// the same LtlEngine/StatesEngine, so they only compare thread counts of one engine.
+//
+// a case an engine fails is shrunk: the generations are cut to the first one that
+// differs, then rows, columns and living cells are removed as long as the engine
+// still fails. the smallest board is written to fuzz_<case>.gol and the command
+// line that replays it, with its rule and generations, is printed
+template <class T>
+class Fuzzer {
+public:
+	Fuzzer(const uint64_t seed, const int maxDim);
+	~Fuzzer();
+
+	// also fuzz the OpenCL engine, the device is set up once for all cases
+	void setOpenCL(const bool enabled);
+	// prints every case to std::cout
+	inline void setVerbose(const bool verbose) { mVerbose = verbose; }
+
+	// runs cases random cases, returns the number of cases an engine failed
+	int run(const int cases);
+
+private:
+	struct Engine {
+		std::string name;
+		Mode mode;
+		int threads;
+		int chunk;
+		int tileRows;
+		int tileCols;
+		int localX;
+		int localY;
+		int cellsPerItem;
+	};
+
+	struct Case {
+		int xDim;
+		int yDim;
+		// .gol characters row by row, only 'x' and '.' without states
+		std::string cells;
+		std::string rule;
+		std::string states;
+		int generations;
+	};
+
+	void addEngine(const char* name, const Mode mode, const int threads, const int chunk = 0, const int tileRows = 0, const int tileCols = 0);
+	Case randomCase();
+	// dimension that is tiny, odd or anything up to mMaxDim
+	int randomDim();
+	std::string randomRule();
+	std::string randomStates(int& states);
+
+	// board of c, false if the rule is invalid
+	bool load(Gameoflife<T>& board, const Case& c) const;
+	uint64_t boardHash(const Gameoflife<T>& board) const;
+	// hashes and counters of generations 1 to c.generations of the sequential engine
+	void reference(const Case& c, std::vector<uint64_t>& hashes, std::vector<GenerationStats>& stats) const;
+	// first generation engine e differs from the reference in, 0 if it never does
+	int check(const Case& c, const Engine& e);
+	// smallest case engine e still fails
+	Case shrink(Case c, const Engine& e);
+	void save(const Case& c, const char* fileName) const;
+	// arguments that run the engine on the saved case, the rule is not in the .gol file
+	std::string replay(const Case& c, const Engine& e, const std::string& fileName) const;
+
+	std::mt19937_64 mRandom;
+	int mMaxDim;
+	bool mVerbose;
+	std::vector<Engine> mEngines;
+	// platforms, devices, context, queue and program shared by all OpenCL boards
+	Gameoflife<T>* mOpenCL;
+};
+
+template <class T>
+Fuzzer<T>::Fuzzer(const uint64_t seed, const int maxDim) : mRandom(seed), mMaxDim(maxDim < 1 ? 1 : maxDim), mVerbose(false), mOpenCL(0) {
+	addEngine("omp 1", OPENMP, 1);
+	addEngine("omp 2", OPENMP, 2);
+	addEngine("omp 3 chunk 1", OPENMP, 3, 1);
+	addEngine("omp 4 chunk 3", OPENMP, 4, 3);
+	addEngine("inplace 1", INPLACE, 1);
+	addEngine("inplace 2", INPLACE, 2);
+	addEngine("inplace 5", INPLACE, 5);
+	addEngine("wave 2", WAVEFRONT, 2);
+	addEngine("wave 3", WAVEFRONT, 3);
+	addEngine("wave 7", WAVEFRONT, 7);
+	addEngine("tiles 3 2x3", TILED, 3, 0, 2, 3);
+	addEngine("tiles 4 5x7", TILED, 4, 0, 5, 7);
+	addEngine("tiles 2 64x1024", TILED, 2, 0, 64, 1024);
+}
+
+template <class T>
+Fuzzer<T>::~Fuzzer() {
+	delete mOpenCL;
+}
+
+template <class T>
+void Fuzzer<T>::addEngine(const char* name, const Mode mode, const int threads, const int chunk, const int tileRows, const int tileCols) {
+	Engine e;
+	e.name = name;
+	e.mode = mode;
+	e.threads = threads;
+	e.chunk = chunk;
+	e.tileRows = tileRows;
+	e.tileCols = tileCols;
+	e.localX = 0;
+	e.localY = 0;
+	e.cellsPerItem = 0;
+	mEngines.push_back(e);
+}
+
+template <class T>
+void Fuzzer<T>::setOpenCL(const bool enabled) {
+	if(!enabled || mOpenCL)
+		return;
+
+	mOpenCL = new Gameoflife<T>();
+	mOpenCL->openCL_initPlatforms();
+	mOpenCL->openCL_initDevices();
+	mOpenCL->openCL_initContext();
+	mOpenCL->openCL_initCommandQueue();
+	mOpenCL->openCL_initProgram();
+
+	const int shapes[][3] = {{16,16,1}, {8,8,2}, {64,1,4}, {4,4,8}};
+	for(int i=0;i<4;++i) {
+		std::ostringstream name;
+		name << "ocl " << shapes[i][0] << "x" << shapes[i][1] << " cells " << shapes[i][2];
+		addEngine(name.str().c_str(), OPENCL, 0);
+		mEngines.back().localX = shapes[i][0];
+		mEngines.back().localY = shapes[i][1];
+		mEngines.back().cellsPerItem = shapes[i][2];
+	}
+}
+
+template <class T>
+int Fuzzer<T>::randomDim() {
+	switch(mRandom()%4) {
+		// 1 to 4, the neighbours wrap onto the cell itself
+		case 0: return 1+(int)(mRandom()%4);
+		// odd, no vector width divides it
+		case 1: return 1+2*(int)(mRandom()%(mMaxDim < 66 ? (mMaxDim+1)/2 : 33));
+		default: return 1+(int)(mRandom()%mMaxDim);
+	}
+}
+
+template <class T>
+std::string Fuzzer<T>::randomRule() {
+	const int radius = 1+(int)(mRandom()%3);
+	const bool vonNeumann = mRandom()%2 == 1;
+	const bool center = mRandom()%2 == 1;
+	const int cells = (vonNeumann ? 2*radius*(radius+1) : (2*radius+1)*(2*radius+1)-1) + (center ? 1 : 0);
+
+	int range[4];
+	for(int i=0;i<4;++i) {
+		range[i] = (int)(mRandom()%(cells+1));
+	}
+	for(int i=0;i<4;i+=2) {
+		if(range[i] > range[i+1])
+			std::swap(range[i], range[i+1]);
+	}
+
+	std::ostringstream rule;
+	rule << "R" << radius << ",C0,M" << (center ? 1 : 0) << ",S" << range[0] << ".." << range[1]
+		 << ",B" << range[2] << ".." << range[3] << ",N" << (vonNeumann ? "N" : "M");
+	return rule.str();
+}
+
+template <class T>
+std::string Fuzzer<T>::randomStates(int& states) {
+	states = 3+(int)(mRandom()%6);
+	// B0 is no valid rule
+	const int birth = (int)(mRandom()%512) & ~1;
+	const int survival = (int)(mRandom()%512);
+
+	std::ostringstream rule;
+	rule << "B";
+	for(int n=0;n<9;++n) {
+		if(birth & (1 << n))
+			rule << n;
+	}
+	rule << "/S";
+	for(int n=0;n<9;++n) {
+		if(survival & (1 << n))
+			rule << n;
+	}
+	rule << "/C" << states;
+	return rule.str();
+}
+
+template <class T>
+typename Fuzzer<T>::Case Fuzzer<T>::randomCase() {
+	Case c;
+	c.xDim = randomDim();
+	c.yDim = randomDim();
+	// the engines with compile-time dimensions
+	if(mRandom()%16 == 0)
+		c.xDim = c.yDim = 256;
+	c.generations = 1+(int)(mRandom()%48);
+
+	// empty and full boards are rare with a uniform density, so they get their own share
+	double density;
+	switch(mRandom()%8) {
+		case 0: density = 0.0; break;
+		case 1: density = 1.0; break;
+		default: density = std::uniform_real_distribution<double>(0.0, 1.0)(mRandom); break;
+	}
+
+	std::bernoulli_distribution alive(density);
+	c.cells.resize((size_t)c.xDim*c.yDim);
+	for(size_t i=0;i<c.cells.size();++i) {
+		c.cells[i] = alive(mRandom) ? 'x' : '.';
+	}
+
+	if(mRandom()%4 == 0) {
+		c.rule = randomRule();
+	}
+	else if(mRandom()%6 == 0) {
+		int states;
+		c.states = randomStates(states);
+		// living cells get any state but dead
+		for(size_t i=0;i<c.cells.size();++i) {
+			if(c.cells[i] == 'x')
+				c.cells[i] = stateToChar(1+(int)(mRandom()%(states-1)));
+		}
+	}
+
+	return c;
+}
+
+template <class T>
+bool Fuzzer<T>::load(Gameoflife<T>& board, const Case& c) const {
+	std::stringstream text;
+	text << c.xDim << "," << c.yDim << "\n";
+	for(int y=0;y<c.yDim;++y) {
+		text.write(&c.cells[(size_t)y*c.xDim], c.xDim);
+		text << "\n";
+	}
+
+	// the states of the rule are known while the board is read
+	if(!c.states.empty() && !board.setStates(c.states.c_str()))
+		return false;
+	if(!board.loadStream(text))
+		return false;
+	return c.rule.empty() || board.setRule(c.rule.c_str());
+}
+
+template <class T>
+uint64_t Fuzzer<T>::boardHash(const Gameoflife<T>& board) const {
+	// FNV-1a over the state of the cells, independent of the hash of the engines
+	uint64_t hash = 14695981039346656037ULL;
+	const size_t size = (size_t)board.mXDim*board.mYDim;
+	const bool states = board.getStates().isSet();
+	for(size_t i=0;i<size;++i) {
+		hash ^= (uint64_t)(states ? CellTraits<T>::state(board.mData[i]) : CellTraits<T>::alive(board.mData[i]));
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+template <class T>
+void Fuzzer<T>::reference(const Case& c, std::vector<uint64_t>& hashes, std::vector<GenerationStats>& stats) const {
+	Gameoflife<T> board;
+	load(board, c);
+	board.setFixedDims(false);
+
+	hashes.assign(1, boardHash(board));
+	stats.assign(1, GenerationStats());
+	for(int g=1;g<=c.generations;++g) {
+		// a single generation can not be a cycle, evolve only tracks the counters
+		board.evolve(SEQ, 1);
+		hashes.push_back(boardHash(board));
+		stats.push_back(board.getStats());
+	}
+}
+
+template <class T>
+int Fuzzer<T>::check(const Case& c, const Engine& e) {
+	std::vector<uint64_t> hashes;
+	std::vector<GenerationStats> stats;
+	reference(c, hashes, stats);
+
+	Gameoflife<T> board;
+	if(e.mode == OPENCL)
+		board.openCL_shareEnvironment(*mOpenCL);
+	if(!load(board, c))
+		return 0;
+
+	board.setThreadCount(e.threads);
+	board.setChunkSize(e.chunk);
+	if(e.tileRows > 0)
+		board.setTileSize(e.tileRows, e.tileCols);
+
+	if(e.mode == OPENMP || e.mode == INPLACE) {
+		for(int g=1;g<=c.generations;++g) {
+			board.evolve(e.mode, 1);
+
+			const GenerationStats& s = board.getStats();
+			if(boardHash(board) != hashes[g] || s.hash != stats[g].hash || s.population != stats[g].population ||
+			   s.births != stats[g].births || s.deaths != stats[g].deaths)
+				return g;
+		}
+		return 0;
+	}
+
+	if(e.mode == OPENCL) {
+		board.openCL_setWorkGroup(e.localX, e.localY, e.cellsPerItem);
+		board.openCL_initMem();
+		board.openCL_initKernel();
+	}
+	const std::vector<T> first(board.mData, board.mData+(size_t)c.xDim*c.yDim);
+
+	int done = 0;
+	for(int g=1;done<c.generations;g*=2) {
+		const int next = g < c.generations ? g : c.generations;
+
+		if(e.mode == OPENCL) {
+			// openCL_run always starts from mMemIn
+			cl_int status = clEnqueueWriteBuffer(board.mCmdQueue, board.mMemIn, CL_TRUE, 0, sizeof(T)*first.size(), &first[0], 0, NULL, NULL);
+			if(status != CL_SUCCESS) {
+				printf("clEnqueueWriteBuffer failed\n");
+				__debugbreak();
+				exit(-1);
+			}
+			board.openCL_run(next);
+		}
+		else {
+			board.evolve(e.mode, next-done);
+		}
+		done = next;
+
+		if(boardHash(board) != hashes[done])
+			return done;
+	}
+
+	return 0;
+}
+
+template <class T>
+typename Fuzzer<T>::Case Fuzzer<T>::shrink(Case c, const Engine& e) {
+	c.generations = check(c, e);
+
+	// every accepted step makes the case smaller, the budget only limits big boards
+	int budget = 4000;
+	bool smaller = true;
+	while(smaller && budget > 0) {
+		smaller = false;
+
+		for(int y=0;y<c.yDim && c.yDim > 1 && budget > 0;--budget) {
+			Case t = c;
+			t.yDim--;
+			t.cells.erase((size_t)y*c.xDim, c.xDim);
+			const int g = check(t, e);
+			if(g > 0) {
+				t.generations = g;
+				c = t;
+				smaller = true;
+			}
+			else {
+				++y;
+			}
+		}
+
+		for(int x=0;x<c.xDim && c.xDim > 1 && budget > 0;--budget) {
+			Case t = c;
+			t.xDim--;
+			t.cells.clear();
+			for(int y=0;y<c.yDim;++y) {
+				t.cells.append(c.cells, (size_t)y*c.xDim, x);
+				t.cells.append(c.cells, (size_t)y*c.xDim+x+1, c.xDim-x-1);
+			}
+			const int g = check(t, e);
+			if(g > 0) {
+				t.generations = g;
+				c = t;
+				smaller = true;
+			}
+			else {
+				++x;
+			}
+		}
+
+		for(size_t i=0;i<c.cells.size() && budget > 0;++i) {
+			if(c.cells[i] == '.')
+				continue;
+
+			--budget;
+			Case t = c;
+			t.cells[i] = '.';
+			const int g = check(t, e);
+			if(g > 0) {
+				t.generations = g;
+				c = t;
+				smaller = true;
+			}
+		}
+	}
+
+	return c;
+}
+
+template <class T>
+void Fuzzer<T>::save(const Case& c, const char* fileName) const {
+	std::ofstream out(fileName);
+	out << c.xDim << "," << c.yDim << "\n";
+	for(int y=0;y<c.yDim;++y) {
+		out.write(&c.cells[(size_t)y*c.xDim], c.xDim);
+		out << "\n";
+	}
+}
+
+template <class T>
+std::string Fuzzer<T>::replay(const Case& c, const Engine& e, const std::string& fileName) const {
+	// the engine names start with the name of their mode, chunks and work-groups have
+	// no switch of their own
+	std::ostringstream args;
+	args << "--mode " << e.name.substr(0, e.name.find(' '));
+	if(e.threads > 0)
+		args << " --threads " << e.threads;
+	if(e.tileRows > 0)
+		args << " --tile " << e.tileRows << " " << e.tileCols;
+	args << " --load " << fileName;
+	if(!c.rule.empty())
+		args << " --ltl " << c.rule;
+	if(!c.states.empty())
+		args << " --states " << c.states;
+	args << " --generations " << c.generations;
+	return args.str();
+}
+
+template <class T>
+int Fuzzer<T>::run(const int cases) {
+	int failed = 0;
+
+	for(int i=0;i<cases;++i) {
+		const Case c = randomCase();
+
+		if(mVerbose) {
+			std::cout << "case " << i << " " << c.xDim << "x" << c.yDim << " generations " << c.generations;
+			if(!c.rule.empty())
+				std::cout << " rule " << c.rule;
+			if(!c.states.empty())
+				std::cout << " states " << c.states;
+			std::cout << std::endl;
+		}
+
+		for(size_t e=0;e<mEngines.size();++e) {
+			const int g = check(c, mEngines[e]);
+			if(g == 0)
+				continue;
+
+			std::cout << "case " << i << ": " << mEngines[e].name << " differs from seq in generation " << g
+					  << " of a " << c.xDim << "x" << c.yDim << " board";
+			if(!c.rule.empty())
+				std::cout << " with rule " << c.rule;
+			if(!c.states.empty())
+				std::cout << " with states " << c.states;
+			std::cout << std::endl;
+
+			const Case s = shrink(c, mEngines[e]);
+			std::ostringstream fileName;
+			fileName << "fuzz_" << i << ".gol";
+			save(s, fileName.str().c_str());
+
+			int population = 0;
+			for(size_t k=0;k<s.cells.size();++k) {
+				population += s.cells[k] != '.';
+			}
+			std::cout << "  shrunk to " << s.xDim << "x" << s.yDim << " with " << population << " living cells, differs in generation "
+					  << s.generations << ", written to " << fileName.str() << std::endl;
+			std::cout << "  replay with " << replay(s, mEngines[e], fileName.str()) << " against --mode seq" << std::endl;
+
+			++failed;
+			// one engine per case is enough, the others most likely fail for the same reason
+			break;
+		}
+	}
+
+	return failed;
+}
+
+#endif
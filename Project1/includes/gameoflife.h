@@ -8,13 +8,39 @@
 #include <iostream>
 #include <string>
 #include <map>
+#include <algorithm>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <future>
+#include <chrono>
 #include <CL/cl.h>
 #include <omp.h>
 
+#include "celltraits.h"
+#include "rowkernel.h"
+#include "cycledetector.h"
+#include "statistics.h"
+#include "WorkStealing.h"
+#include "GridAllocator.h"
+#include "patterncodec.h"
+#include "history.h"
+#include "checkpoint.h"
+#include "largerthanlife.h"
+#include "multistate.h"
+#include "fixedboard.h"
+#include "lightcone.h"
+#include "TuningProfile.h"
+#include "transcode.h"
+#include "Metrics.h"
+
 enum Mode {
 	SEQ,
 	OPENMP,
-	OPENCL
+	OPENCL,
+	WAVEFRONT,
+	TILED,
+	INPLACE
 };
 
 enum Devicetype {
@@ -24,21 +50,124 @@ enum Devicetype {
 
 char* readSource(const char *sourceFilename);
 
+template <class T>
+class Batch;
+
+template <class T>
+class Autotuner;
+
+template <class T>
+class Fuzzer;
+
+template <class T>
+class BoardView;
+
+template <class T>
+class GenerationRange;
+
 template <class T>
 class Gameoflife {
 public:
+	// empty board, loadFile has to be called before anything else (see openCL_initAsync)
+	Gameoflife();
 	explicit Gameoflife(const char* fileName);
 	~Gameoflife();
 
 	bool loadFile(const char* fileName);
 	bool saveFile(const char* fileName);
+	// .gol text from/to any stream, used for boards sent to the daemon
+	bool loadStream(std::istream& in);
+	bool saveStream(std::ostream& out) const;
 	bool cmpFiles(const char* fileName1, const char* fileName2) const;
 	void calcGeneration(void);
 
+	// calculates up to generations generations with the selected CPU engine
+	// stops early once the board became periodic, see getCyclePeriod
+	// returns the number of generations that were actually calculated
+	int evolve(Mode mode, const int generations);
+	// replaces the board by the width x height window at x, y (wrapping around the board)
+	// as it is after generations generations. B3/S23 only calculates the backward light
+	// cone of the window (see lightcone.h), other rules and windows whose cone costs more
+	// than the board evolve the whole board with mode. false if the window is empty
+	bool evolveWindow(const Mode mode, const int x, const int y, const int width, const int height, const int generations);
+	// the next count generations, each calculated when the consumer gets to it
+	// the board is seen through views of the front buffer, see generations.h
+	GenerationRange<T> generations(const Mode mode, const int count);
+	// the board as it is, without a copy, see generations.h
+	BoardView<T> view() const;
+
+	// hash of the board after the last calculated generation (see CycleDetector)
+	inline uint64_t getHash() const { return mStats.hash; }
+	// population, births and deaths of the last calculated generation
+	// only counted while cycle detection or a statistics file is enabled
+	inline const GenerationStats& getStats() const { return mStats; }
+	// streams the counters of every generation of evolve/openCL_run into a file
+	inline bool openStatistics(const char* fileName) { return mStatsWriter.open(fileName); }
+	// hashing the generations and detecting cycles can be switched off
+	inline void setCycleDetection(const bool enabled) { mCycleDetection = enabled; }
+	// the seq and OpenMP engines use compile-time dimensions for the standard board
+	// sizes (see fixedboard.h), this switches back to the dynamic engine
+	inline void setFixedDims(const bool enabled) { mFixedDims = enabled; }
+	// period of the cycle found by the last run (1 = still life), 0 if there was none
+	inline int getCyclePeriod() const { return mCyclePeriod; }
+	// generation in which the cycle found by the last run started
+	inline int getCycleStart() const { return mCycleStart; }
+	// records every following generation of evolve (SEQ/OPENMP) into a history file
+	// with a full keyframe every keyframeInterval generations, see history.h
+	inline bool openHistory(const char* fileName, const int keyframeInterval) { mHistoryBytes = 0; return mHistory.open(fileName, mXDim, mYDim, keyframeInterval, mData); }
+	inline void closeHistory() { mHistory.close(); }
+	// replaces the board with the given generation of a history file
+	bool loadHistory(const char* fileName, const int generation);
+	// checkpoints of every following run of evolve, every generations generations and/or
+	// every seconds seconds (0 switches either off), written in the background, see checkpoint.h
+	inline bool openCheckpoints(const char* fileName, const int generations, const double seconds) { mCheckpointBytes = 0; return mCheckpoints.open(fileName, generations, seconds); }
+	// writes the board as the last checkpoint, false if any checkpoint could not be written
+	inline bool closeCheckpoints() { return mCheckpoints.finish(mGeneration, mData); }
+	// replaces the board, rule and engine settings with the latest complete checkpoint of
+	// fileName, mode and the generation the run stops at are left in checkpoint
+	bool loadCheckpoint(const char* fileName, Checkpoint& checkpoint);
+	// generations evolve calculated so far, a resumed board goes on from its checkpoint
+	inline uint64_t getGeneration() const { return mGeneration; }
+
+	// Larger than Life rule instead of B3/S23 (see largerthanlife.h), false if rule is invalid
+	// has to be set before openCL_initMem, the wavefront and tiled engines use OpenMP for it
+	bool setRule(const char* rule);
+	inline const LtlRule& getRule() const { return mRule; }
+	// multi-state Generations rule like B2/S/C3 instead of B3/S23 (see multistate.h),
+	// false if the rule is invalid or the board has states the rule does not know
+	// the same restrictions as for setRule apply, it replaces a Larger than Life rule
+	bool setStates(const char* rule);
+	inline const StatesRule& getStates() const { return mStates; }
+	// highest state of the loaded board, anything above 1 needs setStates
+	inline int getMaxState() const { return mMaxState; }
+
+	// point in time the first generation of the last evolve/openCL_run was done
+	// (the end of the whole run for the wavefront and tiled engines)
+	inline std::chrono::steady_clock::time_point getFirstGenerationTime() const { return mFirstGeneration; }
+
 	// openMP 
 	bool loadFileOpenMP(const char* fileName);
 	void calcGenerationOpenMP(void);
+	// calculates generations generations without a barrier between them, every
+	// thread owns a band of rows and only waits for the rows of its neighbours
+	void calcGenerationsWavefront(const int generations);
+	// calculates generations generations as a graph of tile tasks on a work-stealing
+	// scheduler, a tile of generation g+1 runs once its neighbour tiles reached g
+	void calcGenerationsTiled(const int generations);
+	// calculates the next generation straight into mData, only a few rows of the old
+	// generation are kept (two per thread at the band borders, two rolling rows per
+	// thread), the second board mDataTmp is never allocated
+	void calcGenerationInPlace(void);
+	inline void setTileSize(const int rows, const int cols) { mTileRows = rows; mTileCols = cols; }
+	// steal and idle counters of every worker of the last tiled run
+	inline const std::vector<WorkerStats>& getSchedulerStats() const { return mSchedulerStats; }
 	inline void setThreadCount(const int nthreads) { mThreadCount = nthreads; }
+	// rows the OpenMP threads take at a time, 0 splits the board evenly
+	inline void setChunkSize(const int rows) { mChunk = rows; }
+	// takes threads, chunk and tile size (and the OpenCL work-group size once a device
+	// is selected) from the profile entry of this machine closest to the board size
+	// returns false if the profile has no entry for this machine
+	bool applyProfile(const TuningProfile& profile);
 
 	// openCL
 	inline void openCL_chooseDeviceType(Devicetype deviceType) { mSelectedDeviceType = deviceType; }
@@ -49,14 +178,102 @@ public:
 	void openCL_initMem();
 	void openCL_initProgram();
 	void openCL_initKernel();
+	// loads the board on a second thread while platforms, devices, context, queue
+	// and program are set up (none of them needs the board), then creates the
+	// buffers and the kernel. replaces loadFile and the seven openCL_init* calls
+	// with a profile the work-group size of the board and device is applied before the buffers are created
+	bool openCL_initAsync(const char* fileName, const TuningProfile* profile = 0);
 	void openCL_run(const int generations);
+	// uses the platforms, devices, context, queue and program of env (which has to
+	// outlive this board) instead of setting up its own, only openCL_initMem and
+	// openCL_initKernel are left to call
+	void openCL_shareEnvironment(const Gameoflife<T>& env);
+	// work-group size (powers of two, at most the maximum of the device) and cells every
+	// work-item calculates next to each other in a row, may be changed after openCL_initKernel
+	// false if the work-group does not fit, the old one is kept then
+	bool openCL_setWorkGroup(const int localX, const int localY, const int cellsPerItem);
+	// name of the selected device, empty before openCL_initDevices
+	std::string openCL_deviceName() const;
 	
 	// std::ostream can use private array of gof
 	friend std::ostream& operator<<(std::ostream& os, const Gameoflife<T>& gof);
+	// batch mode packs the data of many boards and shares the OpenCL setup
+	friend class Batch<T>;
+	// the autotuner restores the board between its trials
+	friend class Autotuner<T>;
+	// the fuzzer hashes the boards of every engine and restores OpenCL boards
+	friend class Fuzzer<T>;
+	// the range steps the engines one generation at a time
+	friend class GenerationRange<T>;
 private:
+	// calculates row y of the next generation into mDataTmp
+	// adds hash and counters of the new row to stats if tracked is set
+	template <bool tracked>
+	void calcRow(const int y, GenerationStats& stats);
+	// adds hash and counters of row y that changed from was to is to stats
+	void countRow(const int y, const T* was, const T* is, GenerationStats& stats) const;
+	// one generation with the engine of mode, OPENCL is not supported
+	void calcGenerationMode(const Mode mode);
+	// the second board is allocated by the first engine that needs it
+	void allocBackBuffer();
+	// board size, engine and rule of a run of evolve for the checkpoints
+	void startCheckpoints(const Mode mode, const int generations);
+	// hands generations generations calculated since since to Metrics
+	void recordMetrics(const int generations, std::chrono::steady_clock::time_point& since, const bool population);
+	// hash and counters are only computed if somebody needs them
+	inline bool isTracked() const { return mCycleDetection || mStatsWriter.isOpen() || Metrics::instance().isEnabled(); }
+	// sets up the column keys of the board hash after loading
+	void initHashKeys();
+	// next generation of the Larger than Life rule with nthreads threads
+	void calcGenerationLtl(const int nthreads);
+	// next generation of the multi-state rule with nthreads threads
+	void calcGenerationStates(const int nthreads);
+	// rules other than B3/S23 only run on the seq and OpenMP engines
+	inline bool hasRule() const { return mRule.isSet() || mStates.isSet(); }
+	// the cells were written by something else than the engines, see StatesEngine::invalidate
+	inline void boardChanged() { mStatesEngine.invalidate(); }
+	// .gol text of row y
+	void rowToText(const int y, char* text) const;
+	// allocates an all dead board for the pattern loaders
+	bool allocBoard(const int xDim, const int yDim);
+	// gives the buffers back to the pool after a failed load, always returns false
+	bool releaseBoard();
+	// the engines index cells with int, so a board stays well below 2^31 cells
+	static const int64_t MAX_CELLS = (int64_t)1 << 30;
+	static inline bool isBoardSize(const int xDim, const int yDim) {
+		return xDim > 0 && yDim > 0 && (int64_t)xDim*yDim <= MAX_CELLS;
+	}
+	// RLE/Life 1.06/binary files, see patterncodec.h
+	bool loadPattern(const char* fileName, const PatternFormat format);
+	bool savePattern(const char* fileName, const PatternFormat format);
+
+	// lets the pattern readers decode straight into the board
+	struct PatternSink {
+		Gameoflife<T>* gol;
+
+		inline bool resize(const int xDim, const int yDim) { return gol->allocBoard(xDim, yDim); }
+		inline void setAlive(const int x, const int y, const int n) {
+			// the readers clip their runs, this only keeps a broken one off the heap
+			if(x < 0 || y < 0 || n < 1 || y >= gol->mYDim || x > gol->mXDim-n)
+				return;
+			std::fill(gol->mIndexArray[y]+x, gol->mIndexArray[y]+x+n, CellTraits<T>::fromChar('x'));
+		}
+	};
+	// global work size padded to a multiple of mLocalWorkSize, returns the number of work-groups
+	int openCL_globalWorkSize(size_t* globalWorkSize) const;
+	// number of partial counters every generation writes to mMemStats
+	int openCL_statsGroups() const;
+	// (re)creates mMemStats for the current work-group size
+	void openCL_initStats();
+	// enqueues one Larger than Life generation (prefix sums, then the rule)
+	void openCL_enqueueLtl(cl_mem in, cl_mem out, int statsOffset);
+	// copies the cells of mem into board (mXDim*mYDim cells) once the queue is done with it
+	void openCL_readBoard(cl_mem mem, T* board);
+
 	std::ifstream mInputFile;
 	std::fstream mOutputFile;
 	// contiguous chunk of memory that holds the data
+	// board buffers come from GridAllocator, so they are aligned and pooled
 	T* mData;
 	// copy of mData
 	T* mDataTmp;
@@ -69,6 +286,47 @@ private:
 	int mYDim;
 
 	int mThreadCount;
+	int mChunk;
+
+	// saved band border rows and rolling rows of the in-place engine
+	std::vector<T> mInPlaceRows;
+
+	// tile size of the tiled engine
+	int mTileRows;
+	int mTileCols;
+	std::vector<WorkerStats> mSchedulerStats;
+
+	// hash and counters of the current generation
+	GenerationStats mStats;
+	StatisticsWriter mStatsWriter;
+	// hashKeyX for every column
+	std::vector<uint64_t> mHashKeysX;
+	bool mCycleDetection;
+	int mCyclePeriod;
+	int mCycleStart;
+
+	std::chrono::steady_clock::time_point mFirstGeneration;
+
+	HistoryRecorder<T> mHistory;
+	// history bytes that were already counted by Metrics
+	uint64_t mHistoryBytes;
+
+	CheckpointWriter<T> mCheckpoints;
+	// checkpoint bytes that were already counted by Metrics
+	uint64_t mCheckpointBytes;
+	uint64_t mGeneration;
+
+	// Larger than Life rule, plain Life if it is not set
+	LtlRule mRule;
+	LtlEngine<T> mLtl;
+	// multi-state rule, only one of mRule and mStates is set
+	StatesRule mStates;
+	StatesEngine<T> mStatesEngine;
+	int mMaxState;
+	// B3/S23 engine of the standard sizes
+	FixedEngine<T> mFixed;
+	bool mFixedDims;
+	LightCone<T> mLightCone;
 
 	//OPENCL specific code
 
@@ -92,54 +350,121 @@ private:
 	// command queue to selected device
 	cl_command_queue mCmdQueue; 
 
-	// input and output memory
+	// input and output memory, swapped every generation
 	cl_mem mMemIn;
 	cl_mem mMemOut;
 
+	// partial hashes and counters (GenerationStats), one per work-group for up to STATS_BATCH generations
+	cl_mem mMemStats;
+
+	// work-group size, the global size is padded to a multiple of it
+	size_t mLocalWorkSize[2];
+	// cells of a row every work-item calculates
+	int mCellsPerItem;
+
+	// number of generations whose statistics are read back at once
+	static const int STATS_BATCH = 16;
+
 	// source code of kernel
 	cl_program mProgram;
 
 	// kernel running on the GPU
 	cl_kernel mKernel;
+
+	// prefix sums of the padded board and the two kernels of a Larger than Life rule
+	cl_mem mMemLtlA;
+	cl_mem mMemLtlB;
+	cl_kernel mLtlPrefixKernel;
+	cl_kernel mLtlRuleKernel;
 };
 
 template <class T>
-Gameoflife<T>::Gameoflife(const char* fileName) : mData(0), mDataTmp(0), mIndexArray(0), mXDim(0), mYDim(0), mThreadCount(1),
+Gameoflife<T>::Gameoflife() : mData(0), mDataTmp(0), mIndexArray(0), mXDim(0), mYDim(0), mThreadCount(1), mChunk(0),
+												  mTileRows(64), mTileCols(1024),
+												  mCycleDetection(true), mCyclePeriod(0), mCycleStart(0), mHistoryBytes(0),
+												  mCheckpointBytes(0), mGeneration(0), mMaxState(0), mFixedDims(true),
 											      mNumPlatforms(0), mPlatforms(0),
 												  mNumDevices(0), mDevices(0),
 												  mContext(0), mCmdQueue(0),
-												  mMemIn(0), mMemOut(0),
+												  mMemIn(0), mMemOut(0), mMemStats(0),
 												  mProgram(0), mKernel(0),
+												  mMemLtlA(0), mMemLtlB(0), mLtlPrefixKernel(0), mLtlRuleKernel(0),
 												  mSelectedDeviceIndex(0), mSelectedDeviceType(GPU)
 
 {
+	mLocalWorkSize[0] = 16;
+	mLocalWorkSize[1] = 16;
+	mCellsPerItem = 1;
+}
+
+template <class T>
+Gameoflife<T>::Gameoflife(const char* fileName) : Gameoflife() {
 	loadFile(fileName);
 }
 
 template <class T>
 Gameoflife<T>::~Gameoflife() {
-	if(mData)
-		delete[] mData;
-	if(mDataTmp) 
-		delete[] mDataTmp;
-	if(mIndexArray)
-		delete[] mIndexArray;
+	// zero-copy buffers wrap mData/mDataTmp, so the device has to be done with them
+	// and they have to be gone before the host memory goes back to the pool
+	if(mCmdQueue && (mMemIn || mMemOut))
+		clFinish(mCmdQueue);
+	if(mMemIn)
+		clReleaseMemObject(mMemIn);
+	if(mMemOut)
+		clReleaseMemObject(mMemOut);
+	if(mMemStats)
+		clReleaseMemObject(mMemStats);
+	if(mKernel)
+		clReleaseKernel(mKernel);
+	if(mMemLtlA)
+		clReleaseMemObject(mMemLtlA);
+	if(mMemLtlB)
+		clReleaseMemObject(mMemLtlB);
+	if(mLtlPrefixKernel)
+		clReleaseKernel(mLtlPrefixKernel);
+	if(mLtlRuleKernel)
+		clReleaseKernel(mLtlRuleKernel);
+
+	// buffers go back to the pool for the next board
+	GridAllocator::instance().release(mData);
+	GridAllocator::instance().release(mDataTmp);
+	GridAllocator::instance().release(mIndexArray);
 
 	// dont forget to free OpenCL data
 }
 
 template <class T>
 bool Gameoflife<T>::loadFile(const char* fileName) {
-	// open input file
-	mInputFile.open(fileName, std::ifstream::in);
-	if(!mInputFile.is_open()) {
-		MessageBoxA(0,"Could not load input file","ERROR", MB_OK);
-		return false;
+	// RLE, Life 1.06 and binary boards are decoded straight into the board
+	const PatternFormat format = patternFormat(fileName);
+	if(format != FORMAT_GOL) {
+		if(!loadPattern(fileName, format))
+			return false;
 	}
+	else {
+		// open input file
+		mInputFile.open(fileName, std::ifstream::in);
+		if(!mInputFile.is_open()) {
+			MessageBoxA(0,"Could not load input file","ERROR", MB_OK);
+			return false;
+		}
 
+		if(!loadStream(mInputFile)) {
+			MessageBoxA(0,"Input file is not a valid .gol file","ERROR", MB_OK);
+			return false;
+		}
+	}
+
+	if(Metrics::instance().isEnabled())
+		Metrics::instance().addBytesRead(Metrics::fileBytes(fileName));
+	return true;
+}
+
+template <class T>
+bool Gameoflife<T>::loadStream(std::istream& in) {
 	std::string line;
 	// get first line for information about x and y dim
-	std::getline(mInputFile,line);
+	std::getline(in,line);
 
 	{
 		std::stringstream ss;
@@ -158,18 +483,42 @@ bool Gameoflife<T>::loadFile(const char* fileName) {
 		ss >> mYDim;
 	}
 
-	int offset = 0;
+	// boards can come over the daemon socket, do not trust the header blindly
+	if(!isBoardSize(mXDim, mYDim))
+		return false;
+
+	size_t offset = 0;
 	int row = 0;
+	mMaxState = 0;
 
+	// a board that was loaded before, the back buffer would have its size
+	releaseBoard();
 	// alloc one more byte of memory for the 0 byte at the end of the last line
-	mData = new T[mXDim*mYDim+1];
+	mData = GridAllocator::instance().allocateCells<T>((size_t)mXDim*mYDim+1);
 	// allocating array for mYDim char*s
-	mIndexArray = new T*[mYDim];
+	mIndexArray = GridAllocator::instance().allocateCells<T*>(mYDim);
+	if(!mData || !mIndexArray)
+		return releaseBoard();
 
-	while(std::getline(mInputFile,line)){
+	while(row < mYDim && std::getline(in,line)){
 		// currently not saving 0 byte use c_str()+1 instead if needed and change allocated amount of memory to myDimX+1 instead of myDimX
 		//strcpy(mData+offset,line.c_str());
-		memcpy(mData+offset,line.c_str(),line.length());
+		// ASCII is converted into the cell representation of T right here,
+		// anything but 'x' and '.' is found by the same pass
+		const int len = (int)line.length() < mXDim ? (int)line.length() : mXDim;
+		if(!textToCells(line.c_str(), len, mData+offset)) {
+			// the rows of multi-state boards take the slow way
+			for(int x=0;x<len;++x) {
+				const int state = stateFromChar(line[x]);
+				if(state < 0 || (mStates.isSet() && state >= mStates.states))
+					return releaseBoard();
+				if(state > mMaxState)
+					mMaxState = state;
+				mData[offset+x] = CellTraits<T>::fromState(state);
+			}
+		}
+		// pooled memory is not cleared, a short row is dead up to the end
+		std::fill(mData+offset+len, mData+offset+mXDim, CellTraits<T>::fromChar('.'));
 		// storing the pointer to the line in mData array just copied
 		mIndexArray[row] = mData+offset;
 
@@ -178,13 +527,19 @@ bool Gameoflife<T>::loadFile(const char* fileName) {
 		offset = offset+mXDim;
 		row++;
 	}
+
+	// rows that are missing would leave mIndexArray pointing nowhere
+	if(row < mYDim)
+		return releaseBoard();
+	boardChanged();
 	
-	mDataTmp = new T[mXDim*mYDim+1];
-	memcpy(mDataTmp,mData,mXDim*mYDim+1);
+	// the second board is allocated by the first engine that needs it, see allocBackBuffer
 
 	// last line seems to end with a 0 byte anyway in input files
 	//mIndexArray[mYDim][mXDim-1] = '\0';
 
+	initHashKeys();
+
 	return true;
 }
 
@@ -222,15 +577,18 @@ bool Gameoflife<T>::loadFileOpenMP(const char* fileName) {
 	int row = 0;
 
 	// alloc one more byte of memory for the 0 byte at the end of the last line
-	mData = new T[mXDim*mYDim+1];
+	mData = GridAllocator::instance().allocateCells<T>(mXDim*mYDim+1);
 	// allocating array for mYDim char*s
-	mIndexArray = new T*[mYDim];
+	mIndexArray = GridAllocator::instance().allocateCells<T*>(mYDim);
 	#pragma omp parallel
 	{
 		while(std::getline(mInputFile,line)){
 			// currently not saving 0 byte use c_str()+1 instead if needed and change allocated amount of memory to myDimX+1 instead of myDimX
 			//strcpy(mData+offset,line.c_str());
-			memcpy(mData+offset,line.c_str(),line.length());
+			const int len = (int)line.length() < mXDim ? (int)line.length() : mXDim;
+			for(int x=0;x<len;++x) {
+				mData[offset+x] = CellTraits<T>::fromChar(line[x]);
+			}
 			// storing the pointer to the line in mData array just copied
 			mIndexArray[row] = mData+offset;
 
@@ -241,195 +599,808 @@ bool Gameoflife<T>::loadFileOpenMP(const char* fileName) {
 		}
 	}
 
-	mDataTmp = new T[mXDim*mYDim+1];
-	memcpy(mDataTmp,mData,mXDim*mYDim+1);
+	// the second board is allocated by the first engine that needs it, see allocBackBuffer
 
 	// last line seems to end with a 0 byte anyway in input files
 	//mIndexArray[mYDim][mXDim-1] = '\0';
 
+	initHashKeys();
+
 	return true;
 }
 
+template <class T>
+void Gameoflife<T>::initHashKeys() {
+	mHashKeysX.resize(mXDim);
+	for(int x=0;x<mXDim;++x) {
+		mHashKeysX[x] = hashKeyX(x);
+	}
+}
+
+template <class T>
+template <bool tracked>
+inline void Gameoflife<T>::calcRow(const int y, GenerationStats& stats) {
+	// axes are notated as [y][x] since this is the layout of the indexData array
+	const T* top = mIndexArray[(y-1+mYDim)%mYDim];
+	const T* mid = mIndexArray[y];
+	const T* bot = mIndexArray[(y+1)%mYDim];
+	T* out = mDataTmp+(y*mXDim);
+
+	calcRowCells(top, mid, bot, out, mXDim);
+
+	// the new row is still in L1, hashing and counting it here saves a pass over the board
+	if(tracked)
+		countRow(y, mid, out, stats);
+}
+
+template <class T>
+inline void Gameoflife<T>::countRow(const int y, const T* was, const T* is, GenerationStats& stats) const {
+	countRowCells(was, is, y, mXDim, &mHashKeysX[0], stats);
+}
+
+template <class T>
+void Gameoflife<T>::allocBackBuffer() {
+	if(mDataTmp)
+		return;
+
+	mDataTmp = GridAllocator::instance().allocateCells<T>(mXDim*mYDim+1);
+	if(!mDataTmp) {
+		MessageBoxA(0,"Not enough memory for the board","ERROR", MB_OK);
+		exit(-1);
+	}
+	memcpy(mDataTmp,mData,sizeof(T)*(mXDim*mYDim+1));
+}
+
 template <class T>
 void Gameoflife<T>::calcGeneration() {
-	for(int y=0;y<mYDim;++y) {
-		for(int x=0;x<mXDim;++x){
-			int neighbors = 0;
-			// axes are notated as [y][x] since this is the layout of the indexData array
-			// x = size of array x; y = size of array y
-			
-			int xLeft = x-1;
-			int xRight = x+1;
-			int yTop = y-1;
-			int yBot = y+1;
+	if(mRule.isSet()) {
+		calcGenerationLtl(1);
+		return;
+	}
+	if(mStates.isSet()) {
+		calcGenerationStates(1);
+		return;
+	}
 
-			if(x==0) {
-				xLeft = (x-1+mXDim)%mXDim;
-			}
+	allocBackBuffer();
 
-			if(x==mXDim-1) {
-				xRight = (x+1+mXDim)%mXDim;
-			}
+	GenerationStats stats;
+	const bool tracked = isTracked();
 
-			if(y==0) {
-				yTop = (y-1+mYDim)%mYDim;
+	// standard sizes are done with compile-time dimensions
+	if(!mFixedDims || !mFixed.step(mData, mDataTmp, mXDim, mYDim, 1, 0, tracked ? &mHashKeysX[0] : 0, stats)) {
+		if(tracked) {
+			for(int y=0;y<mYDim;++y) {
+				calcRow<true>(y, stats);
 			}
-
-			if(y==mYDim-1) {
-				yBot = (y+1+mYDim)%mYDim;
+		}
+		else {
+			for(int y=0;y<mYDim;++y) {
+				calcRow<false>(y, stats);
 			}
+		}
+	}
 
-			// in case of accessing element on [-1][-1]
-			if(mIndexArray[yTop][xLeft] == 'x') {
-				neighbors++;
-			}
+	mStats = stats;
 
-			// in case of accessing element on [-1][0]
-			if(mIndexArray[yTop][x] == 'x') {
-				neighbors++;
-			}
+	// the old board is still in mData, which makes the delta a plain diff
+	if(mHistory.isOpen())
+		mHistory.record(mData, mDataTmp);
 
-			// in case of accessing element on [-1][x]
-			if(mIndexArray[yTop][xRight] == 'x') {
-				neighbors++;
-			}
+	memcpy(mData,mDataTmp,sizeof(T)*(mXDim*mYDim+1));
+}
 
-			// in case of accessing element on [0][-1]
-			if(mIndexArray[y][xLeft] == 'x') {
-				neighbors++;
-			}
+template <class T>
+void Gameoflife<T>::calcGenerationOpenMP() {
+	if(mRule.isSet()) {
+		calcGenerationLtl(mThreadCount);
+		return;
+	}
+	if(mStates.isSet()) {
+		calcGenerationStates(mThreadCount < 1 ? 1 : mThreadCount);
+		return;
+	}
 
-			// in case of accessing element on [0][x]
-			if(mIndexArray[y][xRight] == 'x') {
-				neighbors++;
-			}
+	allocBackBuffer();
 
-			// in case of accessing element on [y][-1]
-			if(mIndexArray[yBot][xLeft] == 'x') {
-				neighbors++;
-			}
+	const int nthreads = mThreadCount < 1 ? 1 : mThreadCount;
+	// without a chunk size every thread gets one even share of the rows
+	const int chunk = mChunk > 0 ? mChunk : (mYDim+nthreads-1)/nthreads;
 
-			// in case of accessing element on [y][0]
-			if(mIndexArray[yBot][x] == 'x') {
-				neighbors++;
+	const bool tracked = isTracked();
+
+	// standard sizes are done with compile-time dimensions
+	if(!mFixedDims || !mFixed.step(mData, mDataTmp, mXDim, mYDim, nthreads, mChunk, tracked ? &mHashKeysX[0] : 0, mStats)) {
+		uint64_t hash = 0;
+		uint64_t population = 0;
+		uint64_t births = 0;
+		uint64_t deaths = 0;
+	
+		#pragma omp parallel num_threads(nthreads)
+		{
+			// every thread accumulates the counters of its rows privately,
+			// they are combined once at the end of the loop
+			#pragma omp for schedule(dynamic, chunk) reduction(+:hash,population,births,deaths)
+			for(int y=0;y<mYDim;++y) {
+				GenerationStats row;
+				if(tracked)
+					calcRow<true>(y, row);
+				else
+					calcRow<false>(y, row);
+
+				hash += row.hash;
+				population += row.population;
+				births += row.births;
+				deaths += row.deaths;
 			}
+		} // parallel section end 
+
+		mStats.hash = hash;
+		mStats.population = population;
+		mStats.births = births;
+		mStats.deaths = deaths;
+	}
+
+	if(mHistory.isOpen())
+		mHistory.record(mData, mDataTmp);
+
+	memcpy(mData,mDataTmp,sizeof(T)*(mXDim*mYDim+1));
+}
+
+template <class T>
+void Gameoflife<T>::calcGenerationLtl(const int nthreads) {
+	allocBackBuffer();
+
+	GenerationStats stats;
+	mLtl.step(mRule, mData, mDataTmp, mXDim, mYDim, nthreads, isTracked() ? &mHashKeysX[0] : 0, stats);
+	mStats = stats;
+
+	if(mHistory.isOpen())
+		mHistory.record(mData, mDataTmp);
+
+	memcpy(mData,mDataTmp,sizeof(T)*(mXDim*mYDim+1));
+}
+
+template <class T>
+void Gameoflife<T>::calcGenerationStates(const int nthreads) {
+	// the engine keeps the board as bit-planes and writes the cells straight into mData,
+	// only the history needs the old generation next to it
+	if(mHistory.isOpen()) {
+		allocBackBuffer();
+		memcpy(mDataTmp,mData,sizeof(T)*(mXDim*mYDim+1));
+	}
+
+	GenerationStats stats;
+	mStatesEngine.step(mStates, mData, mXDim, mYDim, nthreads, isTracked() ? &mHashKeysX[0] : 0, stats);
+	mStats = stats;
+
+	if(mHistory.isOpen())
+		mHistory.record(mDataTmp, mData);
+}
+
+template <class T>
+bool Gameoflife<T>::setRule(const char* rule) {
+	if(!mRule.parse(rule))
+		return false;
+	mStates = StatesRule();
+	return true;
+}
+
+template <class T>
+bool Gameoflife<T>::setStates(const char* rule) {
+	StatesRule parsed;
+	if(!parsed.parse(rule) || mMaxState >= parsed.states)
+		return false;
+
+	mStates = parsed;
+	mRule = LtlRule();
+	return true;
+}
 
-			// in case of accessing element on [y][x]
-			if(mIndexArray[yBot][xRight] == 'x') {
-				neighbors++;
+template <class T>
+void Gameoflife<T>::rowToText(const int y, char* text) const {
+	if(mMaxState > 1 || mStates.isSet())
+		statesToText(mIndexArray[y], mXDim, text);
+	else
+		cellsToText(mIndexArray[y], mXDim, text);
+}
+
+template <class T>
+void Gameoflife<T>::calcGenerationsWavefront(const int generations) {
+	allocBackBuffer();
+
+	const int size = mXDim*mYDim;
+
+	// generation g lives in buffers[g%2], writing generation g+1 of a row therefore
+	// destroys generation g-1 of it. both dangers (reading a row of a neighbour that
+	// is not done yet and overwriting a row a neighbour still needs) are covered by:
+	//   first row of a band at g+1 waits until the band above finished g completely
+	//   last row of a band at g+1 waits until the band below finished the first row of g
+	// every band counts its finished rows over all generations, so the counters only grow
+	struct Progress {
+		std::atomic<int> rows;
+		char padding[64-sizeof(std::atomic<int>)];
+	};
+	std::vector<Progress> progress(mThreadCount);
+	std::vector<int> firstRow(mThreadCount+1);
+	int bands = 1;
+
+	T* buffers[2] = {mData, mDataTmp};
+
+	#pragma omp parallel num_threads(mThreadCount)
+	{
+		// the runtime may hand out less threads than asked for, one band per thread we got
+		#pragma omp single
+		{
+			bands = (omp_get_num_threads() < mYDim) ? omp_get_num_threads() : mYDim;
+			for(int b=0;b<bands;++b) {
+				progress[b].rows.store(0, std::memory_order_relaxed);
+				firstRow[b] = (int)(((long long)mYDim*b)/bands);
 			}
-			if(mIndexArray[y][x] == 'x') {
-				if(neighbors > 3 || neighbors < 2) {
-					mDataTmp[x+(y*mXDim)]= '.';
+			firstRow[bands] = mYDim;
+		} // implicit barrier
+
+		const int b = omp_get_thread_num();
+
+		if(b < bands) {
+			const int above = (b-1+bands)%bands;
+			const int below = (b+1)%bands;
+			const int rowsAbove = firstRow[above+1]-firstRow[above];
+			const int rowsBelow = firstRow[below+1]-firstRow[below];
+			const int rows = firstRow[b+1]-firstRow[b];
+
+			for(int g=0;g<generations;++g) {
+				const T* in = buffers[g%2];
+				T* out = buffers[(g+1)%2];
+
+				for(int y=firstRow[b];y<firstRow[b+1];++y) {
+					if(y == firstRow[b] && g > 0) {
+						while(progress[above].rows.load(std::memory_order_acquire) < g*rowsAbove) {
+							std::this_thread::yield();
+						}
+					}
+					if(y == firstRow[b+1]-1 && g > 0) {
+						while(progress[below].rows.load(std::memory_order_acquire) < (g-1)*rowsBelow+1) {
+							std::this_thread::yield();
+						}
+					}
+
+					calcRowCells(in+((y-1+mYDim)%mYDim)*mXDim, in+y*mXDim, in+((y+1)%mYDim)*mXDim, out+y*mXDim, mXDim);
+					progress[b].rows.store(g*rows+(y-firstRow[b])+1, std::memory_order_release);
 				}
 			}
-			else {
-				if(neighbors == 3) {
-					mDataTmp[x+(y*mXDim)]= 'x';
+		}
+	} // parallel section end
+
+	// the result has to end up in mData since mIndexArray points into it
+	if(generations%2)
+		memcpy(mData,mDataTmp,sizeof(T)*size);
+	else
+		memcpy(mDataTmp,mData,sizeof(T)*size);
+}
+
+template <class T>
+void Gameoflife<T>::calcGenerationsTiled(const int generations) {
+	if(generations < 1)
+		return;
+
+	allocBackBuffer();
+
+	const int tileRows = mTileRows < 1 ? 1 : mTileRows;
+	const int tileCols = mTileCols < 1 ? 1 : mTileCols;
+	const int tilesY = (mYDim+tileRows-1)/tileRows;
+	const int tilesX = (mXDim+tileCols-1)/tileCols;
+	const int tiles = tilesX*tilesY;
+
+	// tile t of generation g is task (g-1)*tiles+t, it reads generation g-1 of its
+	// neighbour tiles and overwrites generation g-2 of its own tile, which the
+	// neighbours needed for generation g-1. so it depends on generation g-1 of all
+	// tiles around it (itself included), the neighbourhood is symmetric which makes
+	// these tiles also the successors of a task
+	std::vector<std::vector<int> > neighbors(tiles);
+	for(int ty=0;ty<tilesY;++ty) {
+		for(int tx=0;tx<tilesX;++tx) {
+			std::vector<int>& list = neighbors[tx+ty*tilesX];
+			for(int dy=-1;dy<=1;++dy) {
+				for(int dx=-1;dx<=1;++dx) {
+					const int n = (tx+dx+tilesX)%tilesX + ((ty+dy+tilesY)%tilesY)*tilesX;
+					// small grids wrap onto the same tile more than once
+					if(std::find(list.begin(), list.end(), n) == list.end())
+						list.push_back(n);
 				}
 			}
 		}
 	}
-	memcpy(mData,mDataTmp,mXDim*mYDim+1);
+
+	// unfinished predecessors of every task, only four generations can be in flight
+	// (a task resets the counter of its tile two generations ahead when it starts,
+	// nobody can decrement that one before this task finished)
+	const int slots = 4;
+	std::vector<std::atomic<int> > pending(slots*tiles);
+	for(int t=0;t<tiles;++t) {
+		pending[(2%slots)*tiles+t].store((int)neighbors[t].size());
+	}
+
+	std::vector<int> ready(tiles);
+	for(int t=0;t<tiles;++t) {
+		ready[t] = t;
+	}
+
+	T* buffers[2] = {mData, mDataTmp};
+
+	WorkStealingScheduler scheduler(mThreadCount, 4*tiles);
+	scheduler.run(ready, (long long)tiles*generations, [&](const int worker, const int task) {
+		const int g = task/tiles+1;
+		const int t = task%tiles;
+
+		if(g+2 <= generations)
+			pending[((g+2)%slots)*tiles+t].store((int)neighbors[t].size(), std::memory_order_relaxed);
+
+		const T* in = buffers[(g-1)%2];
+		T* out = buffers[g%2];
+
+		const int y0 = (t/tilesX)*tileRows;
+		const int y1 = (y0+tileRows < mYDim) ? y0+tileRows : mYDim;
+		const int x0 = (t%tilesX)*tileCols;
+		const int x1 = (x0+tileCols < mXDim) ? x0+tileCols : mXDim;
+
+		for(int y=y0;y<y1;++y) {
+			calcRowCellsRange(in+((y-1+mYDim)%mYDim)*mXDim, in+y*mXDim, in+((y+1)%mYDim)*mXDim, out+y*mXDim, mXDim, x0, x1);
+		}
+
+		if(g < generations) {
+			for(size_t i=0;i<neighbors[t].size();++i) {
+				const int n = neighbors[t][i];
+				if(pending[((g+1)%slots)*tiles+n].fetch_sub(1, std::memory_order_acq_rel) == 1)
+					scheduler.spawn(worker, g*tiles+n);
+			}
+		}
+	});
+
+	mSchedulerStats = scheduler.getStats();
+
+	// the result has to end up in mData since mIndexArray points into it
+	if(generations%2)
+		memcpy(mData,mDataTmp,sizeof(T)*mXDim*mYDim);
+	else
+		memcpy(mDataTmp,mData,sizeof(T)*mXDim*mYDim);
 }
 
 template <class T>
-void Gameoflife<T>::calcGenerationOpenMP() {
-	
-	omp_set_num_threads(4);
-	
-	#pragma omp parallel
-	{
-		int nthreads = omp_get_num_threads();
-		
-		#pragma omp for
+void Gameoflife<T>::calcGenerationInPlace() {
+	// other rules and the history need the whole old generation
+	if(hasRule() || mHistory.isOpen()) {
+		calcGenerationOpenMP();
+		return;
+	}
 
-		for(int y=0;y<mYDim;++y) {
-			for(int x=0;x<mXDim;++x){
-				int neighbors = 0;
-				// axes are notated as [y][x] since this is the layout of the indexData array
-				// x = size of array x; y = size of array y
-			
-				int xLeft = x-1;
-				int xRight = x+1;
-				int yTop = y-1;
-				int yBot = y+1;
+	const int bands = (mThreadCount < 1) ? 1 : (mThreadCount < mYDim ? mThreadCount : mYDim);
+	const bool tracked = isTracked();
 
-				if(x==0) {
-					xLeft = (x-1+mXDim)%mXDim;
-				}
+	// per band: old row above the band, old row below the band and two rolling rows
+	mInPlaceRows.resize((size_t)4*bands*mXDim);
+	T* rows = &mInPlaceRows[0];
 
-				if(x==mXDim-1) {
-					xRight = (x+1)%mXDim;
-				}
+	uint64_t hash = 0;
+	uint64_t population = 0;
+	uint64_t births = 0;
+	uint64_t deaths = 0;
 
-				if(y==0) {
-					yTop = (y-1+mYDim)%mYDim;
-				}
+	#pragma omp parallel num_threads(bands)
+	{
+		// the border rows are saved before any band starts to overwrite its rows,
+		// with a single band these are the last and the first row of the board
+		#pragma omp for schedule(static, 1)
+		for(int b=0;b<bands;++b) {
+			const int first = (int)(((long long)mYDim*b)/bands);
+			const int end = (int)(((long long)mYDim*(b+1))/bands);
+			T* saved = rows+(size_t)4*b*mXDim;
+
+			memcpy(saved, mIndexArray[(first-1+mYDim)%mYDim], sizeof(T)*mXDim);
+			memcpy(saved+mXDim, mIndexArray[end%mYDim], sizeof(T)*mXDim);
+		} // implicit barrier
+
+		#pragma omp for schedule(static, 1) reduction(+:hash,population,births,deaths)
+		for(int b=0;b<bands;++b) {
+			const int first = (int)(((long long)mYDim*b)/bands);
+			const int end = (int)(((long long)mYDim*(b+1))/bands);
+			T* saved = rows+(size_t)4*b*mXDim;
+			const T* above = saved;
+			const T* below = saved+mXDim;
+			T* prev = saved+2*mXDim;
+			T* cur = saved+3*mXDim;
+			GenerationStats band;
+
+			// rows below y are still the old generation, rows above y are in prev/above
+			for(int y=first;y<end;++y) {
+				memcpy(cur, mIndexArray[y], sizeof(T)*mXDim);
+
+				const T* top = (y == first) ? above : prev;
+				const T* bot = (y == end-1) ? below : mIndexArray[y+1];
+				calcRowCells(top, cur, bot, mIndexArray[y], mXDim);
+
+				if(tracked)
+					countRow(y, cur, mIndexArray[y], band);
+
+				std::swap(prev, cur);
+			}
 
-				if(y==mYDim-1) {
-					yBot = (y+1)%mYDim;
-				}
+			hash += band.hash;
+			population += band.population;
+			births += band.births;
+			deaths += band.deaths;
+		}
+	} // parallel section end
 
-				// in case of accessing element on [-1][-1]
-				if(mIndexArray[yTop][xLeft] == 'x') {
-					neighbors++;
-				}
+	mStats.hash = hash;
+	mStats.population = population;
+	mStats.births = births;
+	mStats.deaths = deaths;
+}
 
-				// in case of accessing element on [-1][0]
-				if(mIndexArray[yTop][x] == 'x') {
-					neighbors++;
-				}
+template <class T>
+void Gameoflife<T>::calcGenerationMode(const Mode mode) {
+	if(mode == OPENMP)
+		calcGenerationOpenMP();
+	else if(mode == INPLACE)
+		calcGenerationInPlace();
+	else if(mode == WAVEFRONT)
+		calcGenerationsWavefront(1);
+	else if(mode == TILED)
+		calcGenerationsTiled(1);
+	else
+		calcGeneration();
+}
 
-				// in case of accessing element on [-1][x]
-				if(mIndexArray[yTop][xRight] == 'x') {
-					neighbors++;
-				}
+template <class T>
+void Gameoflife<T>::recordMetrics(const int generations, std::chrono::steady_clock::time_point& since, const bool population) {
+	Metrics& metrics = Metrics::instance();
+	const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	metrics.addGenerations(generations, std::chrono::duration<double>(now-since).count());
+	since = now;
+
+	if(population)
+		metrics.setPopulation(mStats.population);
+
+	// history records and checkpoints are the only files written while the board evolves
+	const uint64_t historyBytes = mHistory.getBytes();
+	if(historyBytes > mHistoryBytes) {
+		metrics.addBytesWritten(historyBytes-mHistoryBytes);
+		mHistoryBytes = historyBytes;
+	}
+	const uint64_t checkpointBytes = mCheckpoints.getBytes();
+	if(checkpointBytes > mCheckpointBytes) {
+		metrics.addBytesWritten(checkpointBytes-mCheckpointBytes);
+		mCheckpointBytes = checkpointBytes;
+	}
+}
 
-				// in case of accessing element on [0][-1]
-				if(mIndexArray[y][xLeft] == 'x') {
-					neighbors++;
-				}
+template <class T>
+void Gameoflife<T>::startCheckpoints(const Mode mode, const int generations) {
+	Checkpoint run;
+	run.xDim = mXDim;
+	run.yDim = mYDim;
+	run.generation = mGeneration;
+	run.generations = mGeneration+generations;
+	run.mode = mode;
+	run.threads = mThreadCount;
+	run.chunk = mChunk;
+	run.tileRows = mTileRows;
+	run.tileCols = mTileCols;
+	if(mRule.isSet())
+		run.rule = mRule.toString();
+	if(mStates.isSet())
+		run.states = mStates.toString();
+	run.bitsPerCell = (mMaxState > 1 || mStates.isSet()) ? 8 : 1;
+	mCheckpoints.setRun(run);
+}
 
-				// in case of accessing element on [0][x]
-				if(mIndexArray[y][xRight] == 'x') {
-					neighbors++;
-				}
+template <class T>
+int Gameoflife<T>::evolve(Mode mode, const int generations) {
+	// the wavefront and tiled engines only know about the eight direct neighbours
+	if(hasRule() && (mode == WAVEFRONT || mode == TILED))
+		mode = OPENMP;
+
+	// the bands of the wavefront and tiled engines are at different generations all the time,
+	// so there is no point in time where a whole generation could be hashed
+	// metrics only cost this branch per generation while they are disabled
+	const bool metrics = Metrics::instance().isEnabled();
+	std::chrono::steady_clock::time_point since = std::chrono::steady_clock::now();
+
+	if(mCheckpoints.isOpen())
+		startCheckpoints(mode, generations);
+
+	if(mode == WAVEFRONT || mode == TILED) {
+		mCyclePeriod = 0;
+		mCycleStart = 0;
+		// checkpoints need a whole generation, the run is split into batches between them
+		const int batch = mCheckpoints.isOpen() ? mCheckpoints.getBatch() : generations;
+		for(int done=0;done<generations;) {
+			const int n = std::min(batch, generations-done);
+			if(mode == WAVEFRONT)
+				calcGenerationsWavefront(n);
+			else
+				calcGenerationsTiled(n);
+			done += n;
+			mCheckpoints.offer(mGeneration+done, mData);
+		}
+		mGeneration += generations;
+		mFirstGeneration = std::chrono::steady_clock::now();
+		// the whole run is one batch, the board is not counted on the way
+		if(metrics)
+			recordMetrics(generations, since, false);
+		return generations;
+	}
 
-				// in case of accessing element on [y][-1]
-				if(mIndexArray[yBot][xLeft] == 'x') {
-					neighbors++;
-				}
+	CycleDetector detector;
+	mCyclePeriod = 0;
+	mCycleStart = 0;
+	// a matching hash is only a candidate until the board itself comes back, the
+	// detector keeps getting every hash meanwhile in case the candidate was a collision
+	std::vector<T> cycleBoard;
+	int confirmAt = 0;
+	int candidateStart = 0;
+	int candidatePeriod = 0;
+
+	for(int g=1;g<=generations;++g) {
+		calcGenerationMode(mode);
+
+		if(g == 1)
+			mFirstGeneration = std::chrono::steady_clock::now();
+
+		if(metrics)
+			recordMetrics(1, since, true);
+
+		mStatsWriter.write(g, mStats);
+		mCheckpoints.offer(mGeneration+g, mData);
+
+		if(!mCycleDetection)
+			continue;
+
+		const bool match = detector.add(g, mStats.hash);
+		// two boards with the same hash are not necessarily the same board
+		const bool confirmed = (g == confirmAt) && memcmp(mData, &cycleBoard[0], sizeof(T)*cycleBoard.size()) == 0;
+		if(g == confirmAt)
+			confirmAt = 0;
+
+		if(match && !confirmed && confirmAt == 0) {
+			cycleBoard.assign(mData, mData+(size_t)mXDim*mYDim);
+			candidateStart = detector.getStart();
+			candidatePeriod = detector.getPeriod();
+			confirmAt = g+candidatePeriod;
+		}
 
-				// in case of accessing element on [y][0]
-				if(mIndexArray[yBot][x] == 'x') {
-					neighbors++;
-				}
+		if(confirmed) {
+			mCyclePeriod = candidatePeriod;
+			mCycleStart = candidateStart;
+			mHistory.setCycle(mCycleStart, mCyclePeriod);
 
-				// in case of accessing element on [y][x]
-				if(mIndexArray[yBot][xRight] == 'x') {
-					neighbors++;
-				}
-				if(mIndexArray[y][x] == 'x') {
-					if(neighbors > 3 || neighbors < 2) {
-						mDataTmp[x+(y*mXDim)]= '.';
-					}
-				}
-				else {
-					if(neighbors == 3) {
-						mDataTmp[x+(y*mXDim)]= 'x';
-					}
-				}
+			// the board repeats every mCyclePeriod generations from here on,
+			// so only the offset into the cycle is left to calculate
+			const int remaining = (generations-g) % mCyclePeriod;
+			for(int i=0;i<remaining;++i) {
+				calcGenerationMode(mode);
+
+				if(metrics)
+					recordMetrics(1, since, true);
+
+				mStatsWriter.write(g+i+1, mStats);
 			}
+			// the board is in the phase of the last generation
+			mGeneration += generations;
+			return g+remaining;
 		}
+	}
 
-		
-	} // parallel section end 
-	memcpy(mData,mDataTmp,mXDim*mYDim+1);
+	mGeneration += generations;
+	return generations;
+}
+
+template <class T>
+bool Gameoflife<T>::evolveWindow(const Mode mode, const int x, const int y, const int width, const int height, const int generations) {
+	if(width < 1 || height < 1 || generations < 0)
+		return false;
+
+	std::chrono::steady_clock::time_point since = std::chrono::steady_clock::now();
+	const int nthreads = mThreadCount < 1 ? 1 : mThreadCount;
+
+	std::vector<T> window;
+	if(!hasRule() && LightCone<T>::cost(width, height, generations) < (uint64_t)generations*mXDim*mYDim) {
+		mLightCone.evolve(mData, mXDim, mYDim, x, y, width, height, generations, nthreads, window);
+		mFirstGeneration = std::chrono::steady_clock::now();
+		if(Metrics::instance().isEnabled())
+			recordMetrics(generations, since, false);
+	}
+	else {
+		evolve(mode, generations);
+		window.resize((size_t)width*height);
+		LightCone<T>::extract(mData, mXDim, mYDim, x, y, width, height, &window[0]);
+	}
+
+	// the window becomes the board, the back buffer has the old size
+	const int maxState = mMaxState;
+	releaseBoard();
+	if(!allocBoard(width, height))
+		return false;
+
+	memcpy(mData, &window[0], sizeof(T)*window.size());
+	mMaxState = maxState;
+	initHashKeys();
+
+	return true;
+}
+
+template <class T>
+bool Gameoflife<T>::releaseBoard() {
+	GridAllocator::instance().release(mData);
+	GridAllocator::instance().release(mDataTmp);
+	GridAllocator::instance().release(mIndexArray);
+	mData = 0;
+	mDataTmp = 0;
+	mIndexArray = 0;
+	return false;
+}
+
+template <class T>
+bool Gameoflife<T>::allocBoard(const int xDim, const int yDim) {
+	if(!isBoardSize(xDim, yDim)) {
+		MessageBoxA(0,"Board is too big","ERROR", MB_OK);
+		return false;
+	}
+
+	mXDim = xDim;
+	mYDim = yDim;
+	// the pattern formats only have two states
+	mMaxState = 0;
+	boardChanged();
+
+	mData = GridAllocator::instance().allocateCells<T>((size_t)mXDim*mYDim+1);
+	mIndexArray = GridAllocator::instance().allocateCells<T*>(mYDim);
+	if(!mData || !mIndexArray) {
+		MessageBoxA(0,"Not enough memory for the board","ERROR", MB_OK);
+		// the half that could be allocated goes back as well
+		return releaseBoard();
+	}
+
+	std::fill(mData, mData+mXDim*mYDim+1, CellTraits<T>::fromChar('.'));
+	for(int row=0;row<mYDim;++row) {
+		mIndexArray[row] = mData+row*mXDim;
+	}
+
+	return true;
+}
+
+template <class T>
+bool Gameoflife<T>::loadPattern(const char* fileName, const PatternFormat format) {
+	PatternSink sink = {this};
+
+	bool ok = false;
+	if(format == FORMAT_RLE)
+		ok = readRLE(fileName, sink);
+	else if(format == FORMAT_LIFE106)
+		ok = readLife106(fileName, sink);
+	else
+		ok = readBinary(fileName, sink);
+
+	if(!ok) {
+		MessageBoxA(0,"Could not load pattern file","ERROR", MB_OK);
+		return false;
+	}
+
+	initHashKeys();
+
+	return true;
+}
+
+template <class T>
+bool Gameoflife<T>::savePattern(const char* fileName, const PatternFormat format) {
+	bool ok = false;
+	if(format == FORMAT_RLE)
+		ok = writeRLE(fileName, mIndexArray, mXDim, mYDim);
+	else if(format == FORMAT_LIFE106)
+		ok = writeLife106(fileName, mIndexArray, mXDim, mYDim);
+	else
+		ok = writeBinary(fileName, mIndexArray, mXDim, mYDim);
+
+	if(!ok) {
+		MessageBoxA(0,"Could not save pattern file","ERROR", MB_OK);
+		return false;
+	}
+
+	return true;
+}
+
+template <class T>
+bool Gameoflife<T>::loadHistory(const char* fileName, const int generation) {
+	HistoryReader<T> reader;
+	if(!reader.open(fileName)) {
+		MessageBoxA(0,"Could not load history file","ERROR", MB_OK);
+		return false;
+	}
+
+	if(!mData) {
+		if(!allocBoard(reader.getXDim(), reader.getYDim()))
+			return false;
+		initHashKeys();
+	}
+	else if(mXDim != reader.getXDim() || mYDim != reader.getYDim()) {
+		MessageBoxA(0,"History file has a different board size","ERROR", MB_OK);
+		return false;
+	}
+
+	if(!reader.seek(generation, mData)) {
+		MessageBoxA(0,"Generation is not in the history file","ERROR", MB_OK);
+		return false;
+	}
+	boardChanged();
+
+	if(mDataTmp)
+		memcpy(mDataTmp,mData,sizeof(T)*(mXDim*mYDim+1));
+	return true;
+}
+
+template <class T>
+bool Gameoflife<T>::loadCheckpoint(const char* fileName, Checkpoint& checkpoint) {
+	if(!Checkpoint::loadLatest(fileName, checkpoint)) {
+		MessageBoxA(0,"No complete checkpoint to resume from","ERROR", MB_OK);
+		return false;
+	}
+
+	// the board of the checkpoint replaces whatever was loaded before
+	GridAllocator::instance().release(mData);
+	GridAllocator::instance().release(mDataTmp);
+	GridAllocator::instance().release(mIndexArray);
+	mDataTmp = 0;
+	if(!allocBoard(checkpoint.xDim, checkpoint.yDim))
+		return false;
+
+	if(checkpoint.bitsPerCell == 1) {
+		const size_t rowBytes = (size_t)(mXDim+7)/8;
+		for(int y=0;y<mYDim;++y) {
+			bitsToCells(&checkpoint.cells[rowBytes*y], mXDim, mIndexArray[y]);
+		}
+	}
+	else {
+		for(size_t i=0;i<checkpoint.cells.size();++i) {
+			mData[i] = CellTraits<T>::fromState(checkpoint.cells[i]);
+			if(checkpoint.cells[i] > mMaxState)
+				mMaxState = checkpoint.cells[i];
+		}
+	}
+	initHashKeys();
+
+	mRule = LtlRule();
+	mStates = StatesRule();
+	if((!checkpoint.rule.empty() && !setRule(checkpoint.rule.c_str())) ||
+	   (!checkpoint.states.empty() && !setStates(checkpoint.states.c_str()))) {
+		MessageBoxA(0,"Checkpoint has an invalid rule","ERROR", MB_OK);
+		return false;
+	}
+
+	mThreadCount = checkpoint.threads;
+	mChunk = checkpoint.chunk;
+	if(checkpoint.tileRows > 0 && checkpoint.tileCols > 0)
+		setTileSize(checkpoint.tileRows, checkpoint.tileCols);
+	mGeneration = checkpoint.generation;
+	return true;
 }
 
 template <class T>
 bool Gameoflife<T>::saveFile(const char* fileName) {
+	const PatternFormat format = patternFormat(fileName);
+	if(format != FORMAT_GOL) {
+		// the pattern formats only know living and dead cells
+		if(mMaxState > 1 || mStates.isSet()) {
+			MessageBoxA(0,"Multi-state boards can only be saved as .gol","ERROR", MB_OK);
+			return false;
+		}
+		if(!savePattern(fileName, format))
+			return false;
+		if(Metrics::instance().isEnabled())
+			Metrics::instance().addBytesWritten(Metrics::fileBytes(fileName));
+		return true;
+	}
+
 	mOutputFile.open(fileName, std::ios::out);
 
 	int l=0;
@@ -453,19 +1424,33 @@ bool Gameoflife<T>::saveFile(const char* fileName) {
 	mOutputFile.write(buffer,l+2);
 	delete[] buffer;
 
+	// one write per row instead of one put per cell
+	std::vector<char> text(mXDim+1, '\n');
 	for(int y=0;y<mYDim;++y) {
-		for(int x=0;x<mXDim;++x){
-			mOutputFile.put(mIndexArray[y][x]);
-		}
-
-		mOutputFile.put('\n');
+		rowToText(y, &text[0]);
+		mOutputFile.write(&text[0], mXDim+1);
 	}
 
 	mOutputFile.close();
 
+	if(Metrics::instance().isEnabled())
+		Metrics::instance().addBytesWritten(Metrics::fileBytes(fileName));
 	return true;
 }
 
+template <class T>
+bool Gameoflife<T>::saveStream(std::ostream& out) const {
+	out << mXDim << "," << mYDim << "\n";
+
+	std::vector<char> row(mXDim+1, '\n');
+	for(int y=0;y<mYDim;++y) {
+		rowToText(y, &row[0]);
+		out.write(&row[0], mXDim+1);
+	}
+
+	return out.good();
+}
+
 template <class T>
 bool Gameoflife<T>::cmpFiles(const char* fileName1, const char* fileName2) const {
 
@@ -480,11 +1465,31 @@ bool Gameoflife<T>::cmpFiles(const char* fileName1, const char* fileName2) const
 		return false;
 	}
 
+	// the headers have to be the same, the rows are compared as packed bits which
+	// also catches characters that are neither 'x' nor '.'
+	if(!std::getline(a,s1) || !std::getline(b,s2) || s1 != s2) {
+		MessageBoxA(NULL, "Error comparing files","ERROR", MB_OK);
+		return false;
+	}
+
+	std::vector<unsigned char> bits1;
+	std::vector<unsigned char> bits2;
 	int row = 0;
 
 	while(std::getline(a,s1)) {
 		std::getline(b,s2);
-		if(s1!=s2) {
+		// windows line breaks
+		if(!s1.empty() && s1[s1.length()-1] == '\r')
+			s1.erase(s1.length()-1);
+		if(!s2.empty() && s2[s2.length()-1] == '\r')
+			s2.erase(s2.length()-1);
+
+		bits1.resize((s1.length()+7)/8+1);
+		bits2.resize((s2.length()+7)/8+1);
+		if(s1.length() != s2.length() ||
+		   !textToBits(s1.c_str(), (int)s1.length(), &bits1[0]) ||
+		   !textToBits(s2.c_str(), (int)s2.length(), &bits2[0]) ||
+		   memcmp(&bits1[0], &bits2[0], (s1.length()+7)/8) != 0) {
 			MessageBoxA(NULL, "Error comparing files","ERROR", MB_OK);
 			return false;
 		}
@@ -496,12 +1501,11 @@ bool Gameoflife<T>::cmpFiles(const char* fileName1, const char* fileName2) const
 
 template <class T>
 std::ostream& operator<<(std::ostream& os, const Gameoflife<T>& gol) {
+	// one line per row like the .gol files, without the header
+	std::vector<char> row(gol.mXDim+1, '\n');
 	for(int y=0;y<gol.mYDim;++y) {
-		for(int x=0;x<gol.mXDim;++x){
-			os << gol.mIndexArray[y][x];	
-		}
-		//os << gol.mIndexArray[y] << std::endl;
-		//os << std::endl;
+		gol.rowToText(y, &row[0]);
+		os.write(&row[0], gol.mXDim+1);
 	}
 	return os;
 }
@@ -708,21 +1712,61 @@ template <class T>
 void Gameoflife<T>::openCL_initMem() {
 	cl_int status;
 
+	// a CPU device works on host memory anyway, so it gets the page aligned
+	// board buffers themselves instead of a copy (zero-copy)
+	const bool zeroCopy = mSelectedDeviceType == CPU;
+	if(zeroCopy)
+		allocBackBuffer();
+
 	// Create a buffer object (d_B) that contains the data from the host ptr B
-	mMemIn = clCreateBuffer(mContext, CL_MEM_READ_ONLY|CL_MEM_COPY_HOST_PTR,
-		mXDim*mYDim+1*sizeof(T), mData, &status);
+	// in and out buffers are swapped every generation so both are read and written
+	mMemIn = clCreateBuffer(mContext, CL_MEM_READ_WRITE|(zeroCopy ? CL_MEM_USE_HOST_PTR : CL_MEM_COPY_HOST_PTR),
+		sizeof(T)*(mXDim*mYDim+1), mData, &status);
    if(status != CL_SUCCESS || mMemIn == NULL) {
       printf("clCreateBuffer failed\n");
       exit(-1);
    }
 
    // Create a buffer object (d_C) with enough space to hold the output data
-   mMemOut = clCreateBuffer(mContext, CL_MEM_READ_WRITE, 
-                   mXDim*mYDim+1*sizeof(T), NULL, &status);
+   mMemOut = clCreateBuffer(mContext, CL_MEM_READ_WRITE|(zeroCopy ? CL_MEM_USE_HOST_PTR : 0), 
+                   sizeof(T)*(mXDim*mYDim+1), zeroCopy ? mDataTmp : NULL, &status);
    if(status != CL_SUCCESS || mMemOut == NULL) {
       printf("clCreateBuffer failed\n");
       exit(-1);
    }
+
+   // partial counters, see openCL_statsGroups
+   openCL_initStats();
+
+   // prefix sums over the board padded by radius+1 cells on every side
+   if(mRule.isSet()) {
+      const int h = mRule.radius+1;
+      const size_t padded = sizeof(cl_int)*(size_t)(mXDim+2*h)*(mYDim+2*h);
+
+      mMemLtlA = clCreateBuffer(mContext, CL_MEM_READ_WRITE, padded, NULL, &status);
+      if(status == CL_SUCCESS && mRule.vonNeumann)
+         mMemLtlB = clCreateBuffer(mContext, CL_MEM_READ_WRITE, padded, NULL, &status);
+      if(status != CL_SUCCESS || mMemLtlA == NULL || (mRule.vonNeumann && mMemLtlB == NULL)) {
+         printf("clCreateBuffer failed\n");
+         exit(-1);
+      }
+   }
+}
+
+template <class T>
+void Gameoflife<T>::openCL_initStats() {
+	cl_int status;
+
+	if(mMemStats)
+		clReleaseMemObject(mMemStats);
+
+	// one set of partial counters per work-group and generation
+	mMemStats = clCreateBuffer(mContext, CL_MEM_READ_WRITE,
+                   sizeof(GenerationStats)*openCL_statsGroups()*STATS_BATCH, NULL, &status);
+	if(status != CL_SUCCESS || mMemStats == NULL) {
+		printf("clCreateBuffer failed\n");
+		exit(-1);
+	}
 }
 
 template <class T>
@@ -746,7 +1790,8 @@ void Gameoflife<T>::openCL_initProgram() {
     // Build (compile & link) the program for the devices.
     // Save the return value in 'buildErr' (the following 
     // code will print any compilation errors to the screen)
-    buildErr = clBuildProgram(mProgram, 1, &mDevices[mSelectedDeviceIndex], NULL, NULL, NULL);
+    // the cell layout of T is passed as defines, see CellTraits<T>::clBuildOptions
+    buildErr = clBuildProgram(mProgram, 1, &mDevices[mSelectedDeviceIndex], CellTraits<T>::clBuildOptions(), NULL, NULL);
 
     // If there are build errors, print them to the screen
     if(buildErr != CL_SUCCESS) {
@@ -789,8 +1834,9 @@ template <class T>
 void Gameoflife<T>::openCL_initKernel() {
 	cl_int status;
 
-	// kernel function is calcGeneration
-    mKernel = clCreateKernel(mProgram, "calcGeneration", &status);
+	// kernel function is calcGeneration, statesGeneration for multi-state rules
+	// (same arguments plus the rule, see kernel.cl)
+    mKernel = clCreateKernel(mProgram, mStates.isSet() ? "statesGeneration" : "calcGeneration", &status);
     if(status != CL_SUCCESS) {
        printf("clCreateKernel failed\n");
 	   __debugbreak();
@@ -827,12 +1873,245 @@ void Gameoflife<T>::openCL_initKernel() {
 	   __debugbreak();
        exit(-1);
     }
+
+	// partial counters and the local memory for the work-group reduction
+	status |= clSetKernelArg(mKernel, 4, sizeof(cl_mem), &mMemStats);
+	status |= clSetKernelArg(mKernel, 5, sizeof(GenerationStats)*mLocalWorkSize[0]*mLocalWorkSize[1], NULL);
+	status |= clSetKernelArg(mKernel, 7, sizeof(int), &mCellsPerItem);
+
+	if(mStates.isSet()) {
+		cl_int states = mStates.states;
+		cl_int birth = (cl_int)mStates.birth;
+		cl_int survival = (cl_int)mStates.survival;
+		status |= clSetKernelArg(mKernel, 8, sizeof(cl_int), &states);
+		status |= clSetKernelArg(mKernel, 9, sizeof(cl_int), &birth);
+		status |= clSetKernelArg(mKernel, 10, sizeof(cl_int), &survival);
+	}
     
 	if(status != CL_SUCCESS) {
        printf("clSetKernelArg failed\n");
 	   __debugbreak();
        exit(-1);
     }
+
+	if(!mRule.isSet())
+		return;
+
+	// the arguments that do not change between generations, see openCL_enqueueLtl
+	mLtlPrefixKernel = clCreateKernel(mProgram, "ltlPrefix", &status);
+	if(status == CL_SUCCESS)
+		mLtlRuleKernel = clCreateKernel(mProgram, "ltlRule", &status);
+	if(status != CL_SUCCESS) {
+       printf("clCreateKernel failed\n");
+	   __debugbreak();
+       exit(-1);
+    }
+
+	cl_int radius = mRule.radius;
+	cl_int vonNeumann = mRule.vonNeumann ? 1 : 0;
+	cl_int includeCenter = mRule.includeCenter ? 1 : 0;
+	cl_int4 ranges;
+	ranges.s[0] = mRule.birthMin;
+	ranges.s[1] = mRule.birthMax;
+	ranges.s[2] = mRule.survivalMin;
+	ranges.s[3] = mRule.survivalMax;
+	// von Neumann rules only use the second buffer, Moore rules get A twice
+	cl_mem memB = mMemLtlB ? mMemLtlB : mMemLtlA;
+
+	status = clSetKernelArg(mLtlPrefixKernel, 0, sizeof(int), &mXDim);
+	status |= clSetKernelArg(mLtlPrefixKernel, 1, sizeof(int), &mYDim);
+	status |= clSetKernelArg(mLtlPrefixKernel, 2, sizeof(cl_int), &radius);
+	status |= clSetKernelArg(mLtlPrefixKernel, 3, sizeof(cl_int), &vonNeumann);
+	status |= clSetKernelArg(mLtlPrefixKernel, 5, sizeof(cl_mem), &mMemLtlA);
+	status |= clSetKernelArg(mLtlPrefixKernel, 6, sizeof(cl_mem), &memB);
+
+	status |= clSetKernelArg(mLtlRuleKernel, 0, sizeof(int), &mXDim);
+	status |= clSetKernelArg(mLtlRuleKernel, 1, sizeof(int), &mYDim);
+	status |= clSetKernelArg(mLtlRuleKernel, 2, sizeof(cl_int), &radius);
+	status |= clSetKernelArg(mLtlRuleKernel, 3, sizeof(cl_int), &vonNeumann);
+	status |= clSetKernelArg(mLtlRuleKernel, 4, sizeof(cl_int), &includeCenter);
+	status |= clSetKernelArg(mLtlRuleKernel, 5, sizeof(cl_int4), &ranges);
+	status |= clSetKernelArg(mLtlRuleKernel, 8, sizeof(cl_mem), &mMemLtlA);
+	status |= clSetKernelArg(mLtlRuleKernel, 9, sizeof(cl_mem), &memB);
+	status |= clSetKernelArg(mLtlRuleKernel, 10, sizeof(cl_mem), &mMemStats);
+
+	if(status != CL_SUCCESS) {
+       printf("clSetKernelArg failed\n");
+	   __debugbreak();
+       exit(-1);
+    }
+}
+
+template <class T>
+void Gameoflife<T>::openCL_shareEnvironment(const Gameoflife<T>& env) {
+	mSelectedDeviceType = env.mSelectedDeviceType;
+	mSelectedDeviceIndex = env.mSelectedDeviceIndex;
+	mNumPlatforms = env.mNumPlatforms;
+	mPlatforms = env.mPlatforms;
+	mNumDevices = env.mNumDevices;
+	mDevices = env.mDevices;
+	mContext = env.mContext;
+	mCmdQueue = env.mCmdQueue;
+	mProgram = env.mProgram;
+}
+
+template <class T>
+bool Gameoflife<T>::openCL_setWorkGroup(const int localX, const int localY, const int cellsPerItem) {
+	// the counters are summed up by a tree reduction over the work-group
+	if(localX < 1 || localY < 1 || (localX & (localX-1)) || (localY & (localY-1)))
+		return false;
+	if(mDevices) {
+		size_t maxWorkGroup = 0;
+		if(clGetDeviceInfo(mDevices[mSelectedDeviceIndex], CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(size_t), &maxWorkGroup, NULL) == CL_SUCCESS &&
+		   (size_t)localX*localY > maxWorkGroup)
+			return false;
+	}
+
+	mLocalWorkSize[0] = localX;
+	mLocalWorkSize[1] = localY;
+	mCellsPerItem = cellsPerItem < 1 ? 1 : cellsPerItem;
+
+	// the number of work-groups and the size of the reduction changed
+	if(mMemStats)
+		openCL_initStats();
+
+	if(mKernel) {
+		cl_int status;
+		status = clSetKernelArg(mKernel, 4, sizeof(cl_mem), &mMemStats);
+		status |= clSetKernelArg(mKernel, 5, sizeof(GenerationStats)*mLocalWorkSize[0]*mLocalWorkSize[1], NULL);
+		status |= clSetKernelArg(mKernel, 7, sizeof(int), &mCellsPerItem);
+		if(mLtlRuleKernel)
+			status |= clSetKernelArg(mLtlRuleKernel, 10, sizeof(cl_mem), &mMemStats);
+
+		if(status != CL_SUCCESS) {
+		   printf("clSetKernelArg failed\n");
+		   __debugbreak();
+		   exit(-1);
+		}
+	}
+	return true;
+}
+
+template <class T>
+std::string Gameoflife<T>::openCL_deviceName() const {
+	if(!mDevices)
+		return "";
+
+	char name[256];
+	if(clGetDeviceInfo(mDevices[mSelectedDeviceIndex], CL_DEVICE_NAME, sizeof(name), name, NULL) != CL_SUCCESS)
+		return "";
+	name[sizeof(name)-1] = '\0';
+	return name;
+}
+
+template <class T>
+bool Gameoflife<T>::applyProfile(const TuningProfile& profile) {
+	bool found = false;
+	TuningConfig config;
+
+	if(profile.find(TuningProfile::cpuIdentity(), mXDim, mYDim, config)) {
+		if(config.threads > 0) {
+			mThreadCount = config.threads;
+			mChunk = config.chunk;
+		}
+		if(config.tileRows > 0)
+			setTileSize(config.tileRows, config.tileCols);
+		found = true;
+	}
+
+	const std::string device = openCL_deviceName();
+	// an entry of a device with a smaller maximum work-group does not count
+	if(!device.empty() && profile.find(TuningProfile::deviceIdentity(device), mXDim, mYDim, config) && config.localX > 0 &&
+	   openCL_setWorkGroup(config.localX, config.localY, config.cellsPerItem))
+		found = true;
+
+	return found;
+}
+
+template <class T>
+bool Gameoflife<T>::openCL_initAsync(const char* fileName, const TuningProfile* profile) {
+	std::future<bool> loaded = std::async(std::launch::async, [this, fileName]() {
+		return loadFile(fileName);
+	});
+
+	// the OpenCL setup only touches the OpenCL members, loadFile only the board
+	openCL_initPlatforms();
+	openCL_initDevices();
+	openCL_initContext();
+	openCL_initCommandQueue();
+	openCL_initProgram();
+
+	// buffer sizes and kernel arguments depend on the board
+	if(!loaded.get())
+		return false;
+
+	if(profile)
+		applyProfile(*profile);
+
+	openCL_initMem();
+	openCL_initKernel();
+
+	return true;
+}
+
+template <class T>
+int Gameoflife<T>::openCL_globalWorkSize(size_t* globalWorkSize) const {
+	const size_t items = (mXDim+mCellsPerItem-1)/mCellsPerItem;
+	globalWorkSize[0] = ((items+mLocalWorkSize[0]-1)/mLocalWorkSize[0])*mLocalWorkSize[0];
+	globalWorkSize[1] = ((mYDim+mLocalWorkSize[1]-1)/mLocalWorkSize[1])*mLocalWorkSize[1];
+
+	return (int)((globalWorkSize[0]/mLocalWorkSize[0])*(globalWorkSize[1]/mLocalWorkSize[1]));
+}
+
+template <class T>
+int Gameoflife<T>::openCL_statsGroups() const {
+	// the Larger than Life kernel writes the counters of every row
+	if(mRule.isSet())
+		return mYDim;
+
+	size_t globalWorkSize[2];
+	return openCL_globalWorkSize(globalWorkSize);
+}
+
+template <class T>
+void Gameoflife<T>::openCL_readBoard(cl_mem mem, T* board) {
+	cl_int status = clEnqueueReadBuffer(mCmdQueue, mem, CL_TRUE, 0, sizeof(T)*mXDim*mYDim, board, 0, NULL, NULL);
+	if(status != CL_SUCCESS) {
+		printf("clEnqueueReadBuffer failed\n");
+		__debugbreak();
+		exit(-1);
+	}
+}
+
+template <class T>
+void Gameoflife<T>::openCL_enqueueLtl(cl_mem in, cl_mem out, int statsOffset) {
+	cl_int status;
+
+	status = clSetKernelArg(mLtlPrefixKernel, 4, sizeof(cl_mem), &in);
+	status |= clSetKernelArg(mLtlRuleKernel, 6, sizeof(cl_mem), &in);
+	status |= clSetKernelArg(mLtlRuleKernel, 7, sizeof(cl_mem), &out);
+	status |= clSetKernelArg(mLtlRuleKernel, 11, sizeof(int), &statsOffset);
+	if(status != CL_SUCCESS) {
+	   printf("clSetKernelArg failed\n");
+	   __debugbreak();
+	   exit(-1);
+	}
+
+	// one work-item per padded column (Moore) or per diagonal in both directions (von Neumann)
+	// and one per board row for the rule, the row slides along its cells
+	const int h = mRule.radius+1;
+	const size_t paddedX = mXDim+2*h;
+	const size_t paddedY = mYDim+2*h;
+	const size_t prefixWorkSize = mRule.vonNeumann ? 2*(paddedX+paddedY-1) : paddedX;
+	const size_t ruleWorkSize = mYDim;
+
+	status = clEnqueueNDRangeKernel(mCmdQueue, mLtlPrefixKernel, 1, NULL, &prefixWorkSize, NULL, 0, NULL, NULL);
+	status |= clEnqueueNDRangeKernel(mCmdQueue, mLtlRuleKernel, 1, NULL, &ruleWorkSize, NULL, 0, NULL, NULL);
+	if(status != CL_SUCCESS) {
+	   printf("clEnqueueNDRangeKernel failed\n");
+	   __debugbreak();
+	   exit(-1);
+	}
 }
 
 template <class T>
@@ -840,38 +2119,125 @@ void Gameoflife<T>::openCL_run(const int generations) {
 	cl_int status;
 
 	// Define an index space (global work size) of threads for execution.  
-    // A workgroup size (local work size) is not required, but can be used.
-	size_t globalWorkSize[2] = {mXDim, mYDim};
+	// The work-group size is fixed since the kernel reduces the counters per work-group
+	size_t globalWorkSize[2];
+	openCL_globalWorkSize(globalWorkSize);
+	const int groups = openCL_statsGroups();
+
+	cl_mem mem[2] = {mMemIn, mMemOut};
+	int in = 0;
+
+	std::vector<GenerationStats> partials(groups*STATS_BATCH);
+	CycleDetector detector;
+	mCyclePeriod = 0;
+	mCycleStart = 0;
+	int total = generations;
+	// a matching hash is only a candidate until the board itself comes back, see evolve
+	std::vector<T> cycleBoard;
+	int confirmAt = 0;
+	int candidateStart = 0;
+	int candidatePeriod = 0;
+
+	// the blocking read of the counters is the only point where generations are known
+	// to be done, so metrics are recorded per batch of STATS_BATCH generations
+	const bool metrics = Metrics::instance().isEnabled();
+	std::chrono::steady_clock::time_point since = std::chrono::steady_clock::now();
 
 	// loop throught generations
-	for(int i = 0; i < generations; ++i) {
+	for(int g = 1; g <= total; ++g) {
+		int statsOffset = ((g-1)%STATS_BATCH)*groups;
 
-		// execute the kernel
-		status = clEnqueueNDRangeKernel(mCmdQueue, mKernel, 2, NULL, globalWorkSize, 
-							   NULL, 0, NULL, NULL);
-		if(status != CL_SUCCESS) {
-		   printf("clEnqueueNDRangeKernel failed\n");
-		   __debugbreak();
-		   exit(-1);
+		if(mRule.isSet()) {
+			openCL_enqueueLtl(mem[in], mem[1-in], statsOffset);
 		}
-		
-		status = clEnqueueCopyBuffer(mCmdQueue, mMemOut, mMemIn, 0,0, sizeof(T)*mXDim*mYDim+1, 0, NULL, NULL); 	
+		else {
+			status = clSetKernelArg(mKernel, 2, sizeof(cl_mem), &mem[in]);
+			status |= clSetKernelArg(mKernel, 3, sizeof(cl_mem), &mem[1-in]);
+			status |= clSetKernelArg(mKernel, 6, sizeof(int), &statsOffset);
+			if(status != CL_SUCCESS) {
+			   printf("clSetKernelArg failed\n");
+			   __debugbreak();
+			   exit(-1);
+			}
 
-		if(status != CL_SUCCESS) {
-		   printf("clEnqueueCopyBuffer failed\n");
-		   __debugbreak();
-		   exit(-1);
+			// execute the kernel
+			status = clEnqueueNDRangeKernel(mCmdQueue, mKernel, 2, NULL, globalWorkSize, 
+								   mLocalWorkSize, 0, NULL, NULL);
+			if(status != CL_SUCCESS) {
+			   printf("clEnqueueNDRangeKernel failed\n");
+			   __debugbreak();
+			   exit(-1);
+			}
+		}
+
+		// output becomes the input of the next generation
+		in = 1-in;
+
+		// waiting for the first generation once costs nothing compared to the setup
+		if(g == 1) {
+			clFinish(mCmdQueue);
+			mFirstGeneration = std::chrono::steady_clock::now();
+		}
+
+		if(g == confirmAt) {
+			confirmAt = 0;
+			std::vector<T> board(cycleBoard.size());
+			openCL_readBoard(mem[in], &board[0]);
+			if(board == cycleBoard) {
+				mCyclePeriod = candidatePeriod;
+				mCycleStart = candidateStart;
+				// only the offset into the cycle is left to calculate
+				total = g + (generations-g) % mCyclePeriod;
+			}
+		}
+
+		// counters are read back every STATS_BATCH generations, a cycle is therefore
+		// found a few generations late which does not matter since the board is
+		// periodic from the start of the cycle on
+		const bool detecting = mCycleDetection && mCyclePeriod == 0;
+		if((detecting || mStatsWriter.isOpen() || metrics) && (g%STATS_BATCH == 0 || g == total)) {
+			const int count = (g-1)%STATS_BATCH+1;
+			status = clEnqueueReadBuffer(mCmdQueue, mMemStats, CL_TRUE, 0, sizeof(GenerationStats)*groups*count, &partials[0], 0, NULL, NULL);
+			if(status != CL_SUCCESS) {
+				printf("clEnqueueReadBuffer failed\n");
+				__debugbreak();
+				exit(-1);
+			}
+
+			for(int k=0;k<count;++k) {
+				GenerationStats stats;
+				for(int i=0;i<groups;++i) {
+					stats += partials[k*groups+i];
+				}
+				mStats = stats;
+				mStatsWriter.write(g-count+1+k, stats);
+
+				// the board after g has to show up again period generations later, the
+				// detector gets every hash while a candidate waits for that
+				if(mCycleDetection && mCyclePeriod == 0 && detector.add(g-count+1+k, stats.hash) && confirmAt == 0) {
+					cycleBoard.resize((size_t)mXDim*mYDim);
+					openCL_readBoard(mem[in], &cycleBoard[0]);
+					candidateStart = detector.getStart();
+					candidatePeriod = detector.getPeriod();
+					confirmAt = g+candidatePeriod;
+				}
+			}
+
+			if(metrics)
+				recordMetrics(count, since, true);
 		}
 	}
 
 	// read the buffer and copy its content to host memory (mData)
-	status = clEnqueueReadBuffer(mCmdQueue, mMemOut, CL_TRUE, 0, sizeof(T)*mXDim*mYDim+1, mData, 0, NULL, NULL);
+	// with zero-copy buffers this only synchronizes if the result is already in mData
+	status = clEnqueueReadBuffer(mCmdQueue, mem[in], CL_TRUE, 0, sizeof(T)*(mXDim*mYDim+1), mData, 0, NULL, NULL);
 
 	if(status != CL_SUCCESS) {
 		printf("clEnqueueReadBuffer failed\n");
 		__debugbreak();
 		exit(-1);
 	}
+	boardChanged();
 
 }
 
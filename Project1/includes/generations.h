@@ -0,0 +1,155 @@
+#ifndef __GENERATIONS_H
+#define __GENERATIONS_H
+
+#include <cstddef>
+#include <iterator>
+#include <chrono>
+
+#include "gameoflife.h"
+
+// read-only view of a board that does not own the cells, usually the front buffer
+// of a Gameoflife (see Gameoflife::view), so it is only valid as long as the board
+// is not calculated any further
+template <class T>
+class BoardView {
+public:
+	BoardView() : mData(0), mXDim(0), mYDim(0), mGeneration(0), mStats(0) {}
+	BoardView(const T* data, const int xDim, const int yDim, const int generation, const GenerationStats* stats)
+		: mData(data), mXDim(xDim), mYDim(yDim), mGeneration(generation), mStats(stats) {}
+
+	inline const T* data() const { return mData; }
+	inline size_t size() const { return (size_t)mXDim*mYDim; }
+	inline int getXDim() const { return mXDim; }
+	inline int getYDim() const { return mYDim; }
+
+	inline const T* row(const int y) const { return mData+(size_t)y*mXDim; }
+	inline const T& operator()(const int x, const int y) const { return mData[(size_t)y*mXDim+x]; }
+	inline bool alive(const int x, const int y) const { return CellTraits<T>::alive((*this)(x, y)) != 0; }
+
+	// generations calculated since the range started, 0 for Gameoflife::view
+	inline int getGeneration() const { return mGeneration; }
+	// counters of the generation, only counted while the board is tracked (see Gameoflife::getStats)
+	inline const GenerationStats& getStats() const { return *mStats; }
+
+private:
+	const T* mData;
+	int mXDim;
+	int mYDim;
+	int mGeneration;
+	const GenerationStats* mStats;
+};
+
+// generations of a board that are calculated only when the consumer asks for them
+//
+//   for(const BoardView<uint8_t>& board : gof.generations(OPENMP, 1000)) {
+//       ... board.alive(x, y), board.row(y), board.getStats() ...
+//   }
+//
+// begin calculates the first generation, every increment of the iterator the next
+// one, all of them straight in the board. the views point to the front buffer of the
+// board, so handing them out copies nothing. a view shows the board as it is, so it
+// has to be copied if it is needed after the iterator moved on.
+//
+// every step costs what a single generation of the engine costs: the sequential,
+// OpenMP and Larger than Life engines copy the back buffer into the front buffer
+// every generation and the wavefront and tiled engines set up their scheduler for
+// every generation, since they calculate one generation per step here. only the
+// in-place engine with the standard rule and no history works without a second
+// board. OPENCL uses the OpenMP engine since the board would have to be read back
+// every generation anyway. there is no cycle detection, the consumer sees every
+// generation and can stop whenever it wants to.
+template <class T>
+class GenerationRange {
+public:
+	class iterator {
+	public:
+		typedef std::input_iterator_tag iterator_category;
+		typedef BoardView<T> value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const BoardView<T>* pointer;
+		typedef const BoardView<T>& reference;
+
+		// end of every range
+		iterator() : mRange(0) {}
+		explicit iterator(GenerationRange<T>* range) : mRange(range) {}
+
+		inline reference operator*() const { return mRange->mView; }
+		inline pointer operator->() const { return &mRange->mView; }
+
+		inline iterator& operator++() {
+			if(mRange->mGeneration < mRange->mCount)
+				mRange->advance();
+			else
+				mRange = 0;
+			return *this;
+		}
+		inline void operator++(int) { ++*this; }
+
+		inline bool operator==(const iterator& other) const { return mRange == other.mRange; }
+		inline bool operator!=(const iterator& other) const { return mRange != other.mRange; }
+
+	private:
+		GenerationRange<T>* mRange;
+	};
+
+	GenerationRange(Gameoflife<T>& gof, const Mode mode, const int count);
+
+	// calculates the first generation, if that was not done before
+	iterator begin();
+	inline iterator end() { return iterator(); }
+
+private:
+	void advance();
+
+	Gameoflife<T>* mGof;
+	Mode mMode;
+	int mCount;
+	int mGeneration;
+	BoardView<T> mView;
+	std::chrono::steady_clock::time_point mSince;
+};
+
+template <class T>
+GenerationRange<T>::GenerationRange(Gameoflife<T>& gof, const Mode mode, const int count)
+	: mGof(&gof), mMode(mode), mCount(count), mGeneration(0) {
+	// the same engines evolve would take
+	if(mMode == OPENCL || (gof.hasRule() && (mMode == WAVEFRONT || mMode == TILED)))
+		mMode = OPENMP;
+}
+
+template <class T>
+typename GenerationRange<T>::iterator GenerationRange<T>::begin() {
+	if(mCount < 1)
+		return end();
+
+	if(mGeneration == 0) {
+		mSince = std::chrono::steady_clock::now();
+		advance();
+	}
+	return iterator(this);
+}
+
+template <class T>
+void GenerationRange<T>::advance() {
+	mGof->calcGenerationMode(mMode);
+	++mGeneration;
+
+	if(mGeneration == 1)
+		mGof->mFirstGeneration = std::chrono::steady_clock::now();
+	if(Metrics::instance().isEnabled())
+		mGof->recordMetrics(1, mSince, mMode != WAVEFRONT && mMode != TILED);
+
+	mView = BoardView<T>(mGof->mData, mGof->mXDim, mGof->mYDim, mGeneration, &mGof->mStats);
+}
+
+template <class T>
+BoardView<T> Gameoflife<T>::view() const {
+	return BoardView<T>(mData, mXDim, mYDim, 0, &mStats);
+}
+
+template <class T>
+GenerationRange<T> Gameoflife<T>::generations(const Mode mode, const int count) {
+	return GenerationRange<T>(*this, mode, count);
+}
+
+#endif
@@ -0,0 +1,439 @@
+#ifndef __HISTORY_H
+#define __HISTORY_H
+
+#include <stdint.h>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "celltraits.h"
+
+// generation history file (.golh), written while a board evolves
+//
+//   header    "GOLH", width, height, keyframe interval
+//   records   type (0 keyframe, 1 delta), generation, payload bytes, payload
+//             keyframe: the whole board, one bit per cell like the .golb rows
+//             delta:    indices of the cells that were born or died, as varint
+//                       encoded gaps to the previous index
+//   footer    generation and file offset of every keyframe, last recorded
+//             generation, cycle start and period, footer offset, "GOLH"
+//
+// all numbers are little endian. deltas come straight from the two board buffers
+// before they are swapped, unchanged blocks are skipped with memcmp, so a delta costs
+// a few bytes per changed cell and nothing for still regions in the file. the engines
+// do not report which rows changed though, so every recorded generation still reads
+// both boards once completely, which is about as much memory traffic as the
+// generation itself for the sequential engine. only the living/dead state is
+// recorded, ages of CellTraits<uint16_t> cells restart at 1 on replay.
+
+namespace history {
+
+inline void put32(std::vector<unsigned char>& out, const uint32_t v) {
+	for(int i=0;i<4;++i) {
+		out.push_back((unsigned char)(v >> (8*i)));
+	}
+}
+
+inline void put64(std::vector<unsigned char>& out, const uint64_t v) {
+	for(int i=0;i<8;++i) {
+		out.push_back((unsigned char)(v >> (8*i)));
+	}
+}
+
+inline void putVarint(std::vector<unsigned char>& out, uint64_t v) {
+	while(v >= 0x80) {
+		out.push_back((unsigned char)(v | 0x80));
+		v >>= 7;
+	}
+	out.push_back((unsigned char)v);
+}
+
+inline uint32_t get32(const unsigned char* in) {
+	uint32_t v = 0;
+	for(int i=0;i<4;++i) {
+		v |= (uint32_t)in[i] << (8*i);
+	}
+	return v;
+}
+
+inline uint64_t get64(const unsigned char* in) {
+	uint64_t v = 0;
+	for(int i=0;i<8;++i) {
+		v |= (uint64_t)in[i] << (8*i);
+	}
+	return v;
+}
+
+// fseek with 64 bit offsets, keyframes of big boards quickly pass 2 GB
+inline bool seekTo(FILE* file, const uint64_t offset) {
+#ifdef _WIN32
+	return _fseeki64(file, (__int64)offset, SEEK_SET) == 0;
+#else
+	return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+enum RecordType {
+	KEYFRAME = 0,
+	DELTA = 1
+};
+
+// type, generation and payload bytes in front of every record
+static const size_t RECORD_HEADER = 1+4+8;
+// cells compared with memcmp at once when looking for changes
+static const int BLOCK_CELLS = 64;
+
+}
+
+// records the generations of a board, see above
+template <class T>
+class HistoryRecorder {
+public:
+	HistoryRecorder() : mFile(0), mXDim(0), mYDim(0), mKeyframeInterval(0), mGeneration(0),
+						mCycleStart(0), mCyclePeriod(0), mBytes(0) {}
+	~HistoryRecorder() { close(); }
+
+	// starts a history with board as generation 0
+	bool open(const char* fileName, const int xDim, const int yDim, const int keyframeInterval, const T* board);
+	// writes the footer, the file can be read from then on
+	void close();
+
+	inline bool isOpen() const { return mFile != 0; }
+
+	// adds the next generation, prev and next are the board before and after it
+	void record(const T* prev, const T* next);
+	// the board repeats with period from generation start on, lets readers seek past the end
+	inline void setCycle(const int start, const int period) { mCycleStart = start; mCyclePeriod = period; }
+
+	// bytes written so far
+	inline uint64_t getBytes() const { return mBytes; }
+
+private:
+	void writeKeyframe(const T* board);
+	void writeRecord(const history::RecordType type, const std::vector<unsigned char>& payload);
+
+	FILE* mFile;
+	int mXDim;
+	int mYDim;
+	int mKeyframeInterval;
+	int mGeneration;
+	int mCycleStart;
+	int mCyclePeriod;
+	uint64_t mBytes;
+
+	// generation and offset of every keyframe
+	std::vector<std::pair<uint32_t, uint64_t> > mKeyframes;
+	// payload of the current record, reused
+	std::vector<unsigned char> mPayload;
+};
+
+template <class T>
+bool HistoryRecorder<T>::open(const char* fileName, const int xDim, const int yDim, const int keyframeInterval, const T* board) {
+	close();
+
+	mFile = fopen(fileName, "wb");
+	if(!mFile)
+		return false;
+	setvbuf(mFile, 0, _IOFBF, 64*1024);
+
+	mXDim = xDim;
+	mYDim = yDim;
+	mKeyframeInterval = keyframeInterval < 1 ? 1 : keyframeInterval;
+	mGeneration = 0;
+	mCycleStart = 0;
+	mCyclePeriod = 0;
+	mKeyframes.clear();
+
+	std::vector<unsigned char> header;
+	header.push_back('G');
+	header.push_back('O');
+	header.push_back('L');
+	header.push_back('H');
+	history::put32(header, (uint32_t)mXDim);
+	history::put32(header, (uint32_t)mYDim);
+	history::put32(header, (uint32_t)mKeyframeInterval);
+	fwrite(&header[0], 1, header.size(), mFile);
+	mBytes = header.size();
+
+	writeKeyframe(board);
+	return true;
+}
+
+template <class T>
+void HistoryRecorder<T>::close() {
+	if(!mFile)
+		return;
+
+	const uint64_t footerOffset = mBytes;
+
+	std::vector<unsigned char> footer;
+	history::put32(footer, (uint32_t)mKeyframes.size());
+	for(size_t i=0;i<mKeyframes.size();++i) {
+		history::put32(footer, mKeyframes[i].first);
+		history::put64(footer, mKeyframes[i].second);
+	}
+	history::put32(footer, (uint32_t)mGeneration);
+	history::put32(footer, (uint32_t)mCycleStart);
+	history::put32(footer, (uint32_t)mCyclePeriod);
+	history::put64(footer, footerOffset);
+	footer.push_back('G');
+	footer.push_back('O');
+	footer.push_back('L');
+	footer.push_back('H');
+
+	fwrite(&footer[0], 1, footer.size(), mFile);
+	fclose(mFile);
+	mFile = 0;
+}
+
+template <class T>
+void HistoryRecorder<T>::record(const T* prev, const T* next) {
+	if(!mFile)
+		return;
+
+	++mGeneration;
+	if(mGeneration % mKeyframeInterval == 0) {
+		writeKeyframe(next);
+		return;
+	}
+
+	mPayload.clear();
+
+	const int size = mXDim*mYDim;
+	int64_t last = -1;
+	for(int block=0;block<size;block+=history::BLOCK_CELLS) {
+		const int end = (block+history::BLOCK_CELLS < size) ? block+history::BLOCK_CELLS : size;
+		if(memcmp(prev+block, next+block, sizeof(T)*(end-block)) == 0)
+			continue;
+
+		for(int i=block;i<end;++i) {
+			if(CellTraits<T>::alive(prev[i]) != CellTraits<T>::alive(next[i])) {
+				history::putVarint(mPayload, (uint64_t)(i-last-1));
+				last = i;
+			}
+		}
+	}
+
+	writeRecord(history::DELTA, mPayload);
+}
+
+template <class T>
+void HistoryRecorder<T>::writeKeyframe(const T* board) {
+	mKeyframes.push_back(std::make_pair((uint32_t)mGeneration, mBytes));
+
+	const size_t rowBytes = ((size_t)mXDim+7)/8;
+	mPayload.assign(rowBytes*mYDim, 0);
+	for(int y=0;y<mYDim;++y) {
+		unsigned char* bits = &mPayload[y*rowBytes];
+		const T* row = board+y*mXDim;
+		for(int x=0;x<mXDim;++x) {
+			bits[x>>3] |= (unsigned char)(CellTraits<T>::alive(row[x]) << (x&7));
+		}
+	}
+
+	writeRecord(history::KEYFRAME, mPayload);
+}
+
+template <class T>
+void HistoryRecorder<T>::writeRecord(const history::RecordType type, const std::vector<unsigned char>& payload) {
+	std::vector<unsigned char> header;
+	header.push_back((unsigned char)type);
+	history::put32(header, (uint32_t)mGeneration);
+	history::put64(header, payload.size());
+
+	fwrite(&header[0], 1, header.size(), mFile);
+	if(!payload.empty())
+		fwrite(&payload[0], 1, payload.size(), mFile);
+
+	mBytes += header.size() + payload.size();
+}
+
+// random access to the generations of a history file
+template <class T>
+class HistoryReader {
+public:
+	HistoryReader() : mFile(0), mXDim(0), mYDim(0), mGenerations(0), mCycleStart(0), mCyclePeriod(0) {}
+	~HistoryReader() { if(mFile) fclose(mFile); }
+
+	bool open(const char* fileName);
+
+	// reconstructs generation into board (xDim*yDim cells) from the nearest keyframe
+	// and the deltas after it, generations past the end are mapped into the cycle if
+	// the recorder knew one. returns false if the generation is not in the history or
+	// the file does not fit its header
+	bool seek(const int generation, T* board);
+
+	inline int getXDim() const { return mXDim; }
+	inline int getYDim() const { return mYDim; }
+	// last generation that was recorded
+	inline int getGenerations() const { return mGenerations; }
+
+private:
+	bool readFooter();
+	bool readRecord(unsigned char* type, uint32_t* generation, std::vector<unsigned char>& payload);
+
+	FILE* mFile;
+	int mXDim;
+	int mYDim;
+	int mGenerations;
+	int mCycleStart;
+	int mCyclePeriod;
+
+	std::vector<std::pair<uint32_t, uint64_t> > mKeyframes;
+	std::vector<unsigned char> mPayload;
+};
+
+template <class T>
+bool HistoryReader<T>::open(const char* fileName) {
+	if(mFile)
+		fclose(mFile);
+	mKeyframes.clear();
+	mGenerations = 0;
+	mCyclePeriod = 0;
+
+	mFile = fopen(fileName, "rb");
+	if(!mFile)
+		return false;
+
+	// a reader that failed to open can not be seeked
+	if(!readFooter()) {
+		fclose(mFile);
+		mFile = 0;
+		mKeyframes.clear();
+		return false;
+	}
+	return true;
+}
+
+template <class T>
+bool HistoryReader<T>::readFooter() {
+	unsigned char header[16];
+	if(fread(header, 1, sizeof(header), mFile) != sizeof(header) || memcmp(header, "GOLH", 4) != 0)
+		return false;
+
+	mXDim = (int)history::get32(header+4);
+	mYDim = (int)history::get32(header+8);
+
+	// footer offset and magic are at the very end
+	unsigned char tail[12];
+	if(fseek(mFile, -(long)sizeof(tail), SEEK_END) != 0 || fread(tail, 1, sizeof(tail), mFile) != sizeof(tail)
+	   || memcmp(tail+8, "GOLH", 4) != 0)
+		return false;
+
+	const uint64_t footerOffset = history::get64(tail);
+	if(!history::seekTo(mFile, footerOffset))
+		return false;
+
+	unsigned char count[4];
+	if(fread(count, 1, 4, mFile) != 4)
+		return false;
+
+	std::vector<unsigned char> footer(history::get32(count)*12 + 12);
+	if(fread(&footer[0], 1, footer.size(), mFile) != footer.size())
+		return false;
+
+	mKeyframes.resize(history::get32(count));
+	for(size_t i=0;i<mKeyframes.size();++i) {
+		mKeyframes[i].first = history::get32(&footer[i*12]);
+		mKeyframes[i].second = history::get64(&footer[i*12+4]);
+	}
+
+	const unsigned char* rest = &footer[mKeyframes.size()*12];
+	mGenerations = (int)history::get32(rest);
+	mCycleStart = (int)history::get32(rest+4);
+	mCyclePeriod = (int)history::get32(rest+8);
+
+	// the first keyframe is generation 0, the rest follow in order
+	if(mKeyframes.empty() || mKeyframes[0].first != 0 || mXDim < 1 || mYDim < 1 || mGenerations < 0)
+		return false;
+	for(size_t i=1;i<mKeyframes.size();++i) {
+		if(mKeyframes[i].first <= mKeyframes[i-1].first || (int)mKeyframes[i].first > mGenerations)
+			return false;
+	}
+	return true;
+}
+
+template <class T>
+bool HistoryReader<T>::readRecord(unsigned char* type, uint32_t* generation, std::vector<unsigned char>& payload) {
+	unsigned char header[history::RECORD_HEADER];
+	if(fread(header, 1, sizeof(header), mFile) != sizeof(header))
+		return false;
+
+	*type = header[0];
+	*generation = history::get32(header+1);
+	payload.resize((size_t)history::get64(header+5));
+
+	return payload.empty() || fread(&payload[0], 1, payload.size(), mFile) == payload.size();
+}
+
+template <class T>
+bool HistoryReader<T>::seek(const int generation, T* board) {
+	if(!mFile || generation < 0)
+		return false;
+
+	int target = generation;
+	if(target > mGenerations) {
+		if(mCyclePeriod < 1)
+			return false;
+		target = mCycleStart + (target-mCycleStart) % mCyclePeriod;
+	}
+	// a cycle has to lie inside of the recorded generations as well
+	if(target < 0 || target > mGenerations)
+		return false;
+
+	// last keyframe at or before the target
+	size_t key = 0;
+	while(key+1 < mKeyframes.size() && (int)mKeyframes[key+1].first <= target) {
+		++key;
+	}
+
+	if(!history::seekTo(mFile, mKeyframes[key].second))
+		return false;
+
+	unsigned char type;
+	uint32_t current;
+	const size_t rowBytes = ((size_t)mXDim+7)/8;
+	if(!readRecord(&type, &current, mPayload) || type != history::KEYFRAME || mPayload.size() != rowBytes*mYDim)
+		return false;
+
+	const T dead = CellTraits<T>::fromChar('.');
+	const T alive = CellTraits<T>::fromChar('x');
+	for(int y=0;y<mYDim;++y) {
+		const unsigned char* bits = &mPayload[y*rowBytes];
+		T* row = board+y*mXDim;
+		for(int x=0;x<mXDim;++x) {
+			row[x] = ((bits[x>>3] >> (x&7)) & 1) ? alive : dead;
+		}
+	}
+
+	// toggle the changed cells of every generation up to the target
+	const int64_t size = (int64_t)mXDim*mYDim;
+	while((int)current < target) {
+		if(!readRecord(&type, &current, mPayload) || type != history::DELTA)
+			return false;
+
+		int64_t index = -1;
+		size_t pos = 0;
+		while(pos < mPayload.size()) {
+			uint64_t gap = 0;
+			int shift = 0;
+			while(pos < mPayload.size()) {
+				const unsigned char b = mPayload[pos++];
+				gap |= (uint64_t)(b & 0x7F) << shift;
+				shift += 7;
+				if(!(b & 0x80))
+					break;
+			}
+
+			// a corrupt gap must not point past the board
+			if(gap >= (uint64_t)(size-index-1))
+				return false;
+			index += (int64_t)gap+1;
+			board[index] = CellTraits<T>::alive(board[index]) ? dead : alive;
+		}
+	}
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,362 @@
+#ifndef __LARGERTHANLIFE_H
+#define __LARGERTHANLIFE_H
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <stdint.h>
+#include <omp.h>
+
+#include "celltraits.h"
+#include "statistics.h"
+#include "cycledetector.h"
+
+// largest radius a rule may have
+static const int LTL_MAX_RADIUS = 500;
+
+// Larger than Life rule, radius r neighbourhoods with ranges for birth and survival
+// written like Golly does, e.g. Bosco's rule "R5,C0,M1,S34..58,B34..45,NM"
+//
+//   Rr      radius 1..LTL_MAX_RADIUS
+//   Cc      number of states, only two state rules (C0 or C2) are supported
+//   M0/M1   the cell itself is counted as one of its neighbours (M1) or not (M0)
+//   Sa..b   a living cell survives with a to b living cells in its neighbourhood
+//   Ba..b   a dead cell comes alive with a to b
+//   NM/NN   Moore (square) or von Neumann (diamond) neighbourhood
+//
+// "R1,C0,M0,S2..3,B3..3,NM" is plain Life
+struct LtlRule {
+	LtlRule() : radius(0), includeCenter(false), vonNeumann(false),
+				survivalMin(0), survivalMax(-1), birthMin(0), birthMax(-1) {}
+
+	// false if rule is not a valid two state rule, the rule is left unchanged then
+	bool parse(const std::string& rule);
+	std::string toString() const;
+
+	// a default constructed rule means plain Life with the normal engines
+	inline bool isSet() const { return radius > 0; }
+
+	// does a cell with count living cells in its neighbourhood live in the next generation
+	inline int survives(const int alive, const int count) const {
+		return alive ? (count >= survivalMin) & (count <= survivalMax)
+					 : (count >= birthMin) & (count <= birthMax);
+	}
+
+	int radius;
+	bool includeCenter;
+	bool vonNeumann;
+	int survivalMin;
+	int survivalMax;
+	int birthMin;
+	int birthMax;
+};
+
+// reads "a..b" (or a single number) at s
+static inline const char* ltlParseRange(const char* s, int& min, int& max) {
+	char* end;
+	min = (int)strtol(s, &end, 10);
+	if(end == s)
+		return 0;
+	max = min;
+	if(end[0] == '.' && end[1] == '.') {
+		s = end+2;
+		max = (int)strtol(s, &end, 10);
+		if(end == s)
+			return 0;
+	}
+	return end;
+}
+
+inline bool LtlRule::parse(const std::string& rule) {
+	LtlRule parsed;
+	const char* s = rule.c_str();
+
+	while(*s) {
+		char* end = 0;
+		const char key = *s++;
+
+		if(key == 'R' || key == 'r') {
+			parsed.radius = (int)strtol(s, &end, 10);
+			if(end == s || parsed.radius < 1 || parsed.radius > LTL_MAX_RADIUS)
+				return false;
+			s = end;
+		}
+		else if(key == 'C' || key == 'c') {
+			const int states = (int)strtol(s, &end, 10);
+			if(end == s || (states != 0 && states != 2))
+				return false;
+			s = end;
+		}
+		else if(key == 'M' || key == 'm') {
+			if(*s != '0' && *s != '1')
+				return false;
+			parsed.includeCenter = *s++ == '1';
+		}
+		else if(key == 'S' || key == 's') {
+			if(!(s = ltlParseRange(s, parsed.survivalMin, parsed.survivalMax)))
+				return false;
+		}
+		else if(key == 'B' || key == 'b') {
+			if(!(s = ltlParseRange(s, parsed.birthMin, parsed.birthMax)))
+				return false;
+		}
+		else if(key == 'N' || key == 'n') {
+			if(*s != 'M' && *s != 'N')
+				return false;
+			parsed.vonNeumann = *s++ == 'N';
+		}
+		else {
+			return false;
+		}
+
+		if(*s == ',')
+			++s;
+		else if(*s)
+			return false;
+	}
+
+	if(parsed.radius < 1 || parsed.survivalMin > parsed.survivalMax || parsed.birthMin > parsed.birthMax)
+		return false;
+
+	*this = parsed;
+	return true;
+}
+
+inline std::string LtlRule::toString() const {
+	char buffer[96];
+	sprintf(buffer, "R%d,C0,M%d,S%d..%d,B%d..%d,%s", radius, includeCenter ? 1 : 0,
+			survivalMin, survivalMax, birthMin, birthMax, vonNeumann ? "NN" : "NM");
+	return buffer;
+}
+
+// calculates generations of a Larger than Life rule with a constant cost per cell
+// no matter how big the radius is
+//
+// the board is wrapped into a padded grid with a border of h = r+1 cells (so no
+// lookup below ever has to wrap) and prefix sums of the living cells are built
+// over it once per generation:
+//   Moore        mA along the columns, a column of the square is two lookups and
+//                the square slides along the row by adding one column and dropping one
+//   von Neumann  mA along the falling and mB along the rising diagonals, the edges of
+//                the diamond are diagonals, so it slides by adding its two right
+//                edges and dropping its two left edges (eight lookups)
+// only the first square/diamond of every row is summed up directly
+template <class T>
+class LtlEngine {
+public:
+	LtlEngine() : mPaddedX(0), mPaddedY(0) {}
+
+	// calculates the generation after in into out (xDim*yDim cells each, out must not alias in)
+	// with nthreads OpenMP threads, stats receives hash and counters if keysX is set
+	void step(const LtlRule& rule, const T* in, T* out, const int xDim, const int yDim,
+			  const int nthreads, const uint64_t* keysX, GenerationStats& stats);
+
+private:
+	void buildPrefixSums(const LtlRule& rule, const T* in, const int xDim, const int yDim, const int nthreads);
+	template <bool tracked>
+	void calcRow(const LtlRule& rule, const T* in, T* out, const int xDim,
+				 const int y, const uint64_t* keysX, GenerationStats& stats) const;
+
+	// size of the padded grid
+	int mPaddedX;
+	int mPaddedY;
+	// board column/row of every padded column/row
+	std::vector<int> mWrapX;
+	std::vector<int> mWrapY;
+	std::vector<int32_t> mA;
+	std::vector<int32_t> mB;
+};
+
+template <class T>
+void LtlEngine<T>::buildPrefixSums(const LtlRule& rule, const T* in, const int xDim, const int yDim, const int nthreads) {
+	const int h = rule.radius+1;
+
+	if(mPaddedX != xDim+2*h || mPaddedY != yDim+2*h) {
+		mPaddedX = xDim+2*h;
+		mPaddedY = yDim+2*h;
+
+		mWrapX.resize(mPaddedX);
+		for(int px=0;px<mPaddedX;++px) {
+			mWrapX[px] = ((px-h)%xDim+xDim)%xDim;
+		}
+		mWrapY.resize(mPaddedY);
+		for(int py=0;py<mPaddedY;++py) {
+			mWrapY[py] = ((py-h)%yDim+yDim)%yDim;
+		}
+
+		mA.resize((size_t)mPaddedX*mPaddedY);
+		mB.resize(rule.vonNeumann ? (size_t)mPaddedX*mPaddedY : 0);
+	}
+	else if(rule.vonNeumann && mB.empty()) {
+		mB.resize((size_t)mPaddedX*mPaddedY);
+	}
+
+	const int pw = mPaddedX;
+	const int ph = mPaddedY;
+	const int* wrapX = &mWrapX[0];
+	int32_t* a = &mA[0];
+	int32_t* b = rule.vonNeumann ? &mB[0] : 0;
+	const bool vonNeumann = rule.vonNeumann;
+
+	// every row only needs the row above, the columns of a row are split among the threads
+	#pragma omp parallel num_threads(nthreads)
+	{
+		for(int py=0;py<ph;++py) {
+			const T* row = in+(size_t)mWrapY[py]*xDim;
+			int32_t* aRow = a+(size_t)py*pw;
+
+			if(py == 0) {
+				#pragma omp for schedule(static)
+				for(int px=0;px<pw;++px) {
+					aRow[px] = CellTraits<T>::alive(row[wrapX[px]]);
+					if(vonNeumann)
+						b[px] = aRow[px];
+				}
+				continue;
+			}
+
+			const int32_t* aAbove = aRow-pw;
+			if(!vonNeumann) {
+				#pragma omp for schedule(static)
+				for(int px=0;px<pw;++px) {
+					aRow[px] = aAbove[px] + CellTraits<T>::alive(row[wrapX[px]]);
+				}
+			}
+			else {
+				int32_t* bRow = b+(size_t)py*pw;
+				const int32_t* bAbove = bRow-pw;
+
+				#pragma omp for schedule(static)
+				for(int px=0;px<pw;++px) {
+					const int32_t cell = CellTraits<T>::alive(row[wrapX[px]]);
+					aRow[px] = cell + (px > 0 ? aAbove[px-1] : 0);
+					bRow[px] = cell + (px < pw-1 ? bAbove[px+1] : 0);
+				}
+			}
+		}
+	} // parallel section end
+}
+
+template <class T>
+template <bool tracked>
+void LtlEngine<T>::calcRow(const LtlRule& rule, const T* in, T* out, const int xDim,
+						   const int y, const uint64_t* keysX, GenerationStats& stats) const {
+	const int r = rule.radius;
+	const int h = r+1;
+	const int pw = mPaddedX;
+	const int Y = y+h;
+	const T* mid = in+(size_t)y*xDim;
+	T* row = out+(size_t)y*xDim;
+	const int center = rule.includeCenter ? 0 : 1;
+
+	uint64_t hash = 0;
+	int population = 0;
+	int births = 0;
+	int deaths = 0;
+	const uint64_t keyY = tracked ? hashKeyY(y) : 0;
+
+	if(!rule.vonNeumann) {
+		// sum of the living cells of padded column px in the rows y-r..y+r
+		const int32_t* lo = &mA[(size_t)(Y-r-1)*pw];
+		const int32_t* hi = &mA[(size_t)(Y+r)*pw];
+
+		int sum = 0;
+		for(int px=h-r;px<=h+r;++px) {
+			sum += hi[px]-lo[px];
+		}
+
+		for(int x=0;x<xDim;++x) {
+			const int alive = CellTraits<T>::alive(mid[x]);
+			const int is = rule.survives(alive, sum - center*alive);
+			row[x] = CellTraits<T>::update(mid[x], is);
+
+			if(tracked) {
+				hash += (uint64_t)row[x] * (keysX[x] ^ keyY);
+				population += is;
+				births += is & (alive ^ 1);
+				deaths += alive & (is ^ 1);
+			}
+
+			const int X = x+h;
+			sum += (hi[X+r+1]-lo[X+r+1]) - (hi[X-r]-lo[X-r]);
+		}
+	}
+	else {
+		const int32_t* a = &mA[0];
+		const int32_t* b = &mB[0];
+		// cells (x0,y0) .. (x0+k,y0+k) and (x0,y0) .. (x0-k,y0+k) of the padded grid
+		#define LTL_FALLING(x0, y0, k) (a[(size_t)((y0)+(k))*pw+(x0)+(k)] - a[(size_t)((y0)-1)*pw+(x0)-1])
+		#define LTL_RISING(x0, y0, k) (b[(size_t)((y0)+(k))*pw+(x0)-(k)] - b[(size_t)((y0)-1)*pw+(x0)+1])
+
+		// the first diamond of the row is summed up cell by cell
+		int sum = 0;
+		for(int dy=-r;dy<=r;++dy) {
+			const T* src = in+(size_t)mWrapY[Y+dy]*xDim;
+			const int w = r-(dy < 0 ? -dy : dy);
+			for(int dx=-w;dx<=w;++dx) {
+				sum += CellTraits<T>::alive(src[mWrapX[h+dx]]);
+			}
+		}
+
+		for(int x=0;x<xDim;++x) {
+			const int alive = CellTraits<T>::alive(mid[x]);
+			const int is = rule.survives(alive, sum - center*alive);
+			row[x] = CellTraits<T>::update(mid[x], is);
+
+			if(tracked) {
+				hash += (uint64_t)row[x] * (keysX[x] ^ keyY);
+				population += is;
+				births += is & (alive ^ 1);
+				deaths += alive & (is ^ 1);
+			}
+
+			// right edges of the diamond at X+1 in, left edges of the diamond at X out
+			const int X = x+h;
+			sum += LTL_FALLING(X+1, Y-r, r) + LTL_RISING(X+r, Y+1, r-1)
+				 - LTL_RISING(X, Y-r, r) - LTL_FALLING(X-r+1, Y+1, r-1);
+		}
+
+		#undef LTL_FALLING
+		#undef LTL_RISING
+	}
+
+	if(tracked) {
+		stats.hash += hash;
+		stats.population += population;
+		stats.births += births;
+		stats.deaths += deaths;
+	}
+}
+
+template <class T>
+void LtlEngine<T>::step(const LtlRule& rule, const T* in, T* out, const int xDim, const int yDim,
+						const int nthreads, const uint64_t* keysX, GenerationStats& stats) {
+	buildPrefixSums(rule, in, xDim, yDim, nthreads);
+
+	uint64_t hash = 0;
+	uint64_t population = 0;
+	uint64_t births = 0;
+	uint64_t deaths = 0;
+
+	#pragma omp parallel for num_threads(nthreads) schedule(static) reduction(+:hash,population,births,deaths)
+	for(int y=0;y<yDim;++y) {
+		GenerationStats row;
+		if(keysX)
+			calcRow<true>(rule, in, out, xDim, y, keysX, row);
+		else
+			calcRow<false>(rule, in, out, xDim, y, keysX, row);
+
+		hash += row.hash;
+		population += row.population;
+		births += row.births;
+		deaths += row.deaths;
+	}
+
+	stats.hash = hash;
+	stats.population = population;
+	stats.births = births;
+	stats.deaths = deaths;
+}
+
+#endif
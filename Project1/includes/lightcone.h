@@ -0,0 +1,125 @@
+#ifndef __LIGHTCONE_H
+#define __LIGHTCONE_H
+
+#include <stdint.h>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <omp.h>
+
+#include "rowkernel.h"
+
+// B3/S23 cells of a window of the board after some generations, calculated from the
+// backward light cone of the window only
+//
+// a cell only depends on the cells around it one generation before, so the window
+// after n generations only depends on the window grown by n cells on every side at the
+// start. that region is copied out of the board once (wrapping around it like the
+// board does, a region bigger than the board just repeats it, which is still exact)
+// and shrinks by one cell on every side per generation. nothing wraps inside of the
+// region, so every row is one loop without branches.
+//
+// the work is the sum of (width+2k)*(height+2k) for k below n instead of n times the
+// board, see cost
+template <class T>
+class LightCone {
+public:
+	// cells calculated by evolve
+	static uint64_t cost(const int width, const int height, const int generations);
+
+	// width x height cells at x, y of the board (xDim x yDim cells) after generations
+	// generations into window, row by row, with nthreads OpenMP threads
+	void evolve(const T* board, const int xDim, const int yDim, const int x, const int y,
+				const int width, const int height, const int generations, const int nthreads, std::vector<T>& window);
+
+	// copies the width x height cells at x, y of the board into out (width cells per row),
+	// x and y may be negative or beyond the board, the board wraps around
+	static void extract(const T* board, const int xDim, const int yDim, const int x, const int y,
+						const int width, const int height, T* out);
+
+private:
+	std::vector<T> mRegion;
+	std::vector<T> mNext;
+};
+
+template <class T>
+uint64_t LightCone<T>::cost(const int width, const int height, const int generations) {
+	if(generations < 1 || width < 1 || height < 1)
+		return 0;
+
+	// sum of (w+2k)*(h+2k) for k below g, which is g*w*h + 2*(w+h)*g(g-1)/2 + 4*(g-1)g(2g-1)/6
+	const uint64_t g = generations;
+	const uint64_t w = width;
+	const uint64_t h = height;
+
+	// the cones of a lot of generations are never cheaper than the board, the result
+	// just has to stay the biggest number then instead of wrapping around
+	const double estimate = (double)g*w*h + (double)(w+h)*g*(g-1) + 4.0*(g-1)*g*(2*g-1)/6.0;
+	if(estimate >= 1.8446e19)
+		return UINT64_MAX;
+
+	// (g-1)g is even and (g-1)g(2g-1) is divisible by 6, halved first so it does not wrap
+	return g*w*h + (w+h)*g*(g-1) + 4*((g-1)*g/2*(2*g-1)/3);
+}
+
+template <class T>
+void LightCone<T>::extract(const T* board, const int xDim, const int yDim, const int x, const int y,
+						   const int width, const int height, T* out) {
+	const int x0 = ((x%xDim)+xDim)%xDim;
+	const int y0 = ((y%yDim)+yDim)%yDim;
+
+	for(int r=0;r<height;++r) {
+		const T* row = board+(size_t)((y0+r)%yDim)*xDim;
+		T* dst = out+(size_t)r*width;
+
+		// the row in pieces up to the right edge of the board
+		int done = 0;
+		int col = x0;
+		while(done < width) {
+			const int n = std::min(width-done, xDim-col);
+			memcpy(dst+done, row+col, sizeof(T)*n);
+			done += n;
+			col = 0;
+		}
+	}
+}
+
+template <class T>
+void LightCone<T>::evolve(const T* board, const int xDim, const int yDim, const int x, const int y,
+						  const int width, const int height, const int generations, const int nthreads, std::vector<T>& window) {
+	const int n = generations;
+	const int w = width+2*n;
+	const int h = height+2*n;
+
+	mRegion.resize((size_t)w*h);
+	mNext.resize((size_t)w*h);
+	extract(board, xDim, yDim, x-n, y-n, w, h, &mRegion[0]);
+
+	T* in = &mRegion[0];
+	T* out = &mNext[0];
+	// generation k is known for the cells [k, w-k) x [k, h-k) of the region
+	for(int k=1;k<=n;++k) {
+		const int last = w-k;
+
+		#pragma omp parallel for num_threads(nthreads) schedule(static) if(nthreads > 1 && h-2*k >= 64)
+		for(int r=k;r<h-k;++r) {
+			const T* top = in+(size_t)(r-1)*w;
+			const T* mid = in+(size_t)r*w;
+			const T* bot = in+(size_t)(r+1)*w;
+			T* row = out+(size_t)r*w;
+
+			for(int c=k;c<last;++c) {
+				row[c] = calcCell(top, mid, bot, c-1, c, c+1);
+			}
+		}
+
+		std::swap(in, out);
+	}
+
+	window.resize((size_t)width*height);
+	for(int r=0;r<height;++r) {
+		memcpy(&window[(size_t)r*width], in+(size_t)(r+n)*w+n, sizeof(T)*width);
+	}
+}
+
+#endif
@@ -0,0 +1,437 @@
+#ifndef __MULTISTATE_H
+#define __MULTISTATE_H
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <omp.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "celltraits.h"
+#include "statistics.h"
+#include "cycledetector.h"
+
+// "Generations" rule: a living cell (state 1) that does not survive does not die at
+// once but passes through the refractory states 2 .. states-1 before it is dead
+// (state 0) again, only state 1 counts as a living neighbour and only dead cells are
+// born. Brian's Brain is B2/S/C3, Star Wars 345/2/4.
+//
+// written like Golly does, either
+//   B<digits>/S<digits>/C<states>    e.g. "B2/S/C3" (G<states> works as well)
+//   <survival>/<birth>/<states>      e.g. "345/2/4"
+// or by name: brain, starwars, frogs, bloomerang
+// a rule with two states is an ordinary B/S rule, "B3/S23/C2" is plain Life
+struct StatesRule {
+	StatesRule() : states(0), birth(0), survival(0) {}
+
+	bool parse(const std::string& rule);
+	std::string toString() const;
+
+	inline bool isSet() const { return states > 0; }
+	// bit-planes a board of this rule needs
+	inline int planes() const {
+		int p = 1;
+		while((1 << p) < states) {
+			++p;
+		}
+		return p;
+	}
+
+	int states;
+	// bit n set: a dead cell with n living neighbours is born / a living cell survives
+	unsigned birth;
+	unsigned survival;
+};
+
+// digits 0..8 of s into mask, false on anything else
+static inline bool statesParseDigits(const std::string& s, unsigned& mask) {
+	mask = 0;
+	for(size_t i=0;i<s.length();++i) {
+		if(s[i] < '0' || s[i] > '8')
+			return false;
+		mask |= 1u << (s[i]-'0');
+	}
+	return true;
+}
+
+inline bool StatesRule::parse(const std::string& rule) {
+	struct Named { const char* name; const char* rule; };
+	static const Named named[] = {
+		{"brain", "/2/3"}, {"starwars", "345/2/4"}, {"frogs", "12/34/3"}, {"bloomerang", "234/34678/24"}
+	};
+	for(int i=0;i<4;++i) {
+		if(rule == named[i].name)
+			return parse(named[i].rule);
+	}
+
+	std::vector<std::string> fields;
+	size_t start = 0;
+	for(;;) {
+		const size_t slash = rule.find('/', start);
+		fields.push_back(rule.substr(start, slash == std::string::npos ? std::string::npos : slash-start));
+		if(slash == std::string::npos)
+			break;
+		start = slash+1;
+	}
+	if(fields.size() < 2 || fields.size() > 3)
+		return false;
+
+	StatesRule parsed;
+	parsed.states = 2;
+
+	const bool letters = !fields[0].empty() && (fields[0][0] == 'B' || fields[0][0] == 'b' || fields[0][0] == 'S' || fields[0][0] == 's');
+	for(size_t i=0;i<fields.size();++i) {
+		const std::string& f = fields[i];
+
+		if(!letters) {
+			// survival/birth/states
+			if(i == 2) {
+				char* end;
+				parsed.states = (int)strtol(f.c_str(), &end, 10);
+				if(f.empty() || *end)
+					return false;
+			}
+			else if(!statesParseDigits(f, i == 0 ? parsed.survival : parsed.birth)) {
+				return false;
+			}
+			continue;
+		}
+
+		if(f.empty())
+			return false;
+		const char key = (char)(f[0] | 0x20);
+		const std::string value = f.substr(1);
+		if(key == 'b') {
+			if(!statesParseDigits(value, parsed.birth))
+				return false;
+		}
+		else if(key == 's') {
+			if(!statesParseDigits(value, parsed.survival))
+				return false;
+		}
+		else if(key == 'c' || key == 'g') {
+			char* end;
+			parsed.states = (int)strtol(value.c_str(), &end, 10);
+			if(value.empty() || *end)
+				return false;
+		}
+		else {
+			return false;
+		}
+	}
+
+	// a dead cell with no living neighbours would come alive everywhere at once
+	if(parsed.states < 2 || parsed.states > CELL_MAX_STATES || (parsed.birth & 1))
+		return false;
+
+	*this = parsed;
+	return true;
+}
+
+inline std::string StatesRule::toString() const {
+	std::string rule = "B";
+	for(int n=0;n<=8;++n) {
+		if(birth & (1u << n))
+			rule += (char)('0'+n);
+	}
+	rule += "/S";
+	for(int n=0;n<=8;++n) {
+		if(survival & (1u << n))
+			rule += (char)('0'+n);
+	}
+	char buffer[16];
+	sprintf(buffer, "/C%d", states);
+	return rule + buffer;
+}
+
+// .gol text of n cells that may be in any state
+template <class T>
+inline void statesToText(const T* cells, const int n, char* text) {
+	for(int i=0;i<n;++i) {
+		text[i] = stateToChar(CellTraits<T>::state(cells[i]));
+	}
+}
+
+// living cells of a word
+static inline int statesPopcount(const uint64_t v) {
+#ifdef _MSC_VER
+	return (int)__popcnt64(v);
+#else
+	return __builtin_popcountll(v);
+#endif
+}
+
+// byte i of spread(b) is bit i of b, turns 8 bits of a plane into 8 cells at once
+struct StatesSpread {
+	uint64_t v[256];
+
+	StatesSpread() {
+		for(int b=0;b<256;++b) {
+			v[b] = 0;
+			for(int i=0;i<8;++i) {
+				v[b] |= (uint64_t)((b >> i) & 1) << (8*i);
+			}
+		}
+	}
+};
+
+// calculates generations of a Generations rule on bit-planes
+//
+// plane p of a row holds bit p of the state of 64 cells per word, so a rule with
+// n states needs ceil(log2 n) planes (PLANES is a template parameter, every plane
+// count from 1 to 6 is its own specialisation). the planes are the board the engine
+// works on, they are only packed from the cells once and again after the board was
+// changed outside of step (see invalidate). per generation:
+//   - living cells (state 1) of the row and its two neighbour rows are shifted by one
+//     cell in both directions (wrapping around the board) and summed up by a
+//     bit-sliced adder, which gives the four bits of the neighbour count of 64 cells
+//   - births and survivals are ORs of the count compares of the rule
+//   - every cell that is dead and born, living and not surviving or refractory
+//     moves on to the next state, that is one ripple carry increment over the
+//     planes, states that reach n wrap around to 0
+//   - the new planes are written to the cells eight at a time, since everything
+//     else (files, views, checkpoints) reads those. population, births and deaths
+//     are popcounts of the living words, only the hash goes cell by cell
+template <class T>
+class StatesEngine {
+public:
+	StatesEngine() : mWords(0), mXDim(0), mYDim(0), mPlaneCount(0), mValid(false) {}
+
+	// calculates the generation after board (xDim*yDim cells) into board itself
+	// with nthreads OpenMP threads, stats receives hash and counters if keysX is set
+	void step(const StatesRule& rule, T* board, const int xDim, const int yDim,
+			  const int nthreads, const uint64_t* keysX, GenerationStats& stats);
+
+	// the cells were changed outside of step, the planes are packed again before the next one
+	inline void invalidate() { mValid = false; }
+
+private:
+	template <int PLANES>
+	void stepPlanes(const StatesRule& rule, T* board, const int xDim, const int yDim,
+					const int nthreads, const uint64_t* keysX, GenerationStats& stats);
+	template <int PLANES>
+	void pack(const T* board, const int xDim, const int y);
+	// living cells (state 1) of word w of row y
+	template <int PLANES>
+	inline uint64_t alive(const int y, const int w) const {
+		const uint64_t* p = &mPlanes[((size_t)y*PLANES)*mWords+w];
+		uint64_t higher = 0;
+		for(int i=1;i<PLANES;++i) {
+			higher |= p[(size_t)i*mWords];
+		}
+		return p[0] & ~higher;
+	}
+
+	int mWords;
+	// board the planes were packed for
+	int mXDim;
+	int mYDim;
+	int mPlaneCount;
+	bool mValid;
+	// current and next generation, row y, plane p starts at ((y*PLANES)+p)*mWords
+	std::vector<uint64_t> mPlanes;
+	std::vector<uint64_t> mNext;
+	// living cells of the three rows around every row, one set per thread
+	std::vector<uint64_t> mRows;
+};
+
+template <class T>
+template <int PLANES>
+void StatesEngine<T>::pack(const T* board, const int xDim, const int y) {
+	uint64_t* planes = &mPlanes[((size_t)y*PLANES)*mWords];
+	memset(planes, 0, sizeof(uint64_t)*PLANES*mWords);
+
+	const T* row = board+(size_t)y*xDim;
+	for(int x=0;x<xDim;++x) {
+		const unsigned s = (unsigned)CellTraits<T>::state(row[x]);
+		const uint64_t bit = 1ULL << (x&63);
+		for(int p=0;p<PLANES;++p) {
+			planes[(size_t)p*mWords+(x>>6)] |= ((s >> p) & 1) ? bit : 0;
+		}
+	}
+}
+
+template <class T>
+template <int PLANES>
+void StatesEngine<T>::stepPlanes(const StatesRule& rule, T* board, const int xDim, const int yDim,
+								 const int nthreads, const uint64_t* keysX, GenerationStats& stats) {
+	static const StatesSpread spread;
+
+	const int words = mWords;
+	const int last = words-1;
+	// bit of cell xDim-1 in the last word, the bits above it have to stay 0
+	const int lastBit = (xDim-1)&63;
+	const uint64_t lastMask = lastBit == 63 ? ~0ULL : (1ULL << (lastBit+1))-1;
+	const unsigned states = (unsigned)rule.states;
+	const bool wraps = states != (1u << PLANES);
+
+	mRows.resize((size_t)nthreads*3*words);
+
+	if(!mValid) {
+		#pragma omp parallel for num_threads(nthreads) schedule(static)
+		for(int y=0;y<yDim;++y) {
+			pack<PLANES>(board, xDim, y);
+		}
+		mValid = true;
+	}
+
+	uint64_t hash = 0;
+	uint64_t population = 0;
+	uint64_t births = 0;
+	uint64_t deaths = 0;
+
+	#pragma omp parallel num_threads(nthreads) reduction(+:hash,population,births,deaths)
+	{
+		uint64_t* rows = &mRows[(size_t)omp_get_thread_num()*3*words];
+
+		#pragma omp for schedule(static)
+		for(int y=0;y<yDim;++y) {
+			const int ys[3] = {(y-1+yDim)%yDim, y, (y+1)%yDim};
+			for(int r=0;r<3;++r) {
+				for(int w=0;w<words;++w) {
+					rows[r*words+w] = alive<PLANES>(ys[r], w);
+				}
+			}
+
+			const uint64_t keyY = keysX ? hashKeyY(y) : 0;
+			T* row = board+(size_t)y*xDim;
+
+			for(int w=0;w<words;++w) {
+				// bits of the neighbour count, s3 is only set for eight
+				uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+
+				for(int r=0;r<3;++r) {
+					const uint64_t* a = rows+r*words;
+					// west: cell x-1, east: cell x+1, both wrap around the row
+					const uint64_t west = (a[w] << 1) | (w == 0 ? (a[last] >> lastBit) & 1 : a[w-1] >> 63);
+					const uint64_t east = w == last ? (a[w] >> 1) | ((a[0] & 1) << lastBit)
+													: (a[w] >> 1) | (a[w+1] << 63);
+					const uint64_t in3[3] = {west, east, a[w]};
+
+					// the row itself only adds its west and east cells
+					for(int k=0;k<(r == 1 ? 2 : 3);++k) {
+						uint64_t carry = s0 & in3[k];
+						s0 ^= in3[k];
+						uint64_t carry2 = s1 & carry;
+						s1 ^= carry;
+						uint64_t carry3 = s2 & carry2;
+						s2 ^= carry2;
+						s3 |= carry3;
+					}
+				}
+
+				uint64_t born = 0;
+				uint64_t survive = 0;
+				for(int n=0;n<=8;++n) {
+					if(!((rule.birth | rule.survival) & (1u << n)))
+						continue;
+					const uint64_t eq = ((n & 1) ? s0 : ~s0) & ((n & 2) ? s1 : ~s1) & ((n & 4) ? s2 : ~s2) & ((n & 8) ? s3 : ~s3);
+					if(rule.birth & (1u << n))
+						born |= eq;
+					if(rule.survival & (1u << n))
+						survive |= eq;
+				}
+
+				uint64_t q[PLANES];
+				uint64_t higher = 0;
+				for(int p=0;p<PLANES;++p) {
+					q[p] = mPlanes[((size_t)y*PLANES+p)*words+w];
+					if(p > 0)
+						higher |= q[p];
+				}
+				const uint64_t dead = ~(q[0] | higher);
+				const uint64_t living = q[0] & ~higher;
+				// refractory cells always move on, cells past the end of the row never do
+				uint64_t carry = (dead & born) | (living & ~survive) | ~(dead | living);
+				if(w == last)
+					carry &= lastMask;
+
+				for(int p=0;p<PLANES;++p) {
+					const uint64_t c = q[p] & carry;
+					q[p] ^= carry;
+					carry = c;
+				}
+				if(wraps) {
+					uint64_t full = ~0ULL;
+					for(int p=0;p<PLANES;++p) {
+						full &= ((states >> p) & 1) ? q[p] : ~q[p];
+					}
+					for(int p=0;p<PLANES;++p) {
+						q[p] &= ~full;
+					}
+				}
+
+				uint64_t nowHigher = 0;
+				for(int p=0;p<PLANES;++p) {
+					mNext[((size_t)y*PLANES+p)*words+w] = q[p];
+					if(p > 0)
+						nowHigher |= q[p];
+				}
+
+				// eight cells per step, byte i of states is the state of cell x+i
+				const int x0 = w << 6;
+				const int x1 = (x0+64 < xDim) ? x0+64 : xDim;
+				for(int x=x0;x<x1;x+=8) {
+					const int shift = x&63;
+					uint64_t cells = 0;
+					for(int p=0;p<PLANES;++p) {
+						cells |= spread.v[(q[p] >> shift) & 0xFF] << p;
+					}
+					const int n = (x+8 < x1) ? 8 : x1-x;
+					for(int i=0;i<n;++i) {
+						row[x+i] = CellTraits<T>::fromState((int)((cells >> (8*i)) & 0xFF));
+					}
+				}
+
+				if(keysX) {
+					const uint64_t was = rows[words+w];
+					const uint64_t is = q[0] & ~nowHigher;
+					population += statesPopcount(is);
+					births += statesPopcount(is & ~was);
+					deaths += statesPopcount(was & ~is);
+					for(int x=x0;x<x1;++x) {
+						hash += (uint64_t)row[x] * (keysX[x] ^ keyY);
+					}
+				}
+			}
+		}
+	}
+
+	mPlanes.swap(mNext);
+
+	stats.hash = hash;
+	stats.population = population;
+	stats.births = births;
+	stats.deaths = deaths;
+}
+
+template <class T>
+void StatesEngine<T>::step(const StatesRule& rule, T* board, const int xDim, const int yDim,
+						   const int nthreads, const uint64_t* keysX, GenerationStats& stats) {
+	const int planes = rule.planes();
+	// another board or rule starts over from the cells
+	if(xDim != mXDim || yDim != mYDim || planes != mPlaneCount) {
+		mXDim = xDim;
+		mYDim = yDim;
+		mPlaneCount = planes;
+		mWords = (xDim+63)/64;
+		mPlanes.assign((size_t)yDim*planes*mWords, 0);
+		mNext.assign((size_t)yDim*planes*mWords, 0);
+		mValid = false;
+	}
+
+	switch(planes) {
+		case 1: stepPlanes<1>(rule, board, xDim, yDim, nthreads, keysX, stats); break;
+		case 2: stepPlanes<2>(rule, board, xDim, yDim, nthreads, keysX, stats); break;
+		case 3: stepPlanes<3>(rule, board, xDim, yDim, nthreads, keysX, stats); break;
+		case 4: stepPlanes<4>(rule, board, xDim, yDim, nthreads, keysX, stats); break;
+		case 5: stepPlanes<5>(rule, board, xDim, yDim, nthreads, keysX, stats); break;
+		default: stepPlanes<6>(rule, board, xDim, yDim, nthreads, keysX, stats); break;
+	}
+}
+
+#endif
@@ -0,0 +1,459 @@
+#ifndef __PATTERNCODEC_H
+#define __PATTERNCODEC_H
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <climits>
+#include <algorithm>
+
+#include "celltraits.h"
+#include "transcode.h"
+
+// streaming readers and writers for the pattern formats of other life tools
+//
+// RLE (Golly/XLife):  "x = 3, y = 3, rule = B3/S23" header, then runs like 2bo$3o!
+//                     b/. dead, o or any other letter alive, $ end of row, ! end
+// Life 1.06:          "#Life 1.06" header, then one "x y" line per living cell
+// binary (.golb):     "GOLB", width and height as 32 bit little endian, then every row
+//                     as (width+7)/8 bytes, cell x is bit x%8 (lsb first) of byte x/8
+//
+// the files are read through a fixed size buffer and decoded straight into a sink,
+// nothing the size of the board is built in between. a sink provides
+//
+//   bool resize(const int xDim, const int yDim)            once before any cell, board is all dead
+//   void setAlive(const int x, const int y, const int n)   n living cells starting at x in row y
+//
+// so the same readers fill a Gameoflife board or any packed representation.
+// the writers take the rows of a board of T and only look at CellTraits<T>::alive
+
+enum PatternFormat {
+	FORMAT_GOL,
+	FORMAT_RLE,
+	FORMAT_LIFE106,
+	FORMAT_BINARY
+};
+
+// format by file extension, everything unknown is .gol
+inline PatternFormat patternFormat(const char* fileName) {
+	const char* ext = strrchr(fileName, '.');
+	if(!ext)
+		return FORMAT_GOL;
+
+	std::string lower(ext+1);
+	for(size_t i=0;i<lower.length();++i) {
+		if(lower[i] >= 'A' && lower[i] <= 'Z')
+			lower[i] = lower[i]-'A'+'a';
+	}
+
+	if(lower == "rle")
+		return FORMAT_RLE;
+	if(lower == "lif" || lower == "life")
+		return FORMAT_LIFE106;
+	if(lower == "golb")
+		return FORMAT_BINARY;
+	return FORMAT_GOL;
+}
+
+// buffered byte stream on top of stdio
+class PatternInput {
+public:
+	explicit PatternInput(const char* fileName) : mFile(fopen(fileName, "rb")), mBuffer(64*1024), mPos(0), mEnd(0) {}
+	~PatternInput() { if(mFile) fclose(mFile); }
+
+	inline bool isOpen() const { return mFile != 0; }
+
+	inline int get() {
+		if(mPos == mEnd && !fill())
+			return EOF;
+		return (unsigned char)mBuffer[mPos++];
+	}
+	inline int peek() {
+		if(mPos == mEnd && !fill())
+			return EOF;
+		return (unsigned char)mBuffer[mPos];
+	}
+
+	// starts over at the beginning of the file
+	void rewind() {
+		fseek(mFile, 0, SEEK_SET);
+		mPos = mEnd = 0;
+	}
+
+	// reads up to count bytes, returns how many were read
+	size_t read(char* dst, const size_t count) {
+		size_t done = 0;
+		while(done < count) {
+			if(mPos == mEnd && !fill())
+				break;
+			const size_t n = (mEnd-mPos < count-done) ? mEnd-mPos : count-done;
+			memcpy(dst+done, &mBuffer[mPos], n);
+			mPos += n;
+			done += n;
+		}
+		return done;
+	}
+
+	// skips the rest of the current line including the line break
+	void skipLine() {
+		int c;
+		while((c = get()) != EOF && c != '\n') {}
+	}
+
+	// skips spaces and tabs, but not line breaks
+	void skipBlanks() {
+		while(peek() == ' ' || peek() == '\t' || peek() == '\r') {
+			get();
+		}
+	}
+
+	// reads an optionally signed decimal number, returns false if there is none
+	bool readInt(int& value) {
+		skipBlanks();
+		bool negative = false;
+		if(peek() == '-' || peek() == '+') {
+			negative = get() == '-';
+		}
+		if(peek() < '0' || peek() > '9')
+			return false;
+
+		long long v = 0;
+		while(peek() >= '0' && peek() <= '9') {
+			if(v < INT_MAX)
+				v = v*10 + (get()-'0');
+			else
+				get();
+		}
+		if(v > INT_MAX)
+			v = INT_MAX;
+		value = (int)(negative ? -v : v);
+		return true;
+	}
+
+private:
+	bool fill() {
+		if(!mFile)
+			return false;
+		mEnd = fread(&mBuffer[0], 1, mBuffer.size(), mFile);
+		mPos = 0;
+		return mEnd > 0;
+	}
+
+	FILE* mFile;
+	std::vector<char> mBuffer;
+	size_t mPos;
+	size_t mEnd;
+};
+
+// decodes an RLE file into sink, cells outside of the header size are dropped
+template <class Sink>
+bool readRLE(const char* fileName, Sink& sink) {
+	PatternInput in(fileName);
+	if(!in.isOpen())
+		return false;
+
+	// comment lines (#N, #C, #O, ...) come before the header
+	while(in.peek() == '#') {
+		in.skipLine();
+	}
+
+	// x = <width>, y = <height>[, rule = ...]
+	int xDim = 0;
+	int yDim = 0;
+	for(int c=in.peek();c != EOF && c != '\n';c=in.peek()) {
+		if(c == 'x' || c == 'y') {
+			in.get();
+			in.skipBlanks();
+			if(in.peek() == '=') {
+				in.get();
+				in.readInt(c == 'x' ? xDim : yDim);
+			}
+		}
+		else if(c == 'r') {
+			// the rule is ignored, the engines only know B3/S23
+			while(in.peek() != EOF && in.peek() != '\n') {
+				in.get();
+			}
+		}
+		else {
+			in.get();
+		}
+	}
+	in.get();
+
+	if(xDim < 1 || yDim < 1 || !sink.resize(xDim, yDim))
+		return false;
+
+	// runs never reach further than the board, so counts and positions are clipped
+	// to it and can not overflow, whatever the file says
+	const int maxRun = xDim > yDim ? xDim : yDim;
+	int x = 0;
+	int y = 0;
+	int count = 0;
+	for(int c=in.get();c != EOF && c != '!' && y < yDim;c=in.get()) {
+		if(c >= '0' && c <= '9') {
+			count = count*10 + (c-'0');
+			if(count > maxRun)
+				count = maxRun;
+			continue;
+		}
+
+		const int n = count ? count : 1;
+		count = 0;
+
+		if(c == '$') {
+			y = (n < yDim-y) ? y+n : yDim;
+			x = 0;
+		}
+		else if(c == 'b' || c == '.') {
+			x = (n < xDim-x) ? x+n : xDim;
+		}
+		else if((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+			// the rest of a row that is too long is dropped
+			if(x < xDim)
+				sink.setAlive(x, y, (n < xDim-x) ? n : xDim-x);
+			x = (n < xDim-x) ? x+n : xDim;
+		}
+		else if(c == '#') {
+			// trailing comment lines
+			in.skipLine();
+		}
+		// line breaks and blanks between runs are ignored
+	}
+
+	return true;
+}
+
+// decodes a Life 1.06 file into sink, the board is the bounding box of the cells
+// the file is read twice since the size is only known after the last cell
+template <class Sink>
+bool readLife106(const char* fileName, Sink& sink) {
+	PatternInput in(fileName);
+	if(!in.isOpen())
+		return false;
+
+	int minX = INT_MAX;
+	int minY = INT_MAX;
+	int maxX = INT_MIN;
+	int maxY = INT_MIN;
+
+	for(int pass=0;pass<2;++pass) {
+		while(in.peek() != EOF) {
+			if(in.peek() == '#') {
+				in.skipLine();
+				continue;
+			}
+
+			int x;
+			int y;
+			if(in.readInt(x) && in.readInt(y)) {
+				if(pass == 0) {
+					minX = x < minX ? x : minX;
+					minY = y < minY ? y : minY;
+					maxX = x > maxX ? x : maxX;
+					maxY = y > maxY ? y : maxY;
+				}
+				else {
+					sink.setAlive(x-minX, y-minY, 1);
+				}
+			}
+			in.skipLine();
+		}
+
+		if(pass == 0) {
+			// no cells at all gives a single dead cell
+			if(minX > maxX) {
+				minX = maxX = 0;
+				minY = maxY = 0;
+			}
+			if(!sink.resize(maxX-minX+1, maxY-minY+1))
+				return false;
+			in.rewind();
+		}
+	}
+
+	return true;
+}
+
+// bytes of one row in the binary format
+inline size_t binaryRowBytes(const int xDim) { return ((size_t)xDim+7)/8; }
+
+inline bool writeBinaryHeader(FILE* file, const int xDim, const int yDim) {
+	unsigned char header[12] = {'G', 'O', 'L', 'B'};
+	for(int i=0;i<4;++i) {
+		header[4+i] = (unsigned char)((unsigned)xDim >> (8*i));
+		header[8+i] = (unsigned char)((unsigned)yDim >> (8*i));
+	}
+	return fwrite(header, 1, sizeof(header), file) == sizeof(header);
+}
+
+// decodes a binary board into sink
+template <class Sink>
+bool readBinary(const char* fileName, Sink& sink) {
+	PatternInput in(fileName);
+	if(!in.isOpen())
+		return false;
+
+	unsigned char header[12];
+	if(in.read((char*)header, sizeof(header)) != sizeof(header) || memcmp(header, "GOLB", 4) != 0)
+		return false;
+
+	unsigned xDim = 0;
+	unsigned yDim = 0;
+	for(int i=0;i<4;++i) {
+		xDim |= (unsigned)header[4+i] << (8*i);
+		yDim |= (unsigned)header[8+i] << (8*i);
+	}
+	if(xDim < 1 || yDim < 1 || xDim > INT_MAX || yDim > INT_MAX || !sink.resize((int)xDim, (int)yDim))
+		return false;
+
+	std::vector<char> row(binaryRowBytes(xDim));
+	for(int y=0;y<(int)yDim;++y) {
+		if(in.read(&row[0], row.size()) != row.size())
+			return false;
+
+		// runs of living cells
+		int begin = -1;
+		for(int x=0;x<(int)xDim;++x) {
+			const int alive = (row[x>>3] >> (x&7)) & 1;
+			if(alive && begin < 0) {
+				begin = x;
+			}
+			else if(!alive && begin >= 0) {
+				sink.setAlive(begin, y, x-begin);
+				begin = -1;
+			}
+		}
+		if(begin >= 0)
+			sink.setAlive(begin, y, (int)xDim-begin);
+	}
+
+	return true;
+}
+
+// writes the board given by its rows in the binary format
+template <class T>
+bool writeBinary(const char* fileName, const T* const* rows, const int xDim, const int yDim) {
+	FILE* file = fopen(fileName, "wb");
+	if(!file)
+		return false;
+	setvbuf(file, 0, _IOFBF, 64*1024);
+
+	bool ok = writeBinaryHeader(file, xDim, yDim);
+
+	std::vector<unsigned char> bits(binaryRowBytes(xDim));
+	for(int y=0;y<yDim && ok;++y) {
+		cellsToBits(rows[y], xDim, &bits[0]);
+		ok = fwrite(&bits[0], 1, bits.size(), file) == bits.size();
+	}
+
+	fclose(file);
+	return ok;
+}
+
+// buffered writer that keeps RLE lines below the usual 70 characters
+class RLEOutput {
+public:
+	explicit RLEOutput(const char* fileName) : mFile(fopen(fileName, "wb")), mLineLength(0) {
+		if(mFile)
+			setvbuf(mFile, 0, _IOFBF, 64*1024);
+	}
+	~RLEOutput() { if(mFile) fclose(mFile); }
+
+	inline bool isOpen() const { return mFile != 0; }
+	inline FILE* file() { return mFile; }
+
+	// writes a run of n times tag, the count is left out for single cells
+	void run(const int n, const char tag) {
+		char token[16];
+		int length;
+		if(n > 1)
+			length = sprintf(token, "%d%c", n, tag);
+		else {
+			token[0] = tag;
+			length = 1;
+		}
+
+		if(mLineLength+length > 70) {
+			fputc('\n', mFile);
+			mLineLength = 0;
+		}
+		fwrite(token, 1, length, mFile);
+		mLineLength += length;
+	}
+
+private:
+	FILE* mFile;
+	int mLineLength;
+};
+
+// encodes the board given by its rows as RLE
+// dead cells at the end of a row and empty rows at the end are left out
+template <class T>
+bool writeRLE(const char* fileName, const T* const* rows, const int xDim, const int yDim) {
+	RLEOutput out(fileName);
+	if(!out.isOpen())
+		return false;
+
+	fprintf(out.file(), "x = %d, y = %d, rule = B3/S23\n", xDim, yDim);
+
+	// row breaks are only written once the next row has living cells
+	int pendingRows = 0;
+	for(int y=0;y<yDim;++y) {
+		const T* row = rows[y];
+		int deadRun = 0;
+
+		for(int x=0;x<xDim;) {
+			const int alive = CellTraits<T>::alive(row[x]);
+			int n = 1;
+			while(x+n < xDim && CellTraits<T>::alive(row[x+n]) == alive) {
+				++n;
+			}
+
+			if(alive) {
+				if(pendingRows) {
+					out.run(pendingRows, '$');
+					pendingRows = 0;
+				}
+				if(deadRun)
+					out.run(deadRun, 'b');
+				out.run(n, 'o');
+				deadRun = 0;
+			}
+			else {
+				deadRun = n;
+			}
+			x += n;
+		}
+
+		++pendingRows;
+	}
+
+	out.run(1, '!');
+	fputc('\n', out.file());
+
+	return true;
+}
+
+// writes one "x y" line per living cell
+template <class T>
+bool writeLife106(const char* fileName, const T* const* rows, const int xDim, const int yDim) {
+	FILE* file = fopen(fileName, "wb");
+	if(!file)
+		return false;
+	setvbuf(file, 0, _IOFBF, 64*1024);
+
+	fputs("#Life 1.06\n", file);
+	for(int y=0;y<yDim;++y) {
+		for(int x=0;x<xDim;++x) {
+			if(CellTraits<T>::alive(rows[y][x]))
+				fprintf(file, "%d %d\n", x, y);
+		}
+	}
+
+	fclose(file);
+	return true;
+}
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef __ROWKERNEL_H
+#define __ROWKERNEL_H
+
+#include <stdint.h>
+
+#include "celltraits.h"
+#include "cycledetector.h"
+#include "statistics.h"
+
+// next state of cell x from the three rows around it, xLeft/xRight are the
+// (possibly wrapped) columns next to x
+template <class T>
+inline T calcCell(const T* top, const T* mid, const T* bot, const int xLeft, const int x, const int xRight) {
+	const int neighbors = CellTraits<T>::alive(top[xLeft]) + CellTraits<T>::alive(top[x]) + CellTraits<T>::alive(top[xRight])
+						+ CellTraits<T>::alive(mid[xLeft])                                + CellTraits<T>::alive(mid[xRight])
+						+ CellTraits<T>::alive(bot[xLeft]) + CellTraits<T>::alive(bot[x]) + CellTraits<T>::alive(bot[xRight]);
+	return CellTraits<T>::next(mid[x], neighbors);
+}
+
+// calculates the columns [xBegin, xEnd) of one row of the next generation
+// top/mid/bot are the rows above, at and below the new row, out must not alias them
+// the first and last column wrap around, everything in between has no branches
+// so the eight loads are summed up in a loop the compiler can vectorize
+template <class T>
+inline void calcRowCellsRange(const T* top, const T* mid, const T* bot, T* out, const int xDim, const int xBegin, const int xEnd) {
+	const int last = xDim-1;
+	int x = xBegin;
+
+	if(x == 0 && xEnd > 0) {
+		out[0] = calcCell(top, mid, bot, last, 0, 1%xDim);
+		x = 1;
+	}
+
+	const int end = (xEnd == xDim) ? last : xEnd;
+	for(;x<end;++x) {
+		out[x] = calcCell(top, mid, bot, x-1, x, x+1);
+	}
+
+	if(xEnd == xDim && x == last && last > 0) {
+		out[last] = calcCell(top, mid, bot, last-1, last, 0);
+	}
+}
+
+// calculates a whole row of the next generation
+template <class T>
+inline void calcRowCells(const T* top, const T* mid, const T* bot, T* out, const int xDim) {
+	calcRowCellsRange(top, mid, bot, out, xDim, 0, xDim);
+}
+
+// adds hash, population, births and deaths of row y to stats, was is the row before
+// and is the row after the generation (xDim cells each), keysX the column keys of the hash
+template <class T>
+inline void countRowCells(const T* was, const T* is, const int y, const int xDim, const uint64_t* keysX, GenerationStats& stats) {
+	const uint64_t keyY = hashKeyY(y);
+	uint64_t hash = 0;
+	int population = 0;
+	int births = 0;
+	int deaths = 0;
+
+	for(int x=0;x<xDim;++x) {
+		const int w = CellTraits<T>::alive(was[x]);
+		const int i = CellTraits<T>::alive(is[x]);
+		hash += (uint64_t)is[x] * (keysX[x] ^ keyY);
+		population += i;
+		births += i & (w ^ 1);
+		deaths += w & (i ^ 1);
+	}
+
+	stats.hash += hash;
+	stats.population += population;
+	stats.births += births;
+	stats.deaths += deaths;
+}
+
+#endif
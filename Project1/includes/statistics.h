@@ -0,0 +1,67 @@
+#ifndef __STATISTICS_H
+#define __STATISTICS_H
+
+#include <stdint.h>
+#include <cstdio>
+
+// counters of one generation, accumulated while the generation is calculated
+// (per row, per thread or per work-group) and summed up afterwards
+// the layout matches the ulong4 partials written by kernel.cl
+struct GenerationStats {
+	// board hash, see CycleDetector
+	uint64_t hash;
+	// living cells
+	uint64_t population;
+	// cells that came alive / died in this generation
+	uint64_t births;
+	uint64_t deaths;
+
+	GenerationStats() : hash(0), population(0), births(0), deaths(0) {}
+
+	inline GenerationStats& operator+=(const GenerationStats& other) {
+		hash += other.hash;
+		population += other.population;
+		births += other.births;
+		deaths += other.deaths;
+		return *this;
+	}
+};
+
+// streams one line "generation population births deaths" per generation
+// into a time series file, writes are buffered by stdio
+class StatisticsWriter {
+public:
+	StatisticsWriter() : mFile(0) {}
+	~StatisticsWriter() { close(); }
+
+	bool open(const char* fileName) {
+		close();
+		mFile = fopen(fileName, "w");
+		if(!mFile)
+			return false;
+
+		fprintf(mFile, "# generation population births deaths\n");
+		return true;
+	}
+
+	void close() {
+		if(mFile) {
+			fclose(mFile);
+			mFile = 0;
+		}
+	}
+
+	inline bool isOpen() const { return mFile != 0; }
+
+	inline void write(const int generation, const GenerationStats& stats) {
+		if(mFile) {
+			fprintf(mFile, "%d %llu %llu %llu\n", generation, (unsigned long long)stats.population,
+					(unsigned long long)stats.births, (unsigned long long)stats.deaths);
+		}
+	}
+
+private:
+	FILE* mFile;
+};
+
+#endif
@@ -0,0 +1,298 @@
+#ifndef __STREAMENGINE_H
+#define __STREAMENGINE_H
+
+#include <Windows.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+#include "celltraits.h"
+#include "transcode.h"
+#include "rowkernel.h"
+
+// evolves a .gol board that is too big for memory straight from disk
+//
+// the file is read band by band and every row is pushed through a chain of
+// depth rolling windows of three rows, one per generation in flight: as soon as
+// a window holds rows v-1, v and v+1 of generation g, row v of generation g+1 is
+// calculated and pushed into the next window. the last window writes its rows
+// band by band to the output, so one pass over the file advances depth generations
+// while only 3*depth rows are kept in memory.
+//
+// the board wraps around, so the first rows of every generation need the last
+// rows of the previous one. the pass therefore feeds the last depth rows of the
+// file first (virtual rows -depth..-1), then the whole file, and finally the first
+// depth rows again (virtual rows H..H+depth-1). the light cone of every window
+// shrinks by one row at each end, so exactly rows 0..H-1 reach the output.
+template <class T>
+class StreamEngine {
+public:
+	StreamEngine(const char* inFileName, const char* outFileName);
+
+	// evolves generations generations, advancing depth generations per pass
+	// intermediate passes are written next to the output file
+	bool run(const int generations, const int depth);
+
+	// rows that are read/written with one call
+	inline void setBandRows(const int rows) { mBandRows = rows < 1 ? 1 : rows; }
+	inline int getPasses() const { return mPasses; }
+
+private:
+	bool readHeader(std::ifstream& file);
+	bool runPass(const std::string& inFileName, const std::string& outFileName, const int depth);
+	// adds row v of generation stage to its window and calculates the next generation as far as possible
+	void push(const int stage, const int v, const T* row);
+	void writeRow(const T* row);
+	void flushOutput();
+
+	std::string mInFileName;
+	std::string mOutFileName;
+
+	// x/y dim of field
+	int mXDim;
+	int mYDim;
+
+	int mBandRows;
+	int mPasses;
+
+	// generations advanced by the current pass
+	int mDepth;
+	// three rows per generation in flight, row v lives in slot v mod 3
+	std::vector<std::vector<T> > mWindows;
+	// rows pushed into every window in the current pass
+	std::vector<int> mWindowRows;
+	// newly calculated row of every window
+	std::vector<std::vector<T> > mNextRows;
+
+	std::ofstream mOutputFile;
+	// output band, converted back to .gol characters
+	std::vector<char> mOutputBand;
+	int mOutputBandRows;
+};
+
+template <class T>
+StreamEngine<T>::StreamEngine(const char* inFileName, const char* outFileName) : mInFileName(inFileName), mOutFileName(outFileName),
+																				 mXDim(0), mYDim(0), mBandRows(256), mPasses(0),
+																				 mDepth(0), mOutputBandRows(0) {
+}
+
+template <class T>
+bool StreamEngine<T>::readHeader(std::ifstream& file) {
+	std::string line;
+	// get first line for information about x and y dim
+	std::getline(file,line);
+
+	std::stringstream ss;
+	size_t pos = line.find_first_of(',');
+	if(pos == std::string::npos) {
+		MessageBoxA(0,"Invalid header in input file","ERROR", MB_OK);
+		return false;
+	}
+
+	// store x dimension
+	ss.str(line.substr(0,pos));
+	ss >> mXDim;
+
+	// reset stringstream
+	ss.str("");
+	ss.clear();
+
+	// store y dimension
+	ss.str(line.substr(pos+1));
+	ss >> mYDim;
+
+	if(mXDim < 1 || mYDim < 1) {
+		MessageBoxA(0,"Invalid header in input file","ERROR", MB_OK);
+		return false;
+	}
+
+	return true;
+}
+
+template <class T>
+bool StreamEngine<T>::run(const int generations, const int depth) {
+	{
+		std::ifstream file(mInFileName.c_str(), std::ios::in|std::ios::binary);
+		if(!file.is_open()) {
+			MessageBoxA(0,"Could not load input file","ERROR", MB_OK);
+			return false;
+		}
+		if(!readHeader(file))
+			return false;
+	}
+
+	// a window deeper than the board would wrap around more than once
+	int perPass = depth < 1 ? 1 : depth;
+	if(perPass > mYDim)
+		perPass = mYDim;
+
+	mPasses = generations > 0 ? (generations+perPass-1)/perPass : 1;
+
+	const std::string tmpFileNames[2] = {mOutFileName + ".pass0", mOutFileName + ".pass1"};
+	int remaining = generations;
+
+	for(int pass=0;pass<mPasses;++pass) {
+		const int passDepth = remaining < perPass ? remaining : perPass;
+		const std::string& in = (pass == 0) ? mInFileName : tmpFileNames[(pass-1)%2];
+		const std::string& out = (pass == mPasses-1) ? mOutFileName : tmpFileNames[pass%2];
+
+		if(!runPass(in, out, passDepth))
+			return false;
+
+		remaining -= passDepth;
+	}
+
+	remove(tmpFileNames[0].c_str());
+	remove(tmpFileNames[1].c_str());
+
+	return true;
+}
+
+template <class T>
+bool StreamEngine<T>::runPass(const std::string& inFileName, const std::string& outFileName, const int depth) {
+	std::ifstream file(inFileName.c_str(), std::ios::in|std::ios::binary);
+	if(!file.is_open()) {
+		MessageBoxA(0,"Could not load input file","ERROR", MB_OK);
+		return false;
+	}
+	if(!readHeader(file))
+		return false;
+
+	const std::streamoff headerLength = file.tellg();
+
+	// every row is mXDim characters followed by \n or \r\n
+	std::string line;
+	std::getline(file,line);
+	if((int)line.length() < mXDim) {
+		MessageBoxA(0,"Input file has less columns than its header says","ERROR", MB_OK);
+		return false;
+	}
+	const int stride = (int)line.length()+1;
+
+	mDepth = depth;
+	mWindows.assign(depth, std::vector<T>(3*mXDim));
+	mWindowRows.assign(depth, 0);
+	mNextRows.assign(depth, std::vector<T>(mXDim));
+
+	mOutputFile.open(outFileName.c_str(), std::ios::out|std::ios::binary);
+	if(!mOutputFile.is_open()) {
+		MessageBoxA(0,"Could not open output file","ERROR", MB_OK);
+		return false;
+	}
+
+	char header[32];
+	_snprintf(header, sizeof(header), "%d,%d\n", mXDim, mYDim);
+	mOutputFile.write(header, strlen(header));
+
+	mOutputBand.resize(mBandRows*(mXDim+1));
+	mOutputBandRows = 0;
+
+	std::vector<char> band(mBandRows*stride);
+	std::vector<T> row(mXDim);
+	// first depth rows of the file, fed again after the last row
+	std::vector<T> head(depth*mXDim);
+
+	// the last depth rows come first since rows 0.. depend on them
+	if(depth > 0) {
+		file.clear();
+		file.seekg(headerLength + (std::streamoff)(mYDim-depth)*stride);
+		for(int i=0;i<depth;++i) {
+			file.read(&band[0], mXDim);
+			if(file.gcount() < mXDim) {
+				MessageBoxA(0,"Input file has less rows than its header says","ERROR", MB_OK);
+				return false;
+			}
+			// the last row may miss its line break
+			file.ignore(stride-mXDim);
+			file.clear();
+
+			if(!textToCells(&band[0], mXDim, &row[0])) {
+				MessageBoxA(0,"Input file contains characters other than x and .","ERROR", MB_OK);
+				return false;
+			}
+			push(0, i-depth, &row[0]);
+		}
+	}
+
+	file.clear();
+	file.seekg(headerLength);
+
+	for(int y=0;y<mYDim;y+=mBandRows) {
+		const int rows = (mYDim-y < mBandRows) ? mYDim-y : mBandRows;
+
+		file.read(&band[0], (std::streamsize)rows*stride);
+		// the last row may miss its line break
+		if(file.gcount() < (std::streamsize)(rows-1)*stride+mXDim) {
+			MessageBoxA(0,"Input file has less rows than its header says","ERROR", MB_OK);
+			return false;
+		}
+		file.clear();
+
+		for(int i=0;i<rows;++i) {
+			if(!textToCells(&band[i*stride], mXDim, &row[0])) {
+				MessageBoxA(0,"Input file contains characters other than x and .","ERROR", MB_OK);
+				return false;
+			}
+
+			if(y+i < depth)
+				memcpy(&head[(y+i)*mXDim], &row[0], sizeof(T)*mXDim);
+
+			push(0, y+i, &row[0]);
+		}
+	}
+
+	for(int i=0;i<depth;++i) {
+		push(0, mYDim+i, &head[i*mXDim]);
+	}
+
+	flushOutput();
+	mOutputFile.close();
+
+	return true;
+}
+
+template <class T>
+void StreamEngine<T>::push(const int stage, const int v, const T* row) {
+	// the last window is the output
+	if(stage == mDepth) {
+		writeRow(row);
+		return;
+	}
+
+	std::vector<T>& window = mWindows[stage];
+	memcpy(&window[(((v%3)+3)%3)*mXDim], row, sizeof(T)*mXDim);
+	mWindowRows[stage]++;
+
+	// rows v-2, v-1 and v are available, row v-1 of the next generation can be calculated
+	if(mWindowRows[stage] >= 3) {
+		const T* top = &window[((((v-2)%3)+3)%3)*mXDim];
+		const T* mid = &window[((((v-1)%3)+3)%3)*mXDim];
+		const T* bot = &window[(((v%3)+3)%3)*mXDim];
+
+		calcRowCells(top, mid, bot, &mNextRows[stage][0], mXDim);
+		push(stage+1, v-1, &mNextRows[stage][0]);
+	}
+}
+
+template <class T>
+void StreamEngine<T>::writeRow(const T* row) {
+	char* chars = &mOutputBand[mOutputBandRows*(mXDim+1)];
+	cellsToText(row, mXDim, chars);
+	chars[mXDim] = '\n';
+
+	if(++mOutputBandRows == mBandRows)
+		flushOutput();
+}
+
+template <class T>
+void StreamEngine<T>::flushOutput() {
+	if(mOutputBandRows > 0) {
+		mOutputFile.write(&mOutputBand[0], (std::streamsize)mOutputBandRows*(mXDim+1));
+		mOutputBandRows = 0;
+	}
+}
+
+#endif
@@ -0,0 +1,318 @@
+#ifndef __TRANSCODE_H
+#define __TRANSCODE_H
+
+#include <cstring>
+#include <stdint.h>
+
+#include "celltraits.h"
+
+// SSE2 is part of every x64 CPU, AVX2 is used if the compiler targets it (/arch:AVX2, -mavx2)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSCODE_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#define TRANSCODE_AVX2
+#include <immintrin.h>
+#endif
+
+// conversion of n cells between the 'x'/'.' text of .gol files, packed bits
+// (lsb first, (n+7)/8 bytes, the row format of .golb files) and cells of Gameoflife<T>
+//
+// text is compared against 'x' and '.' 16 (32 with AVX2) characters at a time and the
+// compare masks are turned into bits with movemask, bits are expanded back into bytes
+// with a broadcast, an and with the bit of every byte and a compare. the conversions
+// from text also check the characters on the way: they return false if the text
+// contains anything else than 'x' and '.' (the cells/bits are written anyway)
+//
+// countCells counts the living cells among n cells (state 1, the dying states of
+// multi-state boards do not count), 16 at a time with a sum of absolute differences
+// against zero
+//
+// uint8_t and char cells take the vector paths, every other cell type goes
+// through CellTraits one cell at a time
+
+namespace transcode {
+
+// expands the 16 bits lo, hi into 16 bytes of 0xFF (bit set) or 0x00
+#ifdef TRANSCODE_SSE2
+inline __m128i expandBits(const unsigned char lo, const unsigned char hi) {
+	const __m128i select = _mm_set_epi8((char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+										(char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+	const __m128i bytes = _mm_unpacklo_epi64(_mm_set1_epi8((char)lo), _mm_set1_epi8((char)hi));
+	return _mm_cmpeq_epi8(_mm_and_si128(bytes, select), select);
+}
+
+// 'x' where set is 0xFF, '.' everywhere else
+inline __m128i blendText(const __m128i set) {
+	return _mm_or_si128(_mm_and_si128(set, _mm_set1_epi8('x')), _mm_andnot_si128(set, _mm_set1_epi8('.')));
+}
+#endif
+
+} // namespace transcode
+
+inline bool textToBits(const char* text, const int n, unsigned char* bits) {
+	int i = 0;
+	int legal = 1;
+
+#if defined(TRANSCODE_AVX2)
+	const __m256i alive32 = _mm256_set1_epi8('x');
+	const __m256i dead32 = _mm256_set1_epi8('.');
+	for(;i+32<=n;i+=32) {
+		const __m256i v = _mm256_loadu_si256((const __m256i*)(text+i));
+		const unsigned x = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, alive32));
+		const unsigned d = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, dead32));
+		legal &= (x|d) == 0xFFFFFFFFu;
+		memcpy(bits+i/8, &x, 4);
+	}
+#endif
+#if defined(TRANSCODE_SSE2)
+	const __m128i alive16 = _mm_set1_epi8('x');
+	const __m128i dead16 = _mm_set1_epi8('.');
+	for(;i+16<=n;i+=16) {
+		const __m128i v = _mm_loadu_si128((const __m128i*)(text+i));
+		const unsigned x = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, alive16));
+		const unsigned d = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, dead16));
+		legal &= (x|d) == 0xFFFFu;
+		bits[i/8] = (unsigned char)x;
+		bits[i/8+1] = (unsigned char)(x >> 8);
+	}
+#endif
+
+	// the vector loops always stop at a byte boundary
+	if(i < n)
+		memset(bits+i/8, 0, ((size_t)n+7)/8-i/8);
+	for(;i<n;++i) {
+		const int x = text[i] == 'x';
+		legal &= x | (text[i] == '.');
+		bits[i>>3] |= (unsigned char)(x << (i&7));
+	}
+
+	return legal != 0;
+}
+
+inline void bitsToText(const unsigned char* bits, const int n, char* text) {
+	int i = 0;
+
+#if defined(TRANSCODE_SSE2)
+	for(;i+16<=n;i+=16) {
+		_mm_storeu_si128((__m128i*)(text+i), transcode::blendText(transcode::expandBits(bits[i/8], bits[i/8+1])));
+	}
+#endif
+
+	for(;i<n;++i) {
+		text[i] = ((bits[i>>3] >> (i&7)) & 1) ? 'x' : '.';
+	}
+}
+
+// any cell type
+template <class T>
+inline bool textToCells(const char* text, const int n, T* cells) {
+	int legal = 1;
+	for(int i=0;i<n;++i) {
+		legal &= (text[i] == 'x') | (text[i] == '.');
+		cells[i] = CellTraits<T>::fromChar(text[i]);
+	}
+	return legal != 0;
+}
+
+template <class T>
+inline void cellsToText(const T* cells, const int n, char* text) {
+	for(int i=0;i<n;++i) {
+		text[i] = CellTraits<T>::toChar(cells[i]);
+	}
+}
+
+template <class T>
+inline void cellsToBits(const T* cells, const int n, unsigned char* bits) {
+	memset(bits, 0, ((size_t)n+7)/8);
+	for(int i=0;i<n;++i) {
+		bits[i>>3] |= (unsigned char)(CellTraits<T>::alive(cells[i]) << (i&7));
+	}
+}
+
+template <class T>
+inline void bitsToCells(const unsigned char* bits, const int n, T* cells) {
+	const T alive = CellTraits<T>::fromChar('x');
+	const T dead = CellTraits<T>::fromChar('.');
+	for(int i=0;i<n;++i) {
+		cells[i] = ((bits[i>>3] >> (i&7)) & 1) ? alive : dead;
+	}
+}
+
+template <class T>
+inline int countCells(const T* cells, const int n) {
+	int count = 0;
+	for(int i=0;i<n;++i) {
+		count += CellTraits<T>::alive(cells[i]) != 0;
+	}
+	return count;
+}
+
+// numeric 0/1 cells
+inline bool textToCells(const char* text, const int n, uint8_t* cells) {
+	int i = 0;
+	int legal = 1;
+
+#if defined(TRANSCODE_AVX2)
+	const __m256i alive32 = _mm256_set1_epi8('x');
+	const __m256i dead32 = _mm256_set1_epi8('.');
+	const __m256i one32 = _mm256_set1_epi8(1);
+	__m256i valid32 = _mm256_set1_epi8(-1);
+	for(;i+32<=n;i+=32) {
+		const __m256i v = _mm256_loadu_si256((const __m256i*)(text+i));
+		const __m256i x = _mm256_cmpeq_epi8(v, alive32);
+		valid32 = _mm256_and_si256(valid32, _mm256_or_si256(x, _mm256_cmpeq_epi8(v, dead32)));
+		_mm256_storeu_si256((__m256i*)(cells+i), _mm256_and_si256(x, one32));
+	}
+	legal &= (unsigned)_mm256_movemask_epi8(valid32) == 0xFFFFFFFFu;
+#endif
+#if defined(TRANSCODE_SSE2)
+	const __m128i alive16 = _mm_set1_epi8('x');
+	const __m128i dead16 = _mm_set1_epi8('.');
+	const __m128i one16 = _mm_set1_epi8(1);
+	__m128i valid16 = _mm_set1_epi8(-1);
+	for(;i+16<=n;i+=16) {
+		const __m128i v = _mm_loadu_si128((const __m128i*)(text+i));
+		const __m128i x = _mm_cmpeq_epi8(v, alive16);
+		valid16 = _mm_and_si128(valid16, _mm_or_si128(x, _mm_cmpeq_epi8(v, dead16)));
+		_mm_storeu_si128((__m128i*)(cells+i), _mm_and_si128(x, one16));
+	}
+	legal &= _mm_movemask_epi8(valid16) == 0xFFFF;
+#endif
+
+	for(;i<n;++i) {
+		const int x = text[i] == 'x';
+		legal &= x | (text[i] == '.');
+		cells[i] = (uint8_t)x;
+	}
+
+	return legal != 0;
+}
+
+inline void cellsToText(const uint8_t* cells, const int n, char* text) {
+	int i = 0;
+
+#if defined(TRANSCODE_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	for(;i+16<=n;i+=16) {
+		const __m128i dead = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(cells+i)), zero);
+		_mm_storeu_si128((__m128i*)(text+i), transcode::blendText(_mm_xor_si128(dead, _mm_set1_epi8(-1))));
+	}
+#endif
+
+	for(;i<n;++i) {
+		text[i] = cells[i] ? 'x' : '.';
+	}
+}
+
+inline void cellsToBits(const uint8_t* cells, const int n, unsigned char* bits) {
+	int i = 0;
+
+#if defined(TRANSCODE_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	for(;i+16<=n;i+=16) {
+		const unsigned dead = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(cells+i)), zero));
+		bits[i/8] = (unsigned char)~dead;
+		bits[i/8+1] = (unsigned char)(~dead >> 8);
+	}
+#endif
+
+	if(i < n)
+		memset(bits+i/8, 0, ((size_t)n+7)/8-i/8);
+	for(;i<n;++i) {
+		bits[i>>3] |= (unsigned char)((cells[i] != 0) << (i&7));
+	}
+}
+
+inline void bitsToCells(const unsigned char* bits, const int n, uint8_t* cells) {
+	int i = 0;
+
+#if defined(TRANSCODE_SSE2)
+	const __m128i one = _mm_set1_epi8(1);
+	for(;i+16<=n;i+=16) {
+		_mm_storeu_si128((__m128i*)(cells+i), _mm_and_si128(transcode::expandBits(bits[i/8], bits[i/8+1]), one));
+	}
+#endif
+
+	for(;i<n;++i) {
+		cells[i] = (uint8_t)((bits[i>>3] >> (i&7)) & 1);
+	}
+}
+
+inline int countCells(const uint8_t* cells, const int n) {
+	int i = 0;
+	int count = 0;
+
+#if defined(TRANSCODE_SSE2)
+	// cells of multi-state boards can be above 1, those are dying and do not count
+	const __m128i one = _mm_set1_epi8(1);
+	const __m128i zero = _mm_setzero_si128();
+	__m128i sums = zero;
+	for(;i+16<=n;i+=16) {
+		const __m128i alive = _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(cells+i)), one), one);
+		sums = _mm_add_epi64(sums, _mm_sad_epu8(alive, zero));
+	}
+	count = _mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(sums, sums));
+#endif
+
+	for(;i<n;++i) {
+		count += cells[i] == 1;
+	}
+	return count;
+}
+
+// ASCII cells are the text itself, only the check is left
+inline bool textToCells(const char* text, const int n, char* cells) {
+	if(cells != text)
+		memcpy(cells, text, n);
+
+	int i = 0;
+	int legal = 1;
+
+#if defined(TRANSCODE_SSE2)
+	const __m128i alive16 = _mm_set1_epi8('x');
+	const __m128i dead16 = _mm_set1_epi8('.');
+	__m128i valid16 = _mm_set1_epi8(-1);
+	for(;i+16<=n;i+=16) {
+		const __m128i v = _mm_loadu_si128((const __m128i*)(text+i));
+		valid16 = _mm_and_si128(valid16, _mm_or_si128(_mm_cmpeq_epi8(v, alive16), _mm_cmpeq_epi8(v, dead16)));
+	}
+	legal &= _mm_movemask_epi8(valid16) == 0xFFFF;
+#endif
+
+	for(;i<n;++i) {
+		legal &= (text[i] == 'x') | (text[i] == '.');
+	}
+
+	return legal != 0;
+}
+
+inline void cellsToText(const char* cells, const int n, char* text) {
+	if(cells != text)
+		memcpy(text, cells, n);
+}
+
+inline int countCells(const char* cells, const int n) {
+	int i = 0;
+	int count = 0;
+
+#if defined(TRANSCODE_SSE2)
+	const __m128i one = _mm_set1_epi8(1);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i alive16 = _mm_set1_epi8('x');
+	__m128i sums = zero;
+	for(;i+16<=n;i+=16) {
+		const __m128i alive = _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(cells+i)), alive16), one);
+		sums = _mm_add_epi64(sums, _mm_sad_epu8(alive, zero));
+	}
+	count = _mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(sums, sums));
+#endif
+
+	for(;i<n;++i) {
+		count += cells[i] == 'x';
+	}
+	return count;
+}
+
+#endif
@@ -0,0 +1,310 @@
+#ifndef __VIEWER_H
+#define __VIEWER_H
+
+#include <stdint.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <omp.h>
+
+#include "generations.h"
+
+// older SDKs do not know the console flag yet
+#if defined(_WIN32) && !defined(ENABLE_VIRTUAL_TERMINAL_PROCESSING)
+#define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
+#endif
+
+// live view of an evolving board in the terminal
+//
+//   Viewer<uint8_t> viewer(x, y, zoom, cols, rows, fps);
+//   for(const BoardView<uint8_t>& board : gof.generations(OPENMP, 1000))
+//       viewer.offer(board);
+//   viewer.close(gof.view());
+//
+// every character shows zoom x zoom cells of the viewport that starts at cell x, y,
+// shaded by how many of them are alive. cols x rows characters are shown plus a status
+// line below them.
+//
+// the simulation only pays when the render thread asks for a frame, at most fps times
+// a second: offer then reduces the viewport into the back shade grid with OpenMP and
+// swaps it with the front one, every other generation it only checks a flag. the
+// render thread compares the front grid with the characters on the terminal and writes
+// the changed ones with ANSI cursor moves, one write per frame.
+template <class T>
+class Viewer {
+public:
+	Viewer(const int x, const int y, const int zoom, const int cols, const int rows, const int fps);
+	~Viewer();
+
+	// shows the board if the render thread waits for a frame
+	inline void offer(const BoardView<T>& board) {
+		mLastGeneration = board.getGeneration();
+		if(mWanted.load(std::memory_order_acquire))
+			publish(board);
+	}
+
+	// shows the board one last time and stops the render thread
+	void close(const BoardView<T>& board);
+
+private:
+	// chars from dead to fully alive
+	static const char* shades() { return " .:-=+*#%@"; }
+	static const int SHADES = 10;
+	// unchanged chars between two changed ones that are written anyway instead of a new cursor move
+	static const int GAP = 4;
+
+	void publish(const BoardView<T>& board);
+	// shade index of every char of the viewport into grid, returns the living cells
+	uint64_t reduce(const BoardView<T>& board, std::vector<uint8_t>& grid) const;
+	void renderLoop();
+	// ANSI text that turns the terminal into the front grid
+	void render(std::string& out);
+
+	int mX;
+	int mY;
+	int mZoom;
+	int mCols;
+	int mRows;
+	std::chrono::microseconds mFrameTime;
+
+	// written by publish, read by the render thread after a swap
+	std::vector<uint8_t> mFront;
+	std::vector<uint8_t> mBack;
+	int mFrontGeneration;
+	uint64_t mFrontPopulation;
+	// last generation offered, only used by the simulation
+	int mLastGeneration;
+
+	// chars on the terminal, 0 where nothing was written yet
+	std::vector<char> mScreen;
+	std::string mStatus;
+
+	std::atomic<bool> mWanted;
+	std::mutex mMutex;
+	std::condition_variable mSignal;
+	bool mFresh;
+	bool mStop;
+	// the render thread reads the front grid without the lock
+	bool mRendering;
+	std::thread mThread;
+
+	// frames and generations per second shown in the status line
+	std::chrono::steady_clock::time_point mRateTime;
+	int mRateFrames;
+	int mRateGeneration;
+	double mFps;
+	double mGenerationsPerSecond;
+};
+
+template <class T>
+Viewer<T>::Viewer(const int x, const int y, const int zoom, const int cols, const int rows, const int fps)
+	: mX(x < 0 ? 0 : x), mY(y < 0 ? 0 : y), mZoom(zoom < 1 ? 1 : zoom), mCols(cols < 1 ? 1 : cols), mRows(rows < 1 ? 1 : rows),
+	  mFrameTime(1000000/(fps < 1 ? 1 : fps)), mFrontGeneration(0), mFrontPopulation(0), mLastGeneration(0),
+	  mWanted(false), mFresh(false), mStop(false), mRendering(false), mRateFrames(0), mRateGeneration(0), mFps(0.0), mGenerationsPerSecond(0.0) {
+	mFront.assign((size_t)mCols*mRows, 0);
+	mBack.assign((size_t)mCols*mRows, 0);
+	mScreen.assign((size_t)mCols*mRows, 0);
+
+#ifdef _WIN32
+	// the console only understands the escape sequences if it is asked to
+	HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+	DWORD consoleMode = 0;
+	if(GetConsoleMode(console, &consoleMode))
+		SetConsoleMode(console, consoleMode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+#endif
+
+	// hide the cursor and start with an empty screen
+	fputs("\x1b[?25l\x1b[2J", stdout);
+	fflush(stdout);
+
+	mRateTime = std::chrono::steady_clock::now();
+	mThread = std::thread(&Viewer<T>::renderLoop, this);
+}
+
+template <class T>
+Viewer<T>::~Viewer() {
+	if(mThread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mStop = true;
+		}
+		mSignal.notify_all();
+		mThread.join();
+	}
+}
+
+template <class T>
+void Viewer<T>::publish(const BoardView<T>& board) {
+	// the render thread only reads the front grid, the back one is ours
+	const uint64_t population = reduce(board, mBack);
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mFront.swap(mBack);
+		mFrontGeneration = board.getGeneration();
+		mFrontPopulation = population;
+		mFresh = true;
+		mWanted.store(false, std::memory_order_relaxed);
+	}
+	mSignal.notify_all();
+}
+
+template <class T>
+void Viewer<T>::close(const BoardView<T>& board) {
+	if(!mThread.joinable())
+		return;
+
+	// the view of Gameoflife::view does not know the generation
+	const uint64_t population = reduce(board, mBack);
+	{
+		// unlike publish this does not wait for a request, so the last frame may still be drawn
+		std::unique_lock<std::mutex> lock(mMutex);
+		mSignal.wait(lock, [this]() { return !mRendering; });
+		mFront.swap(mBack);
+		mFrontGeneration = mLastGeneration;
+		mFrontPopulation = population;
+		mFresh = true;
+		mStop = true;
+	}
+	mSignal.notify_all();
+	mThread.join();
+
+	// cursor back below the view
+	printf("\x1b[%d;1H\x1b[?25h\n", mRows+2);
+	fflush(stdout);
+}
+
+template <class T>
+uint64_t Viewer<T>::reduce(const BoardView<T>& board, std::vector<uint8_t>& grid) const {
+	const int xDim = board.getXDim();
+	const int yDim = board.getYDim();
+	int64_t population = 0;
+
+	// every char row reads zoom board rows, the rows are independent
+	#pragma omp parallel for schedule(dynamic) reduction(+:population)
+	for(int r=0;r<mRows;++r) {
+		std::vector<int> counts(mCols, 0);
+		uint8_t* shadeRow = &grid[(size_t)r*mCols];
+
+		const int y0 = mY+r*mZoom;
+		const int y1 = y0+mZoom < yDim ? y0+mZoom : yDim;
+		const int x1 = mX+mCols*mZoom < xDim ? mX+mCols*mZoom : xDim;
+		for(int y=y0;y<y1;++y) {
+			const T* row = board.row(y);
+			for(int c=0,x=mX;x<x1;++c,x+=mZoom) {
+				counts[c] += countCells(row+x, x+mZoom < x1 ? mZoom : x1-x);
+			}
+		}
+
+		// chars outside of the board stay blank
+		const int height = y1 > y0 ? y1-y0 : 0;
+		for(int c=0;c<mCols;++c) {
+			const int x0 = mX+c*mZoom;
+			const int width = x0 < x1 ? (x0+mZoom < x1 ? mZoom : x1-x0) : 0;
+			const int area = height*width;
+			// any living cell shows, only a full block gets the last shade
+			shadeRow[c] = area > 0 ? (uint8_t)((counts[c]*(SHADES-1)+area-1)/area) : 0;
+			population += counts[c];
+		}
+	}
+
+	return (uint64_t)population;
+}
+
+template <class T>
+void Viewer<T>::renderLoop() {
+	std::string out;
+	std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+
+	std::unique_lock<std::mutex> lock(mMutex);
+	while(true) {
+		// a frame is asked for once the last one is due
+		mSignal.wait_until(lock, next, [this]() { return mStop; });
+		if(!mStop)
+			mWanted.store(true, std::memory_order_release);
+		mSignal.wait(lock, [this]() { return mFresh || mStop; });
+
+		if(mFresh) {
+			mFresh = false;
+			mRendering = true;
+			// publish only touches the front grid after the next request
+			lock.unlock();
+			out.clear();
+			render(out);
+			fwrite(out.data(), 1, out.size(), stdout);
+			fflush(stdout);
+			lock.lock();
+			mRendering = false;
+			mSignal.notify_all();
+		}
+
+		if(mStop && !mFresh)
+			break;
+
+		next += mFrameTime;
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		// a slow simulation does not make the following frames come faster
+		if(next < now)
+			next = now;
+	}
+}
+
+template <class T>
+void Viewer<T>::render(std::string& out) {
+	char buffer[160];
+
+	for(int r=0;r<mRows;++r) {
+		const uint8_t* shadeRow = &mFront[(size_t)r*mCols];
+		char* screenRow = &mScreen[(size_t)r*mCols];
+
+		int c = 0;
+		while(c < mCols) {
+			if(screenRow[c] == shades()[shadeRow[c]]) {
+				++c;
+				continue;
+			}
+
+			// a run of changed chars, short gaps of unchanged ones are cheaper to write than a cursor move
+			const int start = c;
+			int end = c+1;
+			for(++c;c<mCols && c-end <= GAP;++c) {
+				if(screenRow[c] != shades()[shadeRow[c]])
+					end = c+1;
+			}
+			c = end;
+
+			sprintf(buffer, "\x1b[%d;%dH", r+1, start+1);
+			out += buffer;
+			for(int i=start;i<end;++i) {
+				screenRow[i] = shades()[shadeRow[i]];
+			}
+			out.append(screenRow+start, end-start);
+		}
+	}
+
+	const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	const double elapsed = std::chrono::duration<double>(now-mRateTime).count();
+	++mRateFrames;
+	if(elapsed >= 1.0) {
+		mFps = mRateFrames/elapsed;
+		mGenerationsPerSecond = (mFrontGeneration-mRateGeneration)/elapsed;
+		mRateFrames = 0;
+		mRateGeneration = mFrontGeneration;
+		mRateTime = now;
+	}
+
+	sprintf(buffer, "generation %d  population %llu  viewport %d,%d zoom %d  %.0f fps  %.0f generations/s",
+			mFrontGeneration, (unsigned long long)mFrontPopulation, mX, mY, mZoom, mFps, mGenerationsPerSecond);
+	if(mStatus != buffer) {
+		mStatus = buffer;
+		sprintf(buffer, "\x1b[%d;1H\x1b[K", mRows+1);
+		out += buffer;
+		out += mStatus;
+	}
+}
+
+#endif
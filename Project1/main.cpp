@@ -1,12 +1,73 @@
 #include "./includes/gameoflife.h"
+#include "./includes/batch.h"
+#include "./includes/streamengine.h"
+#include "./includes/BoardGenerator.h"
+#include "./includes/daemon.h"
+#include "./includes/autotuner.h"
+#include "./includes/fuzzer.h"
+#include "./includes/viewer.h"
 #include "./includes/Timer.h"
 
 int main(int argc, char** argv) {
 	char* fInFName = 0;
 	char* fOutFName = 0;
 	char* fileToCompare = 0;
+	char* fBatchFName = 0;
+	char* fStatsFName = 0;
+	char* ltlRule = 0;
+	char* statesRule = 0;
+	Mode mode = OPENCL;
 	int generations = 0;
 	int nthreads = 1;
+	bool threadsGiven = false;
+	int streamDepth = 0;
+	int tileRows = 0;
+	int tileCols = 0;
+	// width, height, density and seed of a board to generate
+	int genXDim = 0;
+	int genYDim = 0;
+	double genDensity = 0.0;
+	unsigned long long genSeed = 0;
+	// history file to record into or to seek in
+	char* fHistoryFName = 0;
+	int historyKeyframes = 0;
+	int seekGeneration = -1;
+	// socket of the resident daemon to start or to send the job to
+	char* fDaemonSocket = 0;
+	char* fClientSocket = 0;
+	bool sendInline = false;
+	bool shutdownDaemon = false;
+	// tuned parameters of this machine, see TuningProfile.h
+	const char* fProfileFName = "gol.profile";
+	bool autotune = false;
+	// live metrics in the Prometheus text format, see Metrics.h
+	char* fMetricsFName = 0;
+	char* fMetricsSocket = 0;
+	int metricsInterval = 1000;
+	// random cases the engines are compared on, boards up to fuzzSize cells wide and high
+	int fuzzCases = 0;
+	int fuzzSize = 96;
+	unsigned long long fuzzSeed = 1;
+	bool fuzzOpenCL = false;
+	// terminal view of the evolving board, see viewer.h, off while viewZoom is 0
+	int viewX = 0;
+	int viewY = 0;
+	int viewZoom = 0;
+	int viewCols = 80;
+	int viewRows = 22;
+	int viewFps = 30;
+	// only the window at windowX, windowY of the last generation is calculated and saved
+	int windowX = 0;
+	int windowY = 0;
+	int windowWidth = 0;
+	int windowHeight = 0;
+	// standard board sizes use the engine with compile-time dimensions, see fixedboard.h
+	bool fixedDims = true;
+	// checkpoints of the run and the checkpoint a run goes on from, see checkpoint.h
+	char* fCheckpointFName = 0;
+	int checkpointGenerations = 0;
+	double checkpointSeconds = 0.0;
+	char* fResumeFName = 0;
 	bool measure = false;
 
 	Timer t;
@@ -14,6 +75,7 @@ int main(int argc, char** argv) {
 	for(int i=0;i<argc;++i) {
 		
 		// input file game field
+		// .rle and .lif/.life are read as RLE and Life 1.06 patterns, the same goes for --save
 		if(strcmp(argv[i], "--load") == 0) {
 			if(argv[i+1]) {
 				fInFName = argv[i+1];
@@ -46,31 +108,372 @@ int main(int argc, char** argv) {
 			}
 		}
 
+		// manifest with input/output file pairs for batch mode
+		else if(strcmp(argv[i], "--batch") == 0) {
+			if(argv[i+1]) {
+				fBatchFName = argv[i+1];
+			}
+			else {
+				MessageBoxA(0,"You specified no manifest for --batch", "ERROR", MB_OK);
+				return -1;
+			}
+		}
+
+		// [optional] population, births and deaths of every generation
+		else if(strcmp(argv[i], "--stats") == 0) {
+			if(argv[i+1]) {
+				fStatsFName = argv[i+1];
+			}
+			else {
+				MessageBoxA(0,"You specified no filename for --stats", "ERROR", MB_OK);
+				return -1;
+			}
+		}
+
+		// [optional] Larger than Life rule like R5,C0,M1,S34..58,B34..45,NM instead of B3/S23
+		else if(strcmp(argv[i], "--ltl") == 0) {
+			if(argv[i+1]) {
+				ltlRule = argv[i+1];
+			}
+			else {
+				MessageBoxA(0,"You specified no rule for --ltl", "ERROR", MB_OK);
+				return -1;
+			}
+		}
+
+		// [optional] multi-state Generations rule like B2/S/C3 or brain instead of B3/S23
+		else if(strcmp(argv[i], "--states") == 0) {
+			if(argv[i+1]) {
+				statesRule = argv[i+1];
+			}
+			else {
+				MessageBoxA(0,"You specified no rule for --states", "ERROR", MB_OK);
+				return -1;
+			}
+		}
+
+		// [optional] evolve the board from disk, advancing the given number of generations per pass
+		else if(strcmp(argv[i], "--stream") == 0) {
+			if(argv[i+1]) {
+				streamDepth = atoi(argv[i+1]);
+			}
+			else {
+				MessageBoxA(0,"You specified no depth for --stream", "ERROR", MB_OK);
+				return -1;
+			}
+		}
+
+		// [optional] tile size of the tiled engine
+		else if(strcmp(argv[i], "--tile") == 0) {
+			if(argv[i+1] && argv[i+2]) {
+				tileRows = atoi(argv[i+1]);
+				tileCols = atoi(argv[i+2]);
+			}
+			else {
+				MessageBoxA(0,"You specified no rows and columns for --tile", "ERROR", MB_OK);
+				return -1;
+			}
+		}
+
+		// search the fastest parameters for the --load board and store them in the profile
+		else if(strcmp(argv[i], "--autotune") == 0) {
+			autotune = true;
+		}
+
+		// [optional] profile file, gol.profile in the working directory otherwise
+		else if(strcmp(argv[i], "--profile") == 0) {
+			if(argv[i+1]) {
+				fProfileFName = argv[i+1];
+			}
+			else {
+				MessageBoxA(0,"You specified no filename for --profile", "ERROR", MB_OK);
+				return -1;
+			}
+		}
+
+		// [optional] file the metrics are written to every --metrics-interval milliseconds
+		else if(strcmp(argv[i], "--metrics") == 0) {
+			if(argv[i+1]) {
+				fMetricsFName = argv[i+1];
+			}
+			else {
+				MessageBoxA(0,"You specified no filename for --metrics", "ERROR", MB_OK);
+				return -1;
+			}
+		}
+
+		else if(strcmp(argv[i], "--metrics-interval") == 0) {
+			if(argv[i+1]) {
+				metricsInterval = atoi(argv[i+1]);
+			}
+			else {
+				MessageBoxA(0,"You specified no milliseconds for --metrics-interval", "ERROR", MB_OK);
+				return -1;
+			}
+		}
+
+		// [optional] local socket that answers every connection with the metrics
+		else if(strcmp(argv[i], "--metrics-socket") == 0) {
+			if(argv[i+1]) {
+				fMetricsSocket = argv[i+1];
+			}
+			else {
+				MessageBoxA(0,"You specified no socket for --metrics-socket", "ERROR", MB_OK);
+				return -1;
+			}
+		}
+
+		// [optional] save only the width x height window at x, y of the last generation,
+		// only the cells the window depends on are calculated (see lightcone.h)
+		else if(strcmp(argv[i], "--window") == 0) {
+			if(i+4 < argc) {
+				windowX = atoi(argv[i+1]);
+				windowY = atoi(argv[i+2]);
+				windowWidth = atoi(argv[i+3]);
+				windowHeight = atoi(argv[i+4]);
+			}
+			if(windowWidth < 1 || windowHeight < 1) {
+				MessageBoxA(0,"--window needs <x> <y> <width> <height>", "ERROR", MB_OK);
+				return -1;
+			}
+		}
+
+		// [optional] always use the dynamic engine, for comparisons
+		else if(strcmp(argv[i], "--no-fixed") == 0) {
+			fixedDims = false;
+		}
+
+		// [optional] write a checkpoint every n generations and/or every t seconds (0 switches
+		// either off), a background thread writes them so the run does not wait for the disk
+		else if(strcmp(argv[i], "--checkpoint") == 0) {
+			if(i+3 < argc) {
+				fCheckpointFName = argv[i+1];
+				checkpointGenerations = atoi(argv[i+2]);
+				checkpointSeconds = atof(argv[i+3]);
+			}
+			if(!fCheckpointFName || (checkpointGenerations < 1 && checkpointSeconds <= 0.0)) {
+				MessageBoxA(0,"--checkpoint needs <file> <every n generations> <every t seconds>", "ERROR", MB_OK);
+				return -1;
+			}
+		}
+
+		// [optional] go on with the run of the latest complete checkpoint instead of --load
+		// board, generation, mode, rule and engine settings come from the checkpoint, the
+		// following checkpoints go to the same file unless --checkpoint is given
+		else if(strcmp(argv[i], "--resume") == 0) {
+			if(argv[i+1]) {
+				fResumeFName = argv[i+1];
+			}
+			else {
+				MessageBoxA(0,"You specified no checkpoint for --resume", "ERROR", MB_OK);
+				return -1;
+			}
+		}
+
 		else if(strcmp(argv[i], "--measure") == 0) {
 			measure = true;
 		}
 
+		// compare every engine against seq on random boards, see fuzzer.h
+		else if(strcmp(argv[i], "--fuzz") == 0) {
+			if(argv[i+1]) {
+				fuzzCases = atoi(argv[i+1]);
+			}
+			if(fuzzCases < 1) {
+				MessageBoxA(0,"--fuzz needs the number of cases", "ERROR", MB_OK);
+				return -1;
+			}
+		}
+
+		// [optional] seed and largest board dimension of the fuzzer
+		else if(strcmp(argv[i], "--fuzz-seed") == 0) {
+			if(argv[i+1]) {
+				fuzzSeed = strtoull(argv[i+1], 0, 10);
+			}
+			else {
+				MessageBoxA(0,"You specified no seed for --fuzz-seed", "ERROR", MB_OK);
+				return -1;
+			}
+		}
+
+		else if(strcmp(argv[i], "--fuzz-size") == 0) {
+			if(argv[i+1]) {
+				fuzzSize = atoi(argv[i+1]);
+			}
+			else {
+				MessageBoxA(0,"You specified no size for --fuzz-size", "ERROR", MB_OK);
+				return -1;
+			}
+		}
+
+		// [optional] fuzz the OpenCL engine as well
+		else if(strcmp(argv[i], "--fuzz-ocl") == 0) {
+			fuzzOpenCL = true;
+		}
+
+		// [optional] show the board in the terminal while it evolves, every character
+		// shows zoom x zoom cells of the viewport starting at cell x, y
+		else if(strcmp(argv[i], "--view") == 0) {
+			if(i+3 < argc) {
+				viewX = atoi(argv[i+1]);
+				viewY = atoi(argv[i+2]);
+				viewZoom = atoi(argv[i+3]);
+			}
+			if(viewZoom < 1) {
+				MessageBoxA(0,"--view needs <x> <y> <zoom>", "ERROR", MB_OK);
+				return -1;
+			}
+		}
+
+		// [optional] characters of the view, 80 x 22 otherwise
+		else if(strcmp(argv[i], "--view-size") == 0) {
+			if(argv[i+1] && argv[i+2]) {
+				viewCols = atoi(argv[i+1]);
+				viewRows = atoi(argv[i+2]);
+			}
+			else {
+				MessageBoxA(0,"You specified no columns and rows for --view-size", "ERROR", MB_OK);
+				return -1;
+			}
+		}
+
+		// [optional] frames per second of the view, 30 otherwise
+		else if(strcmp(argv[i], "--view-fps") == 0) {
+			if(argv[i+1]) {
+				viewFps = atoi(argv[i+1]);
+			}
+			else {
+				MessageBoxA(0,"You specified no frame rate for --view-fps", "ERROR", MB_OK);
+				return -1;
+			}
+		}
+
+		// generate a random board into the --save file instead of evolving one
+		else if(strcmp(argv[i], "--generate") == 0) {
+			if(i+4 < argc) {
+				genXDim = atoi(argv[i+1]);
+				genYDim = atoi(argv[i+2]);
+				genDensity = atof(argv[i+3]);
+				genSeed = strtoull(argv[i+4], 0, 10);
+			}
+			if(genXDim < 1 || genYDim < 1 || genDensity < 0.0 || genDensity > 1.0) {
+				MessageBoxA(0,"--generate needs <width> <height> <density 0..1> <seed>", "ERROR", MB_OK);
+				return -1;
+			}
+		}
+
+		// [optional] record every generation into a history file with a keyframe every n generations
+		else if(strcmp(argv[i], "--history") == 0) {
+			if(i+2 < argc) {
+				fHistoryFName = argv[i+1];
+				historyKeyframes = atoi(argv[i+2]);
+			}
+			if(historyKeyframes < 1) {
+				MessageBoxA(0,"--history needs <file> <keyframe interval>", "ERROR", MB_OK);
+				return -1;
+			}
+		}
+
+		// save a generation of a history file instead of evolving a board
+		else if(strcmp(argv[i], "--seek") == 0) {
+			if(i+2 < argc) {
+				fHistoryFName = argv[i+1];
+				seekGeneration = atoi(argv[i+2]);
+			}
+			if(seekGeneration < 0) {
+				MessageBoxA(0,"--seek needs <history file> <generation>", "ERROR", MB_OK);
+				return -1;
+			}
+		}
+
+		// run as resident daemon on a local socket, see daemon.h
+		else if(strcmp(argv[i], "--daemon") == 0) {
+			if(argv[i+1]) {
+				fDaemonSocket = argv[i+1];
+			}
+			else {
+				MessageBoxA(0,"You specified no socket for --daemon", "ERROR", MB_OK);
+				return -1;
+			}
+		}
+
+		// send the job to a running daemon instead of running it here
+		else if(strcmp(argv[i], "--client") == 0) {
+			if(argv[i+1]) {
+				fClientSocket = argv[i+1];
+			}
+			else {
+				MessageBoxA(0,"You specified no socket for --client", "ERROR", MB_OK);
+				return -1;
+			}
+		}
+
+		// [optional] --client sends the board over the socket instead of the file names
+		else if(strcmp(argv[i], "--inline") == 0) {
+			sendInline = true;
+		}
+
+		// --client stops the daemon
+		else if(strcmp(argv[i], "--shutdown") == 0) {
+			shutdownDaemon = true;
+		}
+
+		// [optional] back big boards with huge pages if the system allows it
+		else if(strcmp(argv[i], "--hugepages") == 0) {
+			GridAllocator::instance().setHugePages(true);
+		}
+
 		// check for mode to run
 		else if(strcmp(argv[i], "--mode") == 0) {
-			
-			// OpenMP Mode selected
-			if(strcmp(argv[i+1], "omp") == 0) {
-				
-				if(strcmp(argv[i+2], "--threads") == 0) {
-					nthreads = atoi(argv[i+3]);
+			if(i+1 >= argc) {
+				MessageBoxA(0,"You specified no name for --mode", "ERROR", MB_OK);
+				return -1;
+			}
 
-					if(nthreads < 1 || nthreads > 16) {
-						MessageBoxA(0,"Threadnumber may not be bellow 1 or above 16", "ERROR", MB_OK);
-						return -1;
-					}
+			// the engines with threads may be followed by --threads <n>
+			bool threaded = false;
 
-				}
+			// OpenMP Mode selected
+			if(strcmp(argv[i+1], "omp") == 0) {
+				mode = OPENMP;
+				threaded = true;
+			}
+			// OpenMP without barriers between generations
+			else if(strcmp(argv[i+1], "wave") == 0) {
+				mode = WAVEFRONT;
+				threaded = true;
+			}
+			// tiles on the work-stealing scheduler
+			else if(strcmp(argv[i+1], "tiles") == 0) {
+				mode = TILED;
+				threaded = true;
+			}
+			// in place, without the second board
+			else if(strcmp(argv[i+1], "inplace") == 0) {
+				mode = INPLACE;
+				threaded = true;
 			}
 			if(strcmp(argv[i+1], "ocl") == 0) {
+				mode = OPENCL;
 				OutputDebugStringA("OpenCL mode\n");
 			}
 			else if(strcmp(argv[i+1], "seq") == 0) {
 				// nothing to do in here, the programs just runs with one thread
+				mode = SEQ;
+			}
+
+			if(threaded && i+2 < argc && strcmp(argv[i+2], "--threads") == 0) {
+				if(i+3 >= argc) {
+					MessageBoxA(0,"You specified no count for --threads", "ERROR", MB_OK);
+					return -1;
+				}
+				nthreads = atoi(argv[i+3]);
+				threadsGiven = true;
+
+				if(nthreads < 1 || nthreads > 16) {
+					MessageBoxA(0,"Threadnumber may not be bellow 1 or above 16", "ERROR", MB_OK);
+					return -1;
+				}
 			}
 		}
 
@@ -87,58 +490,370 @@ int main(int argc, char** argv) {
 
 	}
 
-	if(!fInFName) {
+	if(generations == 0) 
+		generations = 250;
+
+	// the OpenMP engine always ran four threads unless told otherwise
+	if(mode == OPENMP && !threadsGiven)
+		nthreads = 4;
+
+	// every mode below reports into the same metrics, they stop when the process ends
+	if(fMetricsFName && !Metrics::instance().openFile(fMetricsFName, metricsInterval)) {
+		MessageBoxA(0,"Could not write metrics file", "ERROR", MB_OK);
+		return -1;
+	}
+	if(fMetricsSocket && !Metrics::instance().openSocket(fMetricsSocket)) {
+		MessageBoxA(0,"Could not open metrics socket", "ERROR", MB_OK);
+		return -1;
+	}
+
+	// the fuzzer makes up its own boards
+	if(fuzzCases > 0) {
+		Fuzzer<uint8_t> fuzzer(fuzzSeed, fuzzSize);
+		fuzzer.setOpenCL(fuzzOpenCL);
+		fuzzer.setVerbose(measure);
+
+		t.start();
+		const int failed = fuzzer.run(fuzzCases);
+		t.stop();
+
+		std::cout << failed << " of " << fuzzCases << " cases failed" << std::endl;
+		if(measure)
+			std::cout << "fuzz time in seconds " << t.getElapsedTimeInSec() << ";" << std::endl;
+
+		return failed == 0 ? 0 : -1;
+	}
+
+	// generator mode writes the board and does not wait for input either
+	if(genXDim > 0) {
+		if(!fOutFName) {
+			MessageBoxA(0,"You specified no output filename", "ERROR", MB_OK);
+			return -1;
+		}
+
+		BoardGenerator generator(genXDim, genYDim, genDensity, genSeed);
+		// same file for every thread count, --threads only changes the speed
+		generator.setThreadCount(nthreads > 1 ? nthreads : 0);
+
+		t.start();
+		bool ok = generator.write(fOutFName);
+		t.stop();
+
+		if(!ok) {
+			MessageBoxA(0,"Could not write generated board (only .gol and .golb are supported)", "ERROR", MB_OK);
+			return -1;
+		}
+
+		if(measure)
+			std::cout << "generate time in seconds " << t.getElapsedTimeInSec() << ";" << std::endl;
+
+		return 0;
+	}
+
+	// the daemon keeps running until a client sends --shutdown
+	if(fDaemonSocket) {
+		Daemon<uint8_t> daemon(fDaemonSocket, nthreads > 1 ? nthreads : 4);
+		if(!daemon.run()) {
+			MessageBoxA(0,"Could not open daemon socket", "ERROR", MB_OK);
+			return -1;
+		}
+
+		std::cout << daemon.getJobsDone() << " jobs done" << std::endl;
+		return 0;
+	}
+
+	if(fClientSocket) {
+		DaemonClient client(fClientSocket);
+		bool ok;
+
+		if(shutdownDaemon) {
+			ok = client.shutdown();
+		}
+		else if(!fInFName || !fOutFName) {
+			MessageBoxA(0,"--client needs --load and --save", "ERROR", MB_OK);
+			return -1;
+		}
+		else {
+			t.start();
+			ok = client.runJob(fInFName, fOutFName, sendInline, generations, mode, nthreads);
+			t.stop();
+		}
+
+		std::cout << client.getReply() << std::endl;
+		if(measure && !shutdownDaemon)
+			std::cout << "job time in seconds " << t.getElapsedTimeInSec() << ";" << std::endl;
+
+		return ok ? 0 : -1;
+	}
+
+	// seeking only replays the history file
+	if(seekGeneration >= 0) {
+		if(!fOutFName) {
+			MessageBoxA(0,"You specified no output filename", "ERROR", MB_OK);
+			return -1;
+		}
+
+		Gameoflife<uint8_t> board;
+		t.start();
+		bool ok = board.loadHistory(fHistoryFName, seekGeneration) && board.saveFile(fOutFName);
+		t.stop();
+
+		if(measure)
+			std::cout << "seek time in seconds " << t.getElapsedTimeInSec() << ";" << std::endl;
+
+		return ok ? 0 : -1;
+	}
+
+	// batch mode evolves every board of the manifest and does not wait for input
+	if(fBatchFName) {
+		Batch<uint8_t> batch(fBatchFName);
+		int done = batch.run(mode, generations, nthreads);
+
+		std::cout << done << " of " << batch.getJobCount() << " boards done" << std::endl;
+		if(measure)
+			std::cout << "boards per second " << batch.getBoardsPerSecond() << ";" << std::endl;
+
+		return (done == batch.getJobCount()) ? 0 : -1;
+	}
+
+	// a resumed run takes its board from the checkpoint
+	if(!fInFName && (!fResumeFName || autotune || streamDepth > 0)) {
 		MessageBoxA(0,"You specified no input filename", "ERROR", MB_OK);
 		return -1;
 	}
 
+	TuningProfile profile;
+	const bool haveProfile = profile.load(fProfileFName);
+
+	// tuning only needs the board, nothing is saved but the profile
+	if(autotune) {
+		Gameoflife<uint8_t> board;
+		const bool withOpenCL = (mode == OPENCL);
+		if(withOpenCL ? !board.openCL_initAsync(fInFName) : !board.loadFile(fInFName))
+			return -1;
+
+		const int hardwareThreads = (int)std::thread::hardware_concurrency();
+		const int maxThreads = threadsGiven ? nthreads : (hardwareThreads < 1 ? 1 : (hardwareThreads > 16 ? 16 : hardwareThreads));
+
+		Autotuner<uint8_t> tuner(board);
+		tuner.setVerbose(measure);
+		tuner.tune(profile, maxThreads, withOpenCL);
+
+		if(!profile.save(fProfileFName)) {
+			MessageBoxA(0,"Could not save profile", "ERROR", MB_OK);
+			return -1;
+		}
+
+		std::cout << "profile " << fProfileFName << " has " << profile.getEntryCount() << " entries" << std::endl;
+		return 0;
+	}
+
 	if(!fOutFName) {
 		MessageBoxA(0,"You specified no output filename", "ERROR", MB_OK);
 		return -1;
 	}
 
-	if(generations == 0) 
-		generations = 250;
+	// out-of-core mode never holds the whole board in memory
+	if(streamDepth > 0) {
+		// the bands are calculated with B3/S23 only
+		if(ltlRule) {
+			MessageBoxA(0,"--stream does not support --ltl", "ERROR", MB_OK);
+			return -1;
+		}
+		if(statesRule) {
+			MessageBoxA(0,"--stream does not support --states", "ERROR", MB_OK);
+			return -1;
+		}
+
+		StreamEngine<uint8_t> engine(fInFName, fOutFName);
 
+		t.start();
+		bool ok = engine.run(generations, streamDepth);
+		t.stop();
 
+		if(measure)
+			std::cout << "stream time in seconds " << t.getElapsedTimeInSec() << " (" << engine.getPasses() << " passes);" << std::endl;
+
+		return ok ? 0 : -1;
+	}
+
+	// time to first generation counts from here, so it includes loading and setup
+	const std::chrono::steady_clock::time_point startup = std::chrono::steady_clock::now();
 
 	t.start();
-	Gameoflife<char>* gof = new Gameoflife<char>(fInFName);
+	// cells are stored as numeric 0/1, ASCII only exists in the files
+	// in OpenCL mode the board is loaded while the device is set up, see openCL_initAsync
+	Gameoflife<uint8_t>* gof = new Gameoflife<uint8_t>();
+	if(fResumeFName) {
+		Checkpoint resumed;
+		if(!gof->loadCheckpoint(fResumeFName, resumed)) {
+			delete gof;
+			return -1;
+		}
+
+		// the run goes on where the checkpoint left it, with the same engine
+		mode = (Mode)resumed.mode;
+		nthreads = resumed.threads;
+		threadsGiven = true;
+		generations = (int)(resumed.generations-resumed.generation);
+		if(!fCheckpointFName) {
+			fCheckpointFName = fResumeFName;
+			checkpointGenerations = resumed.everyGenerations;
+			checkpointSeconds = resumed.everySeconds;
+		}
+	}
+	else if(mode != OPENCL && !gof->loadFile(fInFName)) {
+		delete gof;
+		return -1;
+	}
 	t.stop();
 
+	// the rule has to be known before the OpenCL buffers are created
+	if(ltlRule && !gof->setRule(ltlRule)) {
+		MessageBoxA(0,"Invalid Larger than Life rule", "ERROR", MB_OK);
+		return -1;
+	}
+	if(statesRule && !gof->setStates(statesRule)) {
+		MessageBoxA(0,"Invalid multi-state rule or board has more states than the rule", "ERROR", MB_OK);
+		return -1;
+	}
+	if(gof->getMaxState() > 1 && !gof->getStates().isSet()) {
+		MessageBoxA(0,"Board has more than two states, it needs --states", "ERROR", MB_OK);
+		return -1;
+	}
 
+	if(fStatsFName && !gof->openStatistics(fStatsFName)) {
+		MessageBoxA(0,"Could not open statistics file", "ERROR", MB_OK);
+		return -1;
+	}
 
-	gof->openCL_initPlatforms();
-	gof->openCL_initDevices();
+	// only evolve (seq/omp) knows where one generation ends
+	if(fHistoryFName) {
+		if(mode != SEQ && mode != OPENMP) {
+			MessageBoxA(0,"--history needs --mode seq or omp", "ERROR", MB_OK);
+			return -1;
+		}
+		// history frames are bit packed
+		if(gof->getStates().isSet()) {
+			MessageBoxA(0,"--history does not support --states", "ERROR", MB_OK);
+			return -1;
+		}
+		if(!gof->openHistory(fHistoryFName, historyKeyframes)) {
+			MessageBoxA(0,"Could not open history file", "ERROR", MB_OK);
+			return -1;
+		}
+	}
 
-	gof->openCL_initContext();
-	gof->openCL_initCommandQueue();
-	gof->openCL_initMem();
-	gof->openCL_initProgram();
-	gof->openCL_initKernel();
 
-	t.start();
-	gof->openCL_run(250);
-	t.stop();
 
-	if(measure)
-		std::cout << "OpenCLKernel execution time in seconds " << t.getElapsedTimeInSec() << ";" << std::endl;
+	// the view needs the board in host memory every frame
+	if(viewZoom > 0 && mode == OPENCL) {
+		MessageBoxA(0,"--view needs a CPU engine", "ERROR", MB_OK);
+		return -1;
+	}
+	// the light cone skips most of the board, there are no whole generations to show or record
+	if(windowWidth > 0 && (mode == OPENCL || viewZoom > 0 || fHistoryFName)) {
+		MessageBoxA(0,"--window needs a CPU engine and does not work with --view or --history", "ERROR", MB_OK);
+		return -1;
+	}
+	// checkpoints are taken by evolve between two whole generations
+	if(fCheckpointFName && (mode == OPENCL || viewZoom > 0 || windowWidth > 0)) {
+		MessageBoxA(0,"--checkpoint and --resume need a CPU engine and do not work with --view or --window", "ERROR", MB_OK);
+		return -1;
+	}
 
-	//if(measure)
-	//	std::cout << "init time in seconds " << t.getElapsedTimeInSec() << ";" << std::endl;
+	if(mode == OPENCL) {
+		t.start();
+		bool loaded = gof->openCL_initAsync(fInFName, haveProfile ? &profile : 0);
+		t.stop();
 
-	//t.start();
-	//for(int i=0;i<generations;++i) {
-	//	/*std::cout << gof;
-	//	system("cls");
-	//	*/
-	//	gof->calcGenerationOpenMP();
-	//}
-	//t.stop();
+		if(!loaded)
+			return -1;
 
-	//if(measure)
-	//	std::cout << "kernel time in seconds " << t.getElapsedTimeInSec() << ";" << std::endl;
+		if(gof->getMaxState() > 1 && !gof->getStates().isSet()) {
+			MessageBoxA(0,"Board has more than two states, it needs --states", "ERROR", MB_OK);
+			return -1;
+		}
 
+		if(measure)
+			std::cout << "init time in seconds " << t.getElapsedTimeInSec() << ";" << std::endl;
+
+		t.start();
+		gof->openCL_run(generations);
+		t.stop();
+
+		if(measure)
+			std::cout << "OpenCLKernel execution time in seconds " << t.getElapsedTimeInSec() << ";" << std::endl;
+	}
+	else {
+		gof->setThreadCount(nthreads);
+		// a tuned profile of this machine beats the defaults but not the command line
+		// or the settings of a resumed run
+		if(haveProfile && !fResumeFName) {
+			gof->applyProfile(profile);
+			if(threadsGiven)
+				gof->setThreadCount(nthreads);
+		}
+		if(tileRows > 0 && tileCols > 0)
+			gof->setTileSize(tileRows, tileCols);
+		gof->setFixedDims(fixedDims);
+
+		if(fCheckpointFName && !gof->openCheckpoints(fCheckpointFName, checkpointGenerations, checkpointSeconds)) {
+			MessageBoxA(0,"Could not start checkpoints", "ERROR", MB_OK);
+			return -1;
+		}
+
+		t.start();
+		if(windowWidth > 0) {
+			// the board is gone if the window could not be allocated
+			if(!gof->evolveWindow(mode, windowX, windowY, windowWidth, windowHeight, generations)) {
+				delete gof;
+				return -1;
+			}
+		}
+		else if(viewZoom > 0) {
+			// generation by generation, so the view sees them, without cycle detection
+			Viewer<uint8_t> viewer(viewX, viewY, viewZoom, viewCols, viewRows, viewFps);
+			for(const BoardView<uint8_t>& board : gof->generations(mode, generations)) {
+				viewer.offer(board);
+			}
+			viewer.close(gof->view());
+		}
+		else {
+			gof->evolve(mode, generations);
+		}
+		t.stop();
+
+		// the last checkpoint holds the finished board, --resume only saves it then
+		if(fCheckpointFName && !gof->closeCheckpoints())
+			MessageBoxA(0,"Could not write checkpoint", "ERROR", MB_OK);
+
+		if(measure)
+			std::cout << "kernel time in seconds " << t.getElapsedTimeInSec() << ";" << std::endl;
+
+		if(measure && mode == TILED) {
+			const std::vector<WorkerStats>& stats = gof->getSchedulerStats();
+			for(size_t i=0;i<stats.size();++i) {
+				std::cout << "worker " << i << " tasks " << stats[i].tasks << " steals " << stats[i].steals
+						  << " failed steals " << stats[i].failedSteals << " idle seconds " << stats[i].idleTime << ";" << std::endl;
+			}
+		}
+	}
+
+	if(measure) {
+		std::cout << "time to first generation in seconds "
+				  << std::chrono::duration<double>(gof->getFirstGenerationTime()-startup).count() << ";" << std::endl;
+
+		if(GridAllocator::instance().getHugePages())
+			std::cout << "huge page bytes " << GridAllocator::instance().getHugePageBytes() << ";" << std::endl;
+	}
+
+	// the remaining generations were skipped once the board became periodic
+	if(gof->getCyclePeriod() > 0)
+		std::cout << "cycle with period " << gof->getCyclePeriod() << " detected, starting in generation " << gof->getCycleStart() << std::endl;
+
+	//if(measure)
+	//	std::cout << "init time in seconds " << t.getElapsedTimeInSec() << ";" << std::endl;
 
 	//if(fileToCompare) {
 	//	if(gof->cmpFiles(fOutFName, fileToCompare))
@@ -153,6 +868,9 @@ int main(int argc, char** argv) {
 	if(measure)
 		std::cout << "finalize time in seconds " << t.getElapsedTimeInSec() << ";" << std::endl;
 
+	// the file holds the final values while the program waits
+	Metrics::instance().close();
+
 	getchar();
 	
 }
\ No newline at end of file
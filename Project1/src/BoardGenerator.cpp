@@ -0,0 +1,79 @@
+#include "../includes/BoardGenerator.h"
+#include "../includes/patterncodec.h"
+
+#include <omp.h>
+#include <vector>
+#include <cstdio>
+
+BoardGenerator::BoardGenerator(const int xDim, const int yDim, const double density, const uint64_t seed) : mXDim(xDim), mYDim(yDim),
+																										  mSeed(seed), mThreadCount(0) {
+	const double d = density < 0.0 ? 0.0 : (density > 1.0 ? 1.0 : density);
+	mThreshold = (uint64_t)(d * 9007199254740992.0);
+}
+
+void BoardGenerator::generateRowChars(const int y, char* out) const {
+	const uint64_t first = (uint64_t)y*mXDim;
+	for(int x=0;x<mXDim;++x) {
+		out[x] = cellValue(first+x) < mThreshold ? 'x' : '.';
+	}
+}
+
+void BoardGenerator::generateRowBits(const int y, unsigned char* out) const {
+	const uint64_t first = (uint64_t)y*mXDim;
+	for(size_t i=0;i<binaryRowBytes(mXDim);++i) {
+		out[i] = 0;
+	}
+	for(int x=0;x<mXDim;++x) {
+		out[x>>3] |= (unsigned char)((cellValue(first+x) < mThreshold) << (x&7));
+	}
+}
+
+bool BoardGenerator::write(const char* fileName) {
+	if(mXDim < 1 || mYDim < 1)
+		return false;
+
+	// only the dense formats make sense for random boards
+	const PatternFormat format = patternFormat(fileName);
+	if(format != FORMAT_GOL && format != FORMAT_BINARY)
+		return false;
+
+	FILE* file = fopen(fileName, "wb");
+	if(!file)
+		return false;
+
+	bool ok;
+	if(format == FORMAT_BINARY)
+		ok = writeBinaryHeader(file, mXDim, mYDim);
+	else
+		ok = fprintf(file, "%d,%d\n", mXDim, mYDim) > 0;
+
+	const size_t rowBytes = (format == FORMAT_BINARY) ? binaryRowBytes(mXDim) : (size_t)mXDim+1;
+	// bands of about 64 MB, every thread gets a part of each band
+	const int bandRows = (rowBytes >= ((size_t)64 << 20)) ? 1 : (int)(((size_t)64 << 20)/rowBytes);
+	std::vector<char> band((size_t)(bandRows < mYDim ? bandRows : mYDim)*rowBytes);
+
+	const int threads = mThreadCount > 0 ? mThreadCount : omp_get_max_threads();
+
+	for(int y0=0;y0<mYDim && ok;y0+=bandRows) {
+		const int rows = (mYDim-y0 < bandRows) ? mYDim-y0 : bandRows;
+
+		#pragma omp parallel for schedule(static) num_threads(threads)
+		for(int i=0;i<rows;++i) {
+			char* row = &band[(size_t)i*rowBytes];
+			if(format == FORMAT_BINARY) {
+				generateRowBits(y0+i, (unsigned char*)row);
+			}
+			else {
+				generateRowChars(y0+i, row);
+				row[mXDim] = '\n';
+			}
+		}
+
+		ok = fwrite(&band[0], 1, (size_t)rows*rowBytes, file) == (size_t)rows*rowBytes;
+	}
+
+	if(fclose(file) != 0)
+		ok = false;
+
+	return ok;
+}
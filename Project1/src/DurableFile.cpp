@@ -0,0 +1,116 @@
+#include "../includes/DurableFile.h"
+
+#include <cstdio>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+// the file contents have to be on the disk before the rename makes them visible
+static bool flushToDisk(FILE* file) {
+	if(fflush(file) != 0)
+		return false;
+#ifdef _WIN32
+	return _commit(_fileno(file)) == 0;
+#else
+	return fsync(fileno(file)) == 0;
+#endif
+}
+
+#ifdef _WIN32
+// write through returns once the new name is on the disk
+static bool moveFile(const char* from, const char* to) {
+	return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+}
+
+static bool syncDirectory(const char*) {
+	return true;
+}
+#else
+static bool moveFile(const char* from, const char* to) {
+	return rename(from, to) == 0;
+}
+
+// a rename only lasts once the directory that holds the names is flushed as well
+static bool syncDirectory(const char* fileName) {
+	const std::string name(fileName);
+	const size_t slash = name.rfind('/');
+	const std::string dir = (slash == std::string::npos) ? "." : (slash == 0 ? "/" : name.substr(0, slash));
+
+	const int fd = open(dir.c_str(), O_RDONLY);
+	if(fd < 0)
+		return false;
+	const bool ok = fsync(fd) == 0;
+	close(fd);
+	return ok;
+}
+#endif
+
+// the whole data into fileName and on the disk, nothing is left behind if that fails
+static bool writeFlushed(const std::string& fileName, const std::vector<unsigned char>& data) {
+	FILE* file = fopen(fileName.c_str(), "wb");
+	if(!file)
+		return false;
+
+	bool ok = data.empty() || fwrite(&data[0], 1, data.size(), file) == data.size();
+	ok = flushToDisk(file) && ok;
+	ok = (fclose(file) == 0) && ok;
+	if(!ok)
+		remove(fileName.c_str());
+	return ok;
+}
+
+bool DurableFile::replace(const char* fileName, const std::vector<unsigned char>& data) {
+	const std::string tmp = tmpName(fileName);
+	const std::string prev = prevName(fileName);
+
+	if(!writeFlushed(tmp, data))
+		return false;
+
+	// the first write has nothing to keep
+	FILE* old = fopen(fileName, "rb");
+	if(old) {
+		fclose(old);
+		if(!moveFile(fileName, prev.c_str()))
+			return false;
+	}
+
+	if(!moveFile(tmp.c_str(), fileName))
+		return false;
+	return syncDirectory(fileName);
+}
+
+bool DurableFile::overwrite(const char* fileName, const std::vector<unsigned char>& data) {
+	const std::string tmp = tmpName(fileName);
+	if(!writeFlushed(tmp, data))
+		return false;
+
+	// the rename swaps the old file for the new one in a single step
+	if(!moveFile(tmp.c_str(), fileName)) {
+		remove(tmp.c_str());
+		return false;
+	}
+	return syncDirectory(fileName);
+}
+
+bool DurableFile::read(const char* fileName, std::vector<unsigned char>& data) {
+	data.clear();
+
+	FILE* file = fopen(fileName, "rb");
+	if(!file)
+		return false;
+
+	unsigned char buffer[64*1024];
+	size_t n = 0;
+	while((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		data.insert(data.end(), buffer, buffer+n);
+	}
+
+	const bool ok = !ferror(file);
+	fclose(file);
+	return ok;
+}
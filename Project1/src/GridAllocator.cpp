@@ -0,0 +1,181 @@
+#include "../includes/GridAllocator.h"
+
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+GridAllocator& GridAllocator::instance() {
+	static GridAllocator allocator;
+	return allocator;
+}
+
+GridAllocator::GridAllocator() : mPoolBytes(0), mPoolLimit((size_t)1024*1024*1024), mPoolHits(0), mHugePages(false) {
+}
+
+GridAllocator::~GridAllocator() {
+	trim();
+}
+
+void* GridAllocator::allocate(const size_t bytes) {
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	const size_t alignment = bytes >= PAGE_SIZE ? PAGE_SIZE : CACHE_LINE;
+	const size_t size = (bytes+alignment-1)/alignment*alignment;
+
+	// reuse a pooled block unless it is more than twice as big
+	std::multimap<size_t, std::pair<void*, Block> >::iterator it = mPool.lower_bound(size);
+	if(it != mPool.end() && it->first <= 2*size) {
+		void* ptr = it->second.first;
+		mLive[ptr] = it->second.second;
+		mPoolBytes -= it->first;
+		mPool.erase(it);
+		mPoolHits++;
+		return ptr;
+	}
+
+	void* ptr = 0;
+	Block block = map(&ptr, size);
+	if(!ptr) {
+		// give the pooled memory back to the system and try again
+		for(it=mPool.begin();it!=mPool.end();++it) {
+			unmap(it->second.first, it->second.second);
+		}
+		mPool.clear();
+		mPoolBytes = 0;
+
+		block = map(&ptr, size);
+		if(!ptr)
+			return 0;
+	}
+
+	mLive[ptr] = block;
+	return ptr;
+}
+
+void GridAllocator::release(void* ptr) {
+	if(!ptr)
+		return;
+
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	std::map<void*, Block>::iterator it = mLive.find(ptr);
+	if(it == mLive.end())
+		return;
+
+	const Block block = it->second;
+	mLive.erase(it);
+
+	if(mPoolBytes+block.size <= mPoolLimit) {
+		mPool.insert(std::make_pair(block.size, std::make_pair(ptr, block)));
+		mPoolBytes += block.size;
+	}
+	else {
+		unmap(ptr, block);
+	}
+}
+
+void GridAllocator::trim() {
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	for(std::multimap<size_t, std::pair<void*, Block> >::iterator it=mPool.begin();it!=mPool.end();++it) {
+		unmap(it->second.first, it->second.second);
+	}
+	mPool.clear();
+	mPoolBytes = 0;
+}
+
+size_t GridAllocator::getHugePageBytes() {
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	size_t bytes = 0;
+	for(std::map<void*, Block>::iterator it=mLive.begin();it!=mLive.end();++it) {
+		if(it->second.huge)
+			bytes += it->second.size;
+	}
+	return bytes;
+}
+
+GridAllocator::Block GridAllocator::map(void** ptr, const size_t bytes) {
+	Block block;
+	block.size = bytes;
+	block.huge = false;
+	block.mapped = false;
+	*ptr = 0;
+
+	if(mHugePages && bytes >= HUGE_PAGE_SIZE) {
+#ifdef _WIN32
+		// needs the "lock pages in memory" privilege, falls back to normal pages without it
+		const size_t largePage = GetLargePageMinimum();
+		if(largePage > 0) {
+			const size_t size = (bytes+largePage-1)/largePage*largePage;
+			*ptr = VirtualAlloc(NULL, size, MEM_RESERVE|MEM_COMMIT|MEM_LARGE_PAGES, PAGE_READWRITE);
+			if(*ptr) {
+				block.size = size;
+				block.huge = true;
+				block.mapped = true;
+				return block;
+			}
+		}
+
+		*ptr = VirtualAlloc(NULL, bytes, MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+		if(*ptr)
+			block.mapped = true;
+		return block;
+#else
+		const size_t size = (bytes+HUGE_PAGE_SIZE-1)/HUGE_PAGE_SIZE*HUGE_PAGE_SIZE;
+#ifdef MAP_HUGETLB
+		// reserved huge pages (vm.nr_hugepages)
+		void* mem = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+		if(mem != MAP_FAILED) {
+			*ptr = mem;
+			block.size = size;
+			block.huge = true;
+			block.mapped = true;
+			return block;
+		}
+#endif
+		// otherwise ask for transparent huge pages
+		void* thp = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		if(thp != MAP_FAILED) {
+			*ptr = thp;
+			block.size = size;
+			block.mapped = true;
+#ifdef MADV_HUGEPAGE
+			block.huge = madvise(thp, size, MADV_HUGEPAGE) == 0;
+#endif
+		}
+		return block;
+#endif
+	}
+
+	const size_t alignment = bytes >= PAGE_SIZE ? PAGE_SIZE : CACHE_LINE;
+#ifdef _WIN32
+	*ptr = _aligned_malloc(bytes, alignment);
+#else
+	if(posix_memalign(ptr, alignment, bytes) != 0)
+		*ptr = 0;
+#endif
+	return block;
+}
+
+void GridAllocator::unmap(void* ptr, const Block& block) {
+	if(block.mapped) {
+#ifdef _WIN32
+		VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+		munmap(ptr, block.size);
+#endif
+	}
+	else {
+#ifdef _WIN32
+		_aligned_free(ptr);
+#else
+		free(ptr);
+#endif
+	}
+}
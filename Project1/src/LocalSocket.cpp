@@ -0,0 +1,211 @@
+#include "../includes/LocalSocket.h"
+
+#include <cstring>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <afunix.h>
+#pragma comment(lib, "Ws2_32.lib")
+typedef SOCKET Handle;
+static const Handle BAD_HANDLE = INVALID_SOCKET;
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+typedef int Handle;
+static const Handle BAD_HANDLE = -1;
+#endif
+
+// a client that went away must not kill the daemon with SIGPIPE
+#ifdef MSG_NOSIGNAL
+static const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+static const int SEND_FLAGS = 0;
+#endif
+
+// mSocket of a closed socket
+static const long long INVALID = -1;
+
+static inline long long fromHandle(const Handle h) { return h == BAD_HANDLE ? INVALID : (long long)h; }
+
+#ifdef _WIN32
+// winsock has to be initialized once per process
+static bool initSockets() {
+	static bool initialized = false;
+	if(!initialized) {
+		WSADATA data;
+		initialized = WSAStartup(MAKEWORD(2,2), &data) == 0;
+	}
+	return initialized;
+}
+
+static inline void closeSocket(const long long s) { closesocket((Handle)s); }
+#else
+static bool initSockets() { return true; }
+static inline void closeSocket(const long long s) { ::close((int)s); }
+#endif
+
+#ifdef _WIN32
+// AF_UNIX socket files are reparse points
+static bool isSocketFile(const char* path) {
+	const DWORD attributes = GetFileAttributesA(path);
+	return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0;
+}
+#else
+static bool isSocketFile(const char* path) {
+	struct stat info;
+	return lstat(path, &info) == 0 && S_ISSOCK(info.st_mode);
+}
+#endif
+
+static bool makeAddress(const char* path, sockaddr_un& address) {
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if(strlen(path) >= sizeof(address.sun_path))
+		return false;
+	strcpy(address.sun_path, path);
+	return true;
+}
+
+LocalSocket::LocalSocket() : mSocket(INVALID), mBuffer(4096), mPos(0), mEnd(0) {
+}
+
+LocalSocket::~LocalSocket() {
+	close();
+}
+
+bool LocalSocket::listen(const char* path) {
+	sockaddr_un address;
+	if(!initSockets() || !makeAddress(path, address))
+		return false;
+
+	close();
+	mSocket = fromHandle(socket(AF_UNIX, SOCK_STREAM, 0));
+	if(mSocket == INVALID)
+		return false;
+
+	// a daemon that was killed leaves its socket file behind, anything else at the
+	// path is not ours to delete and makes bind fail
+	if(isSocketFile(path))
+		remove(path);
+
+	if(bind((Handle)mSocket, (sockaddr*)&address, sizeof(address)) != 0 || ::listen((Handle)mSocket, 16) != 0) {
+		close();
+		return false;
+	}
+
+	mPath = path;
+	return true;
+}
+
+bool LocalSocket::accept(LocalSocket& client) {
+	if(mSocket == INVALID)
+		return false;
+
+	const long long s = fromHandle(::accept((Handle)mSocket, NULL, NULL));
+	if(s == INVALID)
+		return false;
+
+	client.close();
+	client.mSocket = s;
+	return true;
+}
+
+bool LocalSocket::connect(const char* path) {
+	sockaddr_un address;
+	if(!initSockets() || !makeAddress(path, address))
+		return false;
+
+	close();
+	mSocket = fromHandle(socket(AF_UNIX, SOCK_STREAM, 0));
+	if(mSocket == INVALID)
+		return false;
+
+	if(::connect((Handle)mSocket, (sockaddr*)&address, sizeof(address)) != 0) {
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+bool LocalSocket::readLine(std::string& line, const size_t maxLength) {
+	line.clear();
+
+	for(;;) {
+		while(mPos < mEnd) {
+			const char c = mBuffer[mPos++];
+			if(c == '\n') {
+				if(!line.empty() && line[line.length()-1] == '\r')
+					line.erase(line.length()-1);
+				return true;
+			}
+			line += c;
+			if(maxLength > 0 && line.length() > maxLength)
+				return false;
+		}
+
+		if(mSocket == INVALID)
+			return false;
+
+		const int n = (int)recv((Handle)mSocket, &mBuffer[0], (int)mBuffer.size(), 0);
+		if(n <= 0)
+			return !line.empty();
+
+		mPos = 0;
+		mEnd = n;
+	}
+}
+
+bool LocalSocket::setReadTimeout(const int ms) {
+	if(mSocket == INVALID)
+		return false;
+#ifdef _WIN32
+	const DWORD timeout = (DWORD)ms;
+#else
+	timeval timeout;
+	timeout.tv_sec = ms/1000;
+	timeout.tv_usec = (ms%1000)*1000;
+#endif
+	return setsockopt((Handle)mSocket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout)) == 0;
+}
+
+void LocalSocket::shutdown() {
+	if(mSocket == INVALID)
+		return;
+#ifdef _WIN32
+	::shutdown((Handle)mSocket, SD_BOTH);
+#else
+	::shutdown((Handle)mSocket, SHUT_RDWR);
+#endif
+}
+
+bool LocalSocket::write(const std::string& data) {
+	size_t done = 0;
+	while(done < data.length()) {
+		const int n = (int)send((Handle)mSocket, data.c_str()+done, (int)(data.length()-done), SEND_FLAGS);
+		if(n <= 0)
+			return false;
+		done += n;
+	}
+	return true;
+}
+
+void LocalSocket::close() {
+	if(mSocket != INVALID) {
+		closeSocket(mSocket);
+		mSocket = INVALID;
+	}
+	if(!mPath.empty()) {
+		remove(mPath.c_str());
+		mPath.clear();
+	}
+	mPos = mEnd = 0;
+}
+
+bool LocalSocket::isOpen() const {
+	return mSocket != INVALID;
+}
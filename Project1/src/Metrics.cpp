@@ -0,0 +1,246 @@
+#include "../includes/Metrics.h"
+
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+
+#include "../includes/DurableFile.h"
+
+// a scraper gets this long to send its request line, and that many bytes for it
+static const int CLIENT_TIMEOUT_MS = 2000;
+static const size_t MAX_REQUEST = 4096;
+
+Metrics& Metrics::instance() {
+	static Metrics metrics;
+	return metrics;
+}
+
+Metrics::Metrics() : mEnabled(false), mGenerations(0), mPopulation(0), mBytesRead(0), mBytesWritten(0), mLatencyNanos(0),
+					 mLastGenerations(0), mRate(0.0), mIntervalMs(1000), mStop(false), mSocketStop(false), mClient(0) {
+	for(int i=0;i<BUCKETS;++i) {
+		mBuckets[i].store(0);
+	}
+	mStart = mLastTime = std::chrono::steady_clock::now();
+}
+
+Metrics::~Metrics() {
+	close();
+}
+
+bool Metrics::openFile(const char* fileName, const int intervalMs) {
+	if(mFileThread.joinable())
+		return false;
+
+	mFileName = fileName;
+	mIntervalMs = intervalMs < 1 ? 1 : intervalMs;
+	if(!writeFile())
+		return false;
+
+	mStop = false;
+	mEnabled.store(true);
+	mFileThread = std::thread(&Metrics::fileLoop, this);
+	return true;
+}
+
+bool Metrics::openSocket(const char* path) {
+	if(mSocketThread.joinable() || !mListener.listen(path))
+		return false;
+
+	mSocketPath = path;
+	mSocketStop.store(false);
+	mEnabled.store(true);
+	mSocketThread = std::thread(&Metrics::socketLoop, this);
+	return true;
+}
+
+void Metrics::close() {
+	if(mFileThread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(mStopMutex);
+			mStop = true;
+		}
+		mStopSignal.notify_all();
+		mFileThread.join();
+		// the last values of the run
+		writeFile();
+	}
+
+	if(mSocketThread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(mClientMutex);
+			mSocketStop.store(true);
+			if(mClient)
+				mClient->shutdown();
+		}
+		// accept does not return on its own, a connection wakes it up
+		LocalSocket wake;
+		if(wake.connect(mSocketPath.c_str()))
+			wake.write("\n");
+		mSocketThread.join();
+		mListener.close();
+	}
+
+	mEnabled.store(false);
+}
+
+void Metrics::addGenerations(const uint64_t count, const double seconds) {
+	if(count == 0)
+		return;
+
+	const double micro = seconds*1e6/count;
+	int bucket = 0;
+	while(bucket < BUCKETS-1 && micro >= (double)(1ull << bucket)) {
+		++bucket;
+	}
+
+	mGenerations.fetch_add(count, std::memory_order_relaxed);
+	mLatencyNanos.fetch_add((uint64_t)(seconds*1e9), std::memory_order_relaxed);
+	mBuckets[bucket].fetch_add(count, std::memory_order_relaxed);
+}
+
+double Metrics::percentile(const uint64_t* buckets, const uint64_t count, const double q) const {
+	if(count == 0)
+		return 0.0;
+
+	const double rank = q*count;
+	uint64_t seen = 0;
+	for(int i=0;i<BUCKETS;++i) {
+		seen += buckets[i];
+		if((double)seen >= rank)
+			return (double)(1ull << i)*1e-6;
+	}
+	return (double)(1ull << (BUCKETS-1))*1e-6;
+}
+
+std::string Metrics::text() {
+	// the counters are read one after another while the engines keep going, so a
+	// snapshot can be off by a generation, which is fine for monitoring
+	uint64_t buckets[BUCKETS];
+	uint64_t count = 0;
+	for(int i=0;i<BUCKETS;++i) {
+		buckets[i] = mBuckets[i].load(std::memory_order_relaxed);
+		count += buckets[i];
+	}
+	const uint64_t generations = mGenerations.load(std::memory_order_relaxed);
+	const double latencySum = mLatencyNanos.load(std::memory_order_relaxed)*1e-9;
+
+	double rate;
+	double uptime;
+	{
+		std::lock_guard<std::mutex> lock(mRateMutex);
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		const double elapsed = std::chrono::duration<double>(now-mLastTime).count();
+		// scrapes right after each other would only measure noise
+		if(elapsed >= 0.1) {
+			mRate = (generations-mLastGenerations)/elapsed;
+			mLastGenerations = generations;
+			mLastTime = now;
+		}
+		rate = mRate;
+		uptime = std::chrono::duration<double>(now-mStart).count();
+	}
+
+	std::ostringstream out;
+	out << "# HELP gol_generations_total Generations calculated.\n"
+		<< "# TYPE gol_generations_total counter\n"
+		<< "gol_generations_total " << generations << "\n"
+		<< "# HELP gol_generations_per_second Generations per second since the last refresh.\n"
+		<< "# TYPE gol_generations_per_second gauge\n"
+		<< "gol_generations_per_second " << rate << "\n"
+		<< "# HELP gol_population Living cells after the last generation.\n"
+		<< "# TYPE gol_population gauge\n"
+		<< "gol_population " << mPopulation.load(std::memory_order_relaxed) << "\n"
+		<< "# HELP gol_bytes_read_total Bytes of board, pattern and history files read.\n"
+		<< "# TYPE gol_bytes_read_total counter\n"
+		<< "gol_bytes_read_total " << mBytesRead.load(std::memory_order_relaxed) << "\n"
+		<< "# HELP gol_bytes_written_total Bytes of board, pattern and history files written.\n"
+		<< "# TYPE gol_bytes_written_total counter\n"
+		<< "gol_bytes_written_total " << mBytesWritten.load(std::memory_order_relaxed) << "\n"
+		<< "# HELP gol_uptime_seconds Seconds since the process started.\n"
+		<< "# TYPE gol_uptime_seconds gauge\n"
+		<< "gol_uptime_seconds " << uptime << "\n";
+
+	out << "# HELP gol_generation_seconds Time per generation.\n"
+		<< "# TYPE gol_generation_seconds histogram\n";
+	uint64_t cumulative = 0;
+	for(int i=0;i<BUCKETS;++i) {
+		cumulative += buckets[i];
+		// the last bucket also holds everything above it
+		if(i < BUCKETS-1)
+			out << "gol_generation_seconds_bucket{le=\"" << (double)(1ull << i)*1e-6 << "\"} " << cumulative << "\n";
+	}
+	out << "gol_generation_seconds_bucket{le=\"+Inf\"} " << count << "\n"
+		<< "gol_generation_seconds_sum " << latencySum << "\n"
+		<< "gol_generation_seconds_count " << count << "\n";
+
+	const double quantiles[] = {0.5, 0.9, 0.99};
+	out << "# HELP gol_generation_seconds_quantile Upper bound of the histogram bucket of the quantile.\n"
+		<< "# TYPE gol_generation_seconds_quantile gauge\n";
+	for(int i=0;i<3;++i) {
+		out << "gol_generation_seconds_quantile{quantile=\"" << quantiles[i] << "\"} " << percentile(buckets, count, quantiles[i]) << "\n";
+	}
+
+	return out.str();
+}
+
+bool Metrics::writeFile() {
+	// a scrape never sees half a file, see DurableFile
+	const std::string content = text();
+	return DurableFile::overwrite(mFileName.c_str(), std::vector<unsigned char>(content.begin(), content.end()));
+}
+
+void Metrics::fileLoop() {
+	std::unique_lock<std::mutex> lock(mStopMutex);
+	while(!mStop) {
+		mStopSignal.wait_for(lock, std::chrono::milliseconds(mIntervalMs));
+		if(mStop)
+			break;
+
+		lock.unlock();
+		writeFile();
+		lock.lock();
+	}
+}
+
+void Metrics::socketLoop() {
+	LocalSocket client;
+	while(!mSocketStop.load() && mListener.accept(client)) {
+		{
+			std::lock_guard<std::mutex> lock(mClientMutex);
+			if(mSocketStop.load())
+				break;
+			mClient = &client;
+		}
+
+		// a client that sends nothing or no line break does not hold up the others
+		std::string line;
+		client.setReadTimeout(CLIENT_TIMEOUT_MS);
+		const bool ok = client.readLine(line, MAX_REQUEST);
+		{
+			std::lock_guard<std::mutex> lock(mClientMutex);
+			mClient = 0;
+		}
+		if(!ok) {
+			client.close();
+			continue;
+		}
+
+		const std::string body = text();
+		if(line.compare(0, 4, "GET ") == 0) {
+			std::ostringstream header;
+			header << "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " << body.length() << "\r\n\r\n";
+			client.write(header.str());
+		}
+		client.write(body);
+		client.close();
+	}
+}
+
+uint64_t Metrics::fileBytes(const char* fileName) {
+	std::ifstream in(fileName, std::ios::in | std::ios::binary | std::ios::ate);
+	if(!in.is_open())
+		return 0;
+
+	const std::streamoff size = in.tellg();
+	return size < 0 ? 0 : (uint64_t)size;
+}
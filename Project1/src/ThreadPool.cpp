@@ -0,0 +1,64 @@
+#include "../includes/ThreadPool.h"
+
+ThreadPool::ThreadPool(const int nthreads) : mPending(0), mShutdown(false) {
+	const int count = nthreads < 1 ? 1 : nthreads;
+	for(int i=0;i<count;++i) {
+		mWorkers.push_back(std::thread(&ThreadPool::workerLoop, this));
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mShutdown = true;
+	}
+	mTaskAvailable.notify_all();
+
+	for(size_t i=0;i<mWorkers.size();++i) {
+		mWorkers[i].join();
+	}
+}
+
+void ThreadPool::enqueue(const std::function<void()>& task) {
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mTasks.push_back(task);
+		mPending++;
+	}
+	mTaskAvailable.notify_one();
+}
+
+void ThreadPool::wait() {
+	std::unique_lock<std::mutex> lock(mMutex);
+	while(mPending > 0) {
+		mAllDone.wait(lock);
+	}
+}
+
+void ThreadPool::workerLoop() {
+	for(;;) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			while(!mShutdown && mTasks.empty()) {
+				mTaskAvailable.wait(lock);
+			}
+			// remaining tasks are still executed before shutting down
+			if(mTasks.empty()) {
+				return;
+			}
+			task = mTasks.front();
+			mTasks.pop_front();
+		}
+
+		task();
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mPending--;
+			if(mPending == 0) {
+				mAllDone.notify_all();
+			}
+		}
+	}
+}
@@ -0,0 +1,195 @@
+#include "../includes/TuningProfile.h"
+#include "../includes/DurableFile.h"
+
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#ifdef _WIN32
+#include <Windows.h>
+#pragma comment(lib, "Advapi32.lib")
+#endif
+
+// tabs separate the fields of a line, so they must not show up in an identity
+static std::string clean(const std::string& s) {
+	std::string out;
+	for(size_t i=0;i<s.length();++i) {
+		const char c = (s[i] == '\t' || s[i] == '\n' || s[i] == '\r') ? ' ' : s[i];
+		if(c == ' ' && (out.empty() || out[out.length()-1] == ' '))
+			continue;
+		out += c;
+	}
+	while(!out.empty() && out[out.length()-1] == ' ')
+		out.erase(out.length()-1);
+	return out;
+}
+
+std::string TuningProfile::cpuIdentity() {
+	std::string name;
+
+#ifdef _WIN32
+	HKEY key;
+	if(RegOpenKeyExA(HKEY_LOCAL_MACHINE, "HARDWARE\\DESCRIPTION\\System\\CentralProcessor\\0", 0, KEY_READ, &key) == ERROR_SUCCESS) {
+		char buffer[256];
+		DWORD size = sizeof(buffer);
+		if(RegQueryValueExA(key, "ProcessorNameString", NULL, NULL, (LPBYTE)buffer, &size) == ERROR_SUCCESS) {
+			buffer[sizeof(buffer)-1] = '\0';
+			name = buffer;
+		}
+		RegCloseKey(key);
+	}
+#else
+	std::ifstream cpuinfo("/proc/cpuinfo");
+	std::string line;
+	while(std::getline(cpuinfo, line)) {
+		if(line.compare(0, 10, "model name") == 0) {
+			const size_t colon = line.find(':');
+			if(colon != std::string::npos)
+				name = line.substr(colon+1);
+			break;
+		}
+	}
+#endif
+
+	if(name.empty())
+		name = "unknown cpu";
+
+	std::ostringstream identity;
+	identity << "cpu " << clean(name) << " x" << std::thread::hardware_concurrency();
+	return identity.str();
+}
+
+std::string TuningProfile::deviceIdentity(const std::string& deviceName) {
+	return "ocl " + clean(deviceName);
+}
+
+// work-group sides have to be powers of two for the reduction in kernel.cl
+static inline bool isPowerOfTwo(const int v) {
+	return v > 0 && (v & (v-1)) == 0;
+}
+
+bool TuningProfile::load(const char* fileName) {
+	std::ifstream in(fileName);
+	if(!in.is_open())
+		return false;
+
+	mEntries.clear();
+
+	std::string line;
+	while(std::getline(in, line)) {
+		if(line.empty() || line[0] == '#')
+			continue;
+
+		const size_t tab1 = line.find('\t');
+		const size_t tab2 = (tab1 == std::string::npos) ? tab1 : line.find('\t', tab1+1);
+		if(tab2 == std::string::npos)
+			continue;
+
+		Entry entry;
+		entry.identity = line.substr(0, tab1);
+		if(sscanf(line.c_str()+tab1+1, "%dx%d", &entry.xDim, &entry.yDim) != 2)
+			continue;
+
+		// an entry with a value that does not make sense is left out as a whole
+		bool valid = entry.xDim > 0 && entry.yDim > 0;
+		std::istringstream values(line.substr(tab2+1));
+		std::string value;
+		while(valid && values >> value) {
+			const size_t eq = value.find('=');
+			if(eq == std::string::npos)
+				continue;
+			const std::string key = value.substr(0, eq);
+			const char* v = value.c_str()+eq+1;
+			TuningConfig& c = entry.config;
+
+			if(key == "threads") {
+				c.threads = atoi(v);
+				valid = c.threads > 0;
+			}
+			else if(key == "chunk") {
+				c.chunk = atoi(v);
+				valid = c.chunk >= 0;
+			}
+			else if(key == "tile") {
+				valid = sscanf(v, "%dx%d", &c.tileRows, &c.tileCols) == 2 && c.tileRows > 0 && c.tileCols > 0;
+			}
+			else if(key == "local") {
+				valid = sscanf(v, "%dx%d", &c.localX, &c.localY) == 2 && isPowerOfTwo(c.localX) && isPowerOfTwo(c.localY);
+			}
+			else if(key == "cells") {
+				c.cellsPerItem = atoi(v);
+				valid = c.cellsPerItem > 0;
+			}
+			else if(key == "spg") {
+				c.secondsPerGeneration = atof(v);
+			}
+		}
+
+		if(valid)
+			mEntries.push_back(entry);
+	}
+
+	return true;
+}
+
+bool TuningProfile::save(const char* fileName) const {
+	std::ostringstream out;
+	out << "# autotuner profile, see TuningProfile.h\n";
+	for(size_t i=0;i<mEntries.size();++i) {
+		const Entry& e = mEntries[i];
+		const TuningConfig& c = e.config;
+
+		out << e.identity << "\t" << e.xDim << "x" << e.yDim << "\t";
+		if(c.threads > 0)
+			out << "threads=" << c.threads << " chunk=" << c.chunk << " ";
+		if(c.tileRows > 0)
+			out << "tile=" << c.tileRows << "x" << c.tileCols << " ";
+		if(c.localX > 0)
+			out << "local=" << c.localX << "x" << c.localY << " cells=" << c.cellsPerItem << " ";
+		out << "spg=" << c.secondsPerGeneration << "\n";
+	}
+
+	// a crash never leaves half a profile behind, see DurableFile
+	const std::string content = out.str();
+	return DurableFile::overwrite(fileName, std::vector<unsigned char>(content.begin(), content.end()));
+}
+
+bool TuningProfile::find(const std::string& identity, const int xDim, const int yDim, TuningConfig& config) const {
+	const double cells = (double)xDim*yDim;
+	double bestDistance = -1.0;
+
+	for(size_t i=0;i<mEntries.size();++i) {
+		const Entry& e = mEntries[i];
+		if(e.identity != identity)
+			continue;
+
+		// boards of a similar size behave alike, the ratio counts and not the difference
+		const double ratio = ((double)e.xDim*e.yDim) / cells;
+		const double distance = ratio < 1.0 ? 1.0/ratio : ratio;
+		if(bestDistance < 0.0 || distance < bestDistance) {
+			bestDistance = distance;
+			config = e.config;
+		}
+	}
+
+	return bestDistance >= 0.0;
+}
+
+void TuningProfile::set(const std::string& identity, const int xDim, const int yDim, const TuningConfig& config) {
+	for(size_t i=0;i<mEntries.size();++i) {
+		Entry& e = mEntries[i];
+		if(e.identity == identity && e.xDim == xDim && e.yDim == yDim) {
+			e.config = config;
+			return;
+		}
+	}
+
+	Entry entry;
+	entry.identity = clean(identity);
+	entry.xDim = xDim;
+	entry.yDim = yDim;
+	entry.config = config;
+	mEntries.push_back(entry);
+}
@@ -0,0 +1,163 @@
+#include "../includes/WorkStealing.h"
+
+#include <thread>
+#include <chrono>
+
+WorkStealingDeque::WorkStealingDeque(const int capacity) : mTop(0), mBottom(0) {
+	int size = 1;
+	while(size < capacity) {
+		size <<= 1;
+	}
+	std::vector<std::atomic<int> > buffer(size);
+	mBuffer.swap(buffer);
+	mMask = size-1;
+}
+
+bool WorkStealingDeque::push(const int task) {
+	const long long b = mBottom.load(std::memory_order_relaxed);
+	const long long t = mTop.load(std::memory_order_acquire);
+
+	if(b-t > mMask) {
+		return false;
+	}
+
+	mBuffer[b & mMask].store(task, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	mBottom.store(b+1, std::memory_order_relaxed);
+
+	return true;
+}
+
+int WorkStealingDeque::pop() {
+	const long long b = mBottom.load(std::memory_order_relaxed)-1;
+	mBottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	long long t = mTop.load(std::memory_order_relaxed);
+
+	if(t > b) {
+		// deque was empty
+		mBottom.store(b+1, std::memory_order_relaxed);
+		return EMPTY;
+	}
+
+	int task = mBuffer[b & mMask].load(std::memory_order_relaxed);
+
+	if(t == b) {
+		// last element, race against the thieves for it
+		if(!mTop.compare_exchange_strong(t, t+1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+			task = EMPTY;
+		}
+		mBottom.store(b+1, std::memory_order_relaxed);
+	}
+
+	return task;
+}
+
+int WorkStealingDeque::steal() {
+	long long t = mTop.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	const long long b = mBottom.load(std::memory_order_acquire);
+
+	if(t >= b) {
+		return EMPTY;
+	}
+
+	const int task = mBuffer[t & mMask].load(std::memory_order_relaxed);
+	if(!mTop.compare_exchange_strong(t, t+1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+		return EMPTY;
+	}
+
+	return task;
+}
+
+WorkStealingScheduler::WorkStealingScheduler(const int nthreads, const int capacity) : mExecute(0), mRemaining(0) {
+	const int count = nthreads < 1 ? 1 : nthreads;
+	for(int i=0;i<count;++i) {
+		mDeques.push_back(new WorkStealingDeque(capacity));
+	}
+	mStats.resize(count);
+}
+
+WorkStealingScheduler::~WorkStealingScheduler() {
+	for(size_t i=0;i<mDeques.size();++i) {
+		delete mDeques[i];
+	}
+}
+
+void WorkStealingScheduler::run(const std::vector<int>& readyTasks, const long long taskCount, const Execute& execute) {
+	mExecute = &execute;
+	mRemaining.store(taskCount);
+	mStats.assign(mDeques.size(), WorkerStats());
+
+	// initial tasks are dealt round robin, nobody runs yet so pushing is safe
+	for(size_t i=0;i<readyTasks.size();++i) {
+		const int worker = (int)(i % mDeques.size());
+		if(!mDeques[worker]->push(readyTasks[i])) {
+			execute(worker, readyTasks[i]);
+			mRemaining--;
+		}
+	}
+
+	std::vector<std::thread> threads;
+	for(size_t i=1;i<mDeques.size();++i) {
+		threads.push_back(std::thread(&WorkStealingScheduler::workerLoop, this, (int)i));
+	}
+	// the calling thread is worker 0
+	workerLoop(0);
+
+	for(size_t i=0;i<threads.size();++i) {
+		threads[i].join();
+	}
+
+	mExecute = 0;
+}
+
+void WorkStealingScheduler::spawn(const int worker, const int task) {
+	// a full deque just means this worker has plenty to do, run it right away
+	if(!mDeques[worker]->push(task)) {
+		(*mExecute)(worker, task);
+		mStats[worker].tasks++;
+		mRemaining--;
+	}
+}
+
+void WorkStealingScheduler::workerLoop(const int worker) {
+	WorkerStats& stats = mStats[worker];
+	const int workers = (int)mDeques.size();
+	int victim = worker;
+
+	while(mRemaining.load(std::memory_order_acquire) > 0) {
+		int task = mDeques[worker]->pop();
+
+		if(task == WorkStealingDeque::EMPTY) {
+			std::chrono::steady_clock::time_point idleStart = std::chrono::steady_clock::now();
+
+			// try every other worker once, then give up the time slice
+			while(task == WorkStealingDeque::EMPTY && mRemaining.load(std::memory_order_acquire) > 0) {
+				for(int i=1;i<workers && task == WorkStealingDeque::EMPTY;++i) {
+					victim = (victim+1)%workers;
+					if(victim == worker)
+						victim = (victim+1)%workers;
+
+					task = mDeques[victim]->steal();
+					if(task == WorkStealingDeque::EMPTY)
+						stats.failedSteals++;
+					else
+						stats.steals++;
+				}
+
+				if(task == WorkStealingDeque::EMPTY)
+					std::this_thread::yield();
+			}
+
+			stats.idleTime += std::chrono::duration<double>(std::chrono::steady_clock::now()-idleStart).count();
+
+			if(task == WorkStealingDeque::EMPTY)
+				break;
+		}
+
+		(*mExecute)(worker, task);
+		stats.tasks++;
+		mRemaining.fetch_sub(1, std::memory_order_acq_rel);
+	}
+}